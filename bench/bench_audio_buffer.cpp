@@ -0,0 +1,185 @@
+// Compare the old deque + mutex ingest path against the SPSC ring buffer
+// with the vectorized int16 -> float kernel.
+#include "ring_buffer.hpp"
+#include "sample_convert.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// One UDP payload worth of samples, as sent by the ESP32
+static constexpr size_t kPacketSamples = 512;
+static constexpr size_t kSegmentSamples = 16000 * 7;
+
+static std::vector<int16_t> make_packet() {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> dist(-32768, 32767);
+  std::vector<int16_t> packet(kPacketSamples);
+  for (auto &s : packet) {
+    s = static_cast<int16_t>(dist(rng));
+  }
+  return packet;
+}
+
+// The pre-ring implementation of AudioManager's buffer
+struct DequeBuffer {
+  std::mutex mutex;
+  std::deque<float> buffer;
+
+  size_t push(const int16_t *data, size_t n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < n; i++) {
+      buffer.push_back(data[i] / 32768.0f);
+    }
+    return n;
+  }
+
+  bool pop(std::vector<float> &out, size_t n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffer.size() < n) {
+      return false;
+    }
+    out.resize(n);
+    std::copy(buffer.begin(), buffer.begin() + n, out.begin());
+    buffer.erase(buffer.begin(), buffer.begin() + n);
+    return true;
+  }
+};
+
+struct RingBuffer {
+  SpscRingBuffer<float> buffer{kSegmentSamples * 4};
+
+  size_t push(const int16_t *data, size_t n) {
+    return buffer.produce(n, [data](float *dst, size_t offset, size_t count) {
+      convert_int16_to_float(data + offset, dst, count);
+    });
+  }
+
+  bool pop(std::vector<float> &out, size_t n) {
+    if (buffer.size() < n) {
+      return false;
+    }
+    out.resize(n);
+    buffer.read(out.data(), n);
+    return true;
+  }
+};
+
+template <typename Fn> static double ns_per_sample(size_t samples, Fn fn) {
+  double best = 1e30;
+  for (int rep = 0; rep < 5; rep++) {
+    auto t0 = Clock::now();
+    fn();
+    std::chrono::duration<double, std::nano> dt = Clock::now() - t0;
+    best = std::min(best, dt.count() / samples);
+  }
+  return best;
+}
+
+static void bench_convert(const std::vector<int16_t> &packet) {
+  std::vector<float> out(packet.size());
+  const size_t iters = 20000;
+  const size_t samples = iters * packet.size();
+
+  double scalar = ns_per_sample(samples, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      convert_int16_to_float_scalar(packet.data(), out.data(), packet.size());
+    }
+  });
+  double simd = ns_per_sample(samples, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      convert_int16_to_float(packet.data(), out.data(), packet.size());
+    }
+  });
+
+  std::printf("%-34s %8.3f ns/sample\n", "convert scalar", scalar);
+  std::printf("%-34s %8.3f ns/sample\n", "convert simd", simd);
+}
+
+// Single thread: push one segment in packet-sized pieces, then pop it.
+template <typename Buffer>
+static double bench_single(const char *name,
+                           const std::vector<int16_t> &packet) {
+  const size_t packets = kSegmentSamples / kPacketSamples;
+  const size_t rounds = 20;
+  std::vector<float> segment;
+  Buffer buf;
+
+  double ns = ns_per_sample(rounds * packets * kPacketSamples, [&] {
+    for (size_t r = 0; r < rounds; r++) {
+      for (size_t p = 0; p < packets; p++) {
+        buf.push(packet.data(), packet.size());
+      }
+      buf.pop(segment, packets * kPacketSamples);
+    }
+  });
+  std::printf("%-34s %8.3f ns/sample\n", name, ns);
+  return ns;
+}
+
+// Two threads: a producer streaming packets while a consumer drains
+// segments. The ring drops instead of blocking when full, so the producer
+// retries until every packet is accepted to keep the comparison fair.
+template <typename Buffer>
+static void bench_concurrent(const char *name,
+                             const std::vector<int16_t> &packet) {
+  const size_t packets = 200000;
+  Buffer buf;
+  std::atomic<bool> done{false};
+
+  std::thread consumer([&] {
+    std::vector<float> segment;
+    const size_t chunk = kPacketSamples * 32;
+    while (!done.load(std::memory_order_relaxed)) {
+      if (!buf.pop(segment, chunk)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  size_t retries = 0;
+  auto t0 = Clock::now();
+  for (size_t p = 0; p < packets; p++) {
+    size_t sent = 0;
+    while (sent < packet.size()) {
+      size_t n = buf.push(packet.data() + sent, packet.size() - sent);
+      if (n == 0) {
+        retries++;
+        std::this_thread::yield();
+      }
+      sent += n;
+    }
+  }
+  std::chrono::duration<double, std::nano> dt = Clock::now() - t0;
+  done = true;
+  consumer.join();
+
+  std::printf("%-34s %8.1f ns/packet (%zu full-buffer retries)\n", name,
+              dt.count() / packets, retries);
+}
+
+int main() {
+  const auto packet = make_packet();
+
+  std::printf("packet = %zu samples, segment = %zu samples\n\n",
+              kPacketSamples, kSegmentSamples);
+
+  bench_convert(packet);
+
+  double deque_ns = bench_single<DequeBuffer>("push+pop deque/mutex", packet);
+  double ring_ns = bench_single<RingBuffer>("push+pop spsc ring", packet);
+  std::printf("%-34s %8.1fx\n\n", "speedup", deque_ns / ring_ns);
+
+  bench_concurrent<DequeBuffer>("producer deque/mutex (contended)", packet);
+  bench_concurrent<RingBuffer>("producer spsc ring (contended)", packet);
+
+  return 0;
+}
@@ -0,0 +1,366 @@
+// End-to-end benchmark: runs the real livestreaming binary against the
+// ESP32 simulator for a list of network/decoder configurations and reports
+// latency from the end of each utterance to the text that covers it,
+// real-time factor, CPU use and drop counts as JSON.
+//
+//   ./bin/bench_e2e --binary ./bin/livestreaming --wav jfk.wav
+//       [--configs configs.json] [--out results.json] [-- extra args]
+//
+// A configs file is a JSON array of objects with any of: name, speed,
+// packet_samples, loss, jitter_ms, framed, args (extra livestreaming
+// arguments for that run).
+#include "esp32_simulator.hpp"
+#include "vad.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+struct RunConfig {
+  std::string name;
+  SimulatorOptions sim;
+  std::vector<std::string> args;
+};
+
+struct OutputLine {
+  Clock::time_point time;
+  std::string text;
+};
+
+static std::vector<RunConfig> default_configs() {
+  std::vector<RunConfig> configs(4);
+  configs[0].name = "baseline";
+  configs[1].name = "loss-2pct";
+  configs[1].sim.loss = 0.02;
+  configs[2].name = "jitter-40ms";
+  configs[2].sim.jitter_ms = 40.0;
+  configs[3].name = "streaming";
+  configs[3].args = {"--streaming", "-ri", "0.5"};
+  return configs;
+}
+
+static bool load_configs(const std::string &path, std::vector<RunConfig> &configs) {
+  std::ifstream file(path);
+  json doc = json::parse(file, nullptr, false);
+  if (!doc.is_array()) {
+    std::cerr << path << ": expected a JSON array of configurations" << std::endl;
+    return false;
+  }
+  for (const auto &item : doc) {
+    RunConfig config;
+    config.name = item.value("name", "run" + std::to_string(configs.size()));
+    config.sim.speed = item.value("speed", config.sim.speed);
+    config.sim.packet_samples = item.value("packet_samples", config.sim.packet_samples);
+    config.sim.loss = item.value("loss", config.sim.loss);
+    config.sim.jitter_ms = item.value("jitter_ms", config.sim.jitter_ms);
+    config.sim.framed = item.value("framed", config.sim.framed);
+    config.args = item.value("args", std::vector<std::string>());
+    configs.push_back(config);
+  }
+  return true;
+}
+
+// Sample positions where utterances end, as the decoder's VAD sees them
+static std::vector<int64_t> find_speech_ends(const std::vector<int16_t> &pcm,
+                                             int sample_rate) {
+  std::vector<float> audio(pcm.size());
+  for (size_t i = 0; i < pcm.size(); i++) {
+    audio[i] = pcm[i] / 32768.0f;
+  }
+
+  VadOptions options;
+  options.sample_rate = sample_rate;
+  VadSegmenter segmenter(options);
+  segmenter.push(audio.data(), audio.size());
+  segmenter.flush();
+
+  std::vector<int64_t> ends;
+  std::vector<float> segment;
+  int64_t start = 0;
+  while (segmenter.popSegment(segment, &start)) {
+    ends.push_back(start + static_cast<int64_t>(segment.size()));
+  }
+  return ends;
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t rank = static_cast<size_t>(p / 100.0 * (values.size() - 1) + 0.5);
+  return values[std::min(rank, values.size() - 1)];
+}
+
+static json run_config(const RunConfig &config, const std::string &binary,
+                       const std::string &wav, int port, double drain_s,
+                       const std::vector<std::string> &common_args) {
+  json result;
+  result["name"] = config.name;
+  result["speed"] = config.sim.speed;
+  result["packet_samples"] = config.sim.packet_samples;
+  result["loss"] = config.sim.loss;
+  result["jitter_ms"] = config.sim.jitter_ms;
+  result["framed"] = config.sim.framed;
+  result["args"] = config.args;
+
+  SimulatorOptions sim_options = config.sim;
+  sim_options.port = port;
+  Esp32Simulator simulator(sim_options);
+  if (!simulator.loadWav(wav) || !simulator.bind()) {
+    result["error"] = "simulator setup failed";
+    return result;
+  }
+  const int sample_rate = simulator.sampleRate();
+  const double audio_s = simulator.samples().size() / static_cast<double>(sample_rate);
+  result["audio_s"] = audio_s;
+
+  std::vector<std::string> args = {binary, "--esp32-ip", "127.0.0.1",
+                                   "--esp32-port", std::to_string(port)};
+  args.insert(args.end(), common_args.begin(), common_args.end());
+  args.insert(args.end(), config.args.begin(), config.args.end());
+
+  int out_pipe[2];
+  if (pipe(out_pipe) != 0) {
+    result["error"] = "pipe failed";
+    return result;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(out_pipe[1], STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO); // whisper's model loading log
+    ::close(out_pipe[0]);
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+      argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  ::close(out_pipe[1]);
+
+  // Timestamp every output line as it arrives
+  std::mutex lines_mutex;
+  std::condition_variable lines_cv;
+  std::vector<OutputLine> lines;
+  bool output_closed = false;
+  std::thread reader([&] {
+    FILE *out = fdopen(out_pipe[0], "r");
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), out) != nullptr) {
+      std::lock_guard<std::mutex> lock(lines_mutex);
+      lines.push_back({Clock::now(), buffer});
+      lines_cv.notify_all();
+    }
+    std::fclose(out);
+    std::lock_guard<std::mutex> lock(lines_mutex);
+    output_closed = true;
+    lines_cv.notify_all();
+  });
+
+  // The hello goes out while the model is still loading; replay starts
+  // once it is loaded, so utterance latency never includes the load
+  const auto t_launch = Clock::now();
+  bool ok = simulator.waitForHello(std::chrono::seconds(120));
+  result["connect_s"] = std::chrono::duration<double>(Clock::now() - t_launch).count();
+  if (ok) {
+    auto loaded = [&] {
+      return std::any_of(lines.begin(), lines.end(), [](const OutputLine &line) {
+        return line.text.rfind("Loaded model", 0) == 0;
+      });
+    };
+    std::unique_lock<std::mutex> lock(lines_mutex);
+    lines_cv.wait_until(lock, t_launch + std::chrono::seconds(120),
+                        [&] { return output_closed || loaded(); });
+    ok = loaded();
+    if (ok) {
+      result["startup_s"] = std::chrono::duration<double>(Clock::now() - t_launch).count();
+    }
+  }
+  if (ok) {
+    ok = simulator.replay();
+    std::this_thread::sleep_for(std::chrono::duration<double>(drain_s));
+  }
+
+  kill(pid, SIGINT);
+  int status = 0;
+  struct rusage usage;
+  std::memset(&usage, 0, sizeof(usage));
+  const auto kill_deadline = Clock::now() + std::chrono::seconds(30);
+  while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+    if (Clock::now() > kill_deadline) {
+      kill(pid, SIGKILL);
+      wait4(pid, &status, 0, &usage);
+      result["killed"] = true;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  reader.join();
+
+  const double wall_s = std::chrono::duration<double>(Clock::now() - t_launch).count();
+  const double cpu_s = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                       usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+  result["exit_code"] = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  result["wall_s"] = wall_s;
+  result["cpu_s"] = cpu_s;
+  result["cpu_cores_used"] = wall_s > 0 ? cpu_s / wall_s : 0.0;
+  if (!ok) {
+    result["error"] = "no hello or model from livestreaming, or replay failed";
+    return result;
+  }
+
+  // Committed text, any text at all, and the shutdown statistics
+  std::vector<Clock::time_point> commits;
+  std::vector<Clock::time_point> texts;
+  const std::regex ingest_re(R"(Ingest stats: (\d+) packets, \d+ batches, (\d+) kernel drops, (\d+) overrun samples)");
+  const std::regex jitter_re(R"(Jitter stats: (\d+) lost, (\d+) reordered)");
+  const std::regex sched_re(R"(Scheduler: (\d+) decodes .* service ([\d.]+) ms mean)");
+  std::smatch m;
+  for (const auto &line : lines) {
+    if (line.text.rfind("[committed]", 0) == 0 || line.text.rfind("=== Segment", 0) == 0) {
+      commits.push_back(line.time);
+      texts.push_back(line.time);
+    } else if (line.text.rfind("[partial]", 0) == 0) {
+      texts.push_back(line.time);
+    } else if (std::regex_search(line.text, m, ingest_re)) {
+      result["packets_received"] = std::stoull(m[1]);
+      result["kernel_drops"] = std::stoull(m[2]);
+      result["overrun_samples"] = std::stoull(m[3]);
+    } else if (std::regex_search(line.text, m, jitter_re)) {
+      result["jitter_lost"] = std::stoull(m[1]);
+      result["jitter_reordered"] = std::stoull(m[2]);
+    } else if (std::regex_search(line.text, m, sched_re)) {
+      // The last report is the final one
+      double decode_s = std::stod(m[1]) * std::stod(m[2]) / 1000.0;
+      result["decodes"] = std::stoull(m[1]);
+      result["rtf"] = audio_s > 0 ? decode_s / audio_s : 0.0;
+    }
+  }
+
+  const SimulatorStats &sim_stats = simulator.stats();
+  result["packets_sent"] = sim_stats.packets_sent;
+  result["packets_dropped"] = sim_stats.packets_dropped;
+  result["packets_reordered"] = sim_stats.packets_reordered;
+  result["commits"] = commits.size();
+
+  std::vector<double> latencies;
+  std::vector<double> first_text;
+  size_t uncovered = 0;
+  for (int64_t end : find_speech_ends(simulator.samples(), sample_rate)) {
+    auto due = simulator.sampleDue(end);
+    auto it = std::lower_bound(commits.begin(), commits.end(), due);
+    if (it == commits.end()) {
+      uncovered++;
+    } else {
+      latencies.push_back(std::chrono::duration<double, std::milli>(*it - due).count());
+    }
+    // Tentative text counts here; it is what a display would show first
+    auto shown = std::lower_bound(texts.begin(), texts.end(), due);
+    if (shown != texts.end()) {
+      first_text.push_back(std::chrono::duration<double, std::milli>(*shown - due).count());
+    }
+  }
+  result["latency_ms"] = {
+      {"utterances", latencies.size() + uncovered},
+      {"uncovered", uncovered},
+      {"p50", percentile(latencies, 50)},
+      {"p90", percentile(latencies, 90)},
+      {"p99", percentile(latencies, 99)},
+      {"max", latencies.empty() ? 0.0 : *std::max_element(latencies.begin(), latencies.end())},
+  };
+  result["first_text_ms"] = {
+      {"p50", percentile(first_text, 50)},
+      {"p90", percentile(first_text, 90)},
+  };
+  return result;
+}
+
+int main(int argc, char **argv) {
+  std::string binary, wav, configs_path, out_path;
+  int port = 5901;
+  double drain_s = 10.0;
+  std::vector<std::string> common_args;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--") {
+      common_args.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--binary") {
+      binary = value;
+    } else if (arg == "--wav") {
+      wav = value;
+    } else if (arg == "--configs") {
+      configs_path = value;
+    } else if (arg == "--out") {
+      out_path = value;
+    } else if (arg == "--port") {
+      port = std::stoi(value);
+    } else if (arg == "--drain-s") {
+      drain_s = std::stod(value);
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (binary.empty() || wav.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " --binary PATH --wav FILE [--configs FILE] [--out FILE]"
+                 " [--port N] [--drain-s S] [-- livestreaming args]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<RunConfig> configs;
+  if (configs_path.empty()) {
+    configs = default_configs();
+  } else if (!load_configs(configs_path, configs)) {
+    return 1;
+  }
+
+  json report;
+  report["wav"] = wav;
+  report["binary"] = binary;
+  report["runs"] = json::array();
+  for (const auto &config : configs) {
+    std::cerr << "Running " << config.name << "..." << std::endl;
+    json run = run_config(config, binary, wav, port, drain_s, common_args);
+    std::cerr << "  " << run.dump() << std::endl;
+    report["runs"].push_back(run);
+  }
+
+  if (out_path.empty()) {
+    std::cout << report.dump(2) << std::endl;
+  } else {
+    std::ofstream(out_path) << report.dump(2) << std::endl;
+  }
+  return 0;
+}
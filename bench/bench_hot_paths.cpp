@@ -0,0 +1,408 @@
+// Microbenchmarks for the audio and text hot paths, with results as JSON
+// that can be checked in and compared against later runs.
+//
+//   ./bin/bench_hot_paths [--out FILE] [--baseline FILE] [--threshold PCT]
+//       [--filter SUBSTRING] [--reps N]
+//
+// Every benchmark runs once to warm up, then --reps times; "best" is the
+// fastest repetition and is what the baseline comparison uses, "median"
+// shows how noisy the host was. With --baseline, each result gains the
+// baseline value and the change in percent, and the exit status is 1 if
+// any benchmark got slower by more than --threshold percent (default 10).
+#include "audio_manager.hpp"
+#include "packet_capture.hpp"
+#include "params.cpp"
+#include "ring_buffer.hpp"
+#include "sample_convert.hpp"
+#include "session_archive.hpp"
+#include "text_filter.hpp"
+#include "translation_json.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+static constexpr int kSampleRate = 16000;
+// One UDP payload worth of samples, as sent by the ESP32
+static constexpr size_t kPacketSamples = 512;
+static constexpr int kSegmentSeconds = 7;
+static constexpr size_t kSegmentSamples = kSampleRate * kSegmentSeconds;
+
+struct Result {
+  std::string unit;
+  double best = 0.0;
+  double median = 0.0;
+  uint64_t ops = 0; // operations per repetition
+};
+
+struct Options {
+  int reps = 7;
+  std::string filter;
+};
+
+// Throws away std::cout while alive; AudioManager logs every segment
+class QuietStdout {
+public:
+  QuietStdout() : saved_(std::cout.rdbuf(nullptr)) {}
+  ~QuietStdout() { std::cout.rdbuf(saved_); }
+
+private:
+  std::streambuf *saved_;
+};
+
+class Suite {
+public:
+  explicit Suite(const Options &options) : options_(options) {}
+
+  // `fn` performs `ops` operations per call; results are in ns per op
+  void run(const std::string &name, const char *unit, uint64_t ops,
+           const std::function<void()> &fn) {
+    if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+    fn(); // warm-up
+    std::vector<double> times;
+    for (int rep = 0; rep < std::max(1, options_.reps); rep++) {
+      const auto start = Clock::now();
+      fn();
+      std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+      times.push_back(elapsed.count() / ops);
+    }
+    std::sort(times.begin(), times.end());
+
+    Result result;
+    result.unit = unit;
+    result.best = times.front();
+    result.median = times[times.size() / 2];
+    result.ops = ops;
+    results_[name] = result;
+    std::fprintf(stderr, "%-34s %12.3f %-10s (median %.3f)\n", name.c_str(), result.best,
+                 unit, result.median);
+  }
+
+  const std::map<std::string, Result> &results() const { return results_; }
+
+private:
+  Options options_;
+  std::map<std::string, Result> results_;
+};
+
+// Four significant digits, so reruns diff only where something changed
+static double stable(double value) {
+  if (value == 0.0 || !std::isfinite(value)) {
+    return 0.0;
+  }
+  const double scale = std::pow(10.0, 3 - static_cast<int>(std::floor(std::log10(std::fabs(value)))));
+  return std::round(value * scale) / scale;
+}
+
+static std::vector<int16_t> make_pcm(size_t samples) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> dist(-32768, 32767);
+  std::vector<int16_t> pcm(samples);
+  for (auto &s : pcm) {
+    s = static_cast<int16_t>(dist(rng));
+  }
+  // Legacy packets starting with two zero samples lose them as padding
+  pcm[0] = pcm[1] = 1;
+  return pcm;
+}
+
+static void bench_convert(Suite &suite) {
+  const auto packet = make_pcm(kPacketSamples);
+  std::vector<float> out(packet.size());
+  const size_t iters = 20000;
+
+  suite.run("convert_int16.scalar", "ns/sample", iters * packet.size(), [&] {
+    for (size_t i = 0; i < iters; i++) {
+      convert_int16_to_float_scalar(packet.data(), out.data(), packet.size());
+    }
+  });
+  suite.run("convert_int16.simd", "ns/sample", iters * packet.size(), [&] {
+    for (size_t i = 0; i < iters; i++) {
+      convert_int16_to_float(packet.data(), out.data(), packet.size());
+    }
+  });
+}
+
+// The receive thread's side and the consumer's, on one thread: packets in,
+// whole segments out
+static void bench_ring(Suite &suite) {
+  const auto packet = make_pcm(kPacketSamples);
+  const size_t packets = kSegmentSamples / kPacketSamples;
+  const size_t rounds = 20;
+  SpscRingBuffer<float> ring(kSegmentSamples * 4);
+  std::vector<float> segment(packets * kPacketSamples);
+
+  suite.run("ring.push_pop", "ns/sample", rounds * packets * kPacketSamples, [&] {
+    for (size_t r = 0; r < rounds; r++) {
+      for (size_t p = 0; p < packets; p++) {
+        ring.produce(packet.size(), [&](float *dst, size_t offset, size_t count) {
+          convert_int16_to_float(packet.data() + offset, dst, count);
+        });
+      }
+      ring.read(segment.data(), segment.size());
+    }
+  });
+}
+
+// waitForAudioSegment() fed by a capture replayed as fast as it is taken,
+// so the receive thread, the ring and the hand-off are all included
+static void bench_wait_for_segment(Suite &suite, const std::string &dir) {
+  const int segments = 10;
+  const std::string path = dir + "/segments.wpc";
+  const auto pcm = make_pcm(kPacketSamples);
+  {
+    QuietStdout quiet;
+    PacketCaptureWriter capture(path, AudioFormat());
+    const size_t packets = (segments * kSegmentSamples + kPacketSamples - 1) / kPacketSamples;
+    for (size_t i = 0; i < packets; i++) {
+      capture.append(reinterpret_cast<const char *>(pcm.data()), pcm.size() * sizeof(int16_t),
+                     static_cast<int64_t>(i) * 32000000);
+    }
+  }
+
+  IngestOptions ingest;
+  ingest.replay_path = path;
+  ingest.replay_speed = 0.0f;
+  suite.run("audio_manager.wait_for_segment", "ns/sample",
+            static_cast<uint64_t>(segments) * kSegmentSamples, [&] {
+              QuietStdout quiet;
+              AudioManager audio(kSampleRate, "127.0.0.1", 5001, 30, ingest);
+              std::vector<float> segment;
+              if (audio.start()) {
+                while (audio.waitForAudioSegment(segment, kSegmentSeconds)) {
+                }
+              }
+              audio.stop();
+            });
+}
+
+static void bench_archive(Suite &suite, const std::string &dir) {
+  const int writes = 10;
+  std::vector<float> segment(kSegmentSamples);
+  for (size_t i = 0; i < segment.size(); i++) {
+    segment[i] = 0.3f * std::sin(i * 0.05f);
+  }
+  const std::string text =
+      " So the plan for today is to go over the results from last week and decide"
+      " what to ship before Friday.";
+
+  ArchiveOptions options;
+  options.directory = dir;
+  options.prefix = "bench";
+  options.sample_rate = kSampleRate;
+  options.codec = ArchiveCodec::Delta;
+  QuietStdout quiet;
+  SessionArchive archive(options);
+  int64_t position = 0;
+  suite.run("archive.append_audio", "ns/sample",
+            static_cast<uint64_t>(writes) * kSegmentSamples, [&] {
+              for (int i = 0; i < writes; i++) {
+                archive.appendAudio(i, position, segment.data(), segment.size());
+                position += static_cast<int64_t>(segment.size());
+              }
+            });
+
+  const size_t lines = 1000;
+  int64_t text_position = 0;
+  suite.run("archive.append_text", "ns/op", lines, [&] {
+    for (size_t i = 0; i < lines; i++) {
+      archive.appendText(static_cast<int>(i), text_position,
+                         text_position + kSegmentSamples, text);
+      text_position += kSegmentSamples;
+    }
+  });
+  archive.close();
+}
+
+static void bench_remove_parens(Suite &suite) {
+  const std::string line =
+      " [BLANK_AUDIO] So the  plan for today (music) is to go over the results [laughs] "
+      "from last week and  decide what to ship (applause) before Friday.";
+  const size_t iters = 20000;
+  size_t sink = 0;
+  suite.run("text.remove_parens", "ns/op", iters, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      sink += removeParens(line).size();
+    }
+  });
+  if (sink == 1) {
+    std::fprintf(stderr, " ");
+  }
+}
+
+static void bench_params(Suite &suite) {
+  std::vector<std::string> args = {"livestreaming", "--streaming", "-ri", "0.5",
+                                   "-cd", "20", "--vad", "--esp32-ip", "10.0.0.7",
+                                   "--input-rate", "48000", "--input-channels", "2",
+                                   "--translate", "fr", "--subtitle-port", "9200",
+                                   "--overload-policy", "markers", "--prompt-tokens", "32"};
+  std::vector<char *> argv;
+  for (auto &arg : args) {
+    argv.push_back(&arg[0]);
+  }
+  const int argc = static_cast<int>(argv.size());
+  const size_t iters = 2000;
+
+  suite.run("params.construct", "ns/op", iters, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      Params params;
+    }
+  });
+  Params params;
+  suite.run("params.parse", "ns/op", iters, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      params.parse(argc, argv.data());
+    }
+  });
+}
+
+static void bench_translation_json(Suite &suite) {
+  std::vector<std::string> texts;
+  json response;
+  for (int i = 0; i < 8; i++) {
+    texts.push_back("Segment " + std::to_string(i) +
+                    " of the transcript, with \"quotes\" and an accented café.");
+    response["data"]["translations"].push_back(
+        {{"translatedText", "Segment " + std::to_string(i) + " de la transcription, avec des « guillemets »."},
+         {"detectedSourceLanguage", "en"}});
+  }
+  const std::string body = response.dump();
+  const size_t iters = 5000;
+
+  suite.run("translation.request", "ns/op", iters, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      build_translation_request("fr", texts);
+    }
+  });
+  std::vector<std::string> out;
+  std::string error;
+  suite.run("translation.parse", "ns/op", iters, [&] {
+    for (size_t i = 0; i < iters; i++) {
+      parse_translations(body, texts.size(), out, error);
+    }
+  });
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  std::string out_path, baseline_path;
+  double threshold_pct = 10.0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << std::endl;
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--out") {
+      out_path = value;
+    } else if (arg == "--baseline") {
+      baseline_path = value;
+    } else if (arg == "--threshold") {
+      threshold_pct = std::stod(value);
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--reps") {
+      options.reps = std::stoi(value);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--out FILE] [--baseline FILE] [--threshold PCT]"
+                   " [--filter SUBSTRING] [--reps N]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  json baseline;
+  if (!baseline_path.empty()) {
+    std::ifstream file(baseline_path);
+    try {
+      baseline = json::parse(file).at("benchmarks");
+    } catch (const std::exception &e) {
+      std::cerr << "Failed to read baseline " << baseline_path << ": " << e.what()
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // AudioManager writes its log directory into the working directory
+  char dir_template[] = "/tmp/bench_hot_paths.XXXXXX";
+  const char *dir = mkdtemp(dir_template);
+  const auto cwd = std::filesystem::current_path();
+  if (dir == nullptr) {
+    std::cerr << "Failed to create a scratch directory" << std::endl;
+    return 1;
+  }
+  std::filesystem::current_path(dir);
+
+  Suite suite(options);
+  bench_convert(suite);
+  bench_ring(suite);
+  bench_wait_for_segment(suite, dir);
+  bench_archive(suite, dir);
+  bench_remove_parens(suite);
+  bench_params(suite);
+  bench_translation_json(suite);
+
+  std::filesystem::current_path(cwd);
+  std::filesystem::remove_all(dir);
+
+  json report;
+  report["schema"] = 1;
+  report["benchmarks"] = json::object();
+  std::vector<std::string> regressions;
+  for (const auto &[name, result] : suite.results()) {
+    json entry = {{"unit", result.unit},
+                  {"best", stable(result.best)},
+                  {"median", stable(result.median)},
+                  {"ops", result.ops}};
+    if (baseline.contains(name)) {
+      const double before = baseline[name].value("best", 0.0);
+      if (before > 0.0) {
+        const double change = (result.best - before) / before * 100.0;
+        entry["baseline"] = before;
+        entry["change_pct"] = std::round(change * 10.0) / 10.0;
+        std::fprintf(stderr, "%-34s %+8.1f%% vs baseline%s\n", name.c_str(), change,
+                     change > threshold_pct ? "  REGRESSION" : "");
+        if (change > threshold_pct) {
+          regressions.push_back(name);
+        }
+      }
+    }
+    report["benchmarks"][name] = entry;
+  }
+  if (!baseline_path.empty()) {
+    report["baseline"] = {{"threshold_pct", threshold_pct}, {"regressions", regressions}};
+  }
+
+  if (out_path.empty()) {
+    std::cout << report.dump(2) << std::endl;
+  } else {
+    std::ofstream out(out_path);
+    out << report.dump(2) << std::endl;
+    if (!out.good()) {
+      std::cerr << "Failed to write " << out_path << std::endl;
+      return 1;
+    }
+  }
+  return regressions.empty() ? 0 : 1;
+}
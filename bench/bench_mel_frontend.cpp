@@ -0,0 +1,116 @@
+// Frontend CPU per recognition for the streaming decoder's rolling window:
+// recomputing the whole log-mel spectrogram every pass (what whisper_full
+// does when given samples) against the incremental frontend.
+//
+//   ./bin/bench_mel_frontend [interval_s] [context_s]
+#include "mel_frontend.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int kSampleRate = IncrementalMel::kSampleRate;
+
+// Speech-like test signal: bursts of harmonics over low noise
+static std::vector<float> make_audio(size_t samples) {
+  std::mt19937 rng(42);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  std::vector<float> audio(samples);
+  for (size_t i = 0; i < samples; i++) {
+    const float t = static_cast<float>(i) / kSampleRate;
+    const bool voiced = std::fmod(t, 1.3f) < 0.9f;
+    float v = noise(rng);
+    if (voiced) {
+      for (int h = 1; h <= 5; h++) {
+        v += 0.1f / h * std::sin(2.0f * static_cast<float>(M_PI) * 140.0f * h * t);
+      }
+    }
+    audio[i] = v;
+  }
+  return audio;
+}
+
+struct Result {
+  double ms_per_pass = 0.0;
+  double frames_per_pass = 0.0;
+  std::vector<float> last_mel;
+};
+
+// Replays the decoder's window: grow by one interval per pass, and every
+// few passes commit the oldest second (trimmed to a whole hop), capped at
+// the context length. `incremental` keeps one frontend across passes.
+static Result run(const std::vector<float> &audio, double interval_s,
+                  double context_s, bool incremental) {
+  const size_t interval = static_cast<size_t>(interval_s * kSampleRate);
+  const size_t context = static_cast<size_t>(context_s * kSampleRate);
+
+  IncrementalMel shared;
+  std::vector<float> mel;
+  int64_t start = 0;
+  size_t end = 0;
+  int passes = 0;
+  uint64_t frames = 0;
+  double total_ms = 0.0;
+
+  while (end + interval <= audio.size()) {
+    end += interval;
+    if (++passes % 4 == 0 && end - start > static_cast<size_t>(kSampleRate)) {
+      start += kSampleRate;
+    }
+    if (end - start > context) {
+      start = static_cast<int64_t>(end - context);
+      start -= start % IncrementalMel::kHop;
+    }
+
+    std::unique_ptr<IncrementalMel> fresh;
+    if (!incremental) {
+      fresh = std::make_unique<IncrementalMel>();
+    }
+    IncrementalMel &frontend = incremental ? shared : *fresh;
+    const uint64_t before = frontend.stats().frames_computed;
+    int n_len = 0;
+    auto t0 = Clock::now();
+    frontend.compute(audio.data() + start, end - start, start, mel, n_len);
+    total_ms += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    frames += frontend.stats().frames_computed - before;
+  }
+
+  Result result;
+  result.ms_per_pass = total_ms / passes;
+  result.frames_per_pass = static_cast<double>(frames) / passes;
+  result.last_mel = mel;
+  return result;
+}
+
+int main(int argc, char **argv) {
+  const double interval_s = argc > 1 ? std::atof(argv[1]) : 0.2;
+  const double context_s = argc > 2 ? std::atof(argv[2]) : 10.0;
+  const auto audio = make_audio(static_cast<size_t>(120 * kSampleRate));
+
+  std::printf("interval = %.2f s, context up to %.1f s, %zu s of audio\n\n",
+              interval_s, context_s, audio.size() / kSampleRate);
+
+  Result full = run(audio, interval_s, context_s, false);
+  Result incremental = run(audio, interval_s, context_s, true);
+
+  double max_diff = 0.0;
+  for (size_t i = 0; i < full.last_mel.size(); i++) {
+    max_diff = std::max(max_diff, static_cast<double>(std::fabs(
+                                      full.last_mel[i] - incremental.last_mel[i])));
+  }
+
+  std::printf("%-34s %8.3f ms/pass %8.1f FFT frames/pass\n", "full recompute",
+              full.ms_per_pass, full.frames_per_pass);
+  std::printf("%-34s %8.3f ms/pass %8.1f FFT frames/pass\n", "incremental",
+              incremental.ms_per_pass, incremental.frames_per_pass);
+  std::printf("%-34s %8.1fx\n", "speedup", full.ms_per_pass / incremental.ms_per_pass);
+  std::printf("%-34s %8.2g\n", "max |difference|", max_diff);
+  return 0;
+}
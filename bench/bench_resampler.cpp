@@ -0,0 +1,105 @@
+// Receive-thread cost of declared-format ingest: decode, downmix and
+// resample packets to 16 kHz mono float for each sample format, rate and
+// channel count the ESP32 may send.
+//
+//   ./bin/bench_resampler [seconds_of_audio]
+#include "resampler.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int kOutputRate = 16000;
+// Payload bytes per UDP packet, comfortably under one MTU
+static constexpr size_t kPacketBytes = 1152;
+
+// Two tones plus a slow sweep, encoded interleaved in `format`
+static std::vector<char> make_audio(const AudioFormat &format, double seconds) {
+  const size_t frames = static_cast<size_t>(seconds * format.sample_rate);
+  const size_t bytes = sample_format_bytes(format.format);
+  std::vector<char> data(frames * format.frameBytes());
+  for (size_t i = 0; i < frames; i++) {
+    const double t = static_cast<double>(i) / format.sample_rate;
+    for (int c = 0; c < format.channels; c++) {
+      const double v = 0.4 * std::sin(2.0 * M_PI * (300.0 + 50.0 * c) * t) +
+                       0.2 * std::sin(2.0 * M_PI * (1000.0 + 500.0 * t) * t);
+      char *out = &data[(i * format.channels + c) * bytes];
+      switch (format.format) {
+      case SampleFormat::Int16: {
+        const int16_t s = static_cast<int16_t>(std::lround(v * 32767.0));
+        std::memcpy(out, &s, sizeof(s));
+        break;
+      }
+      case SampleFormat::Int24: {
+        const int32_t s = static_cast<int32_t>(std::lround(v * 8388607.0));
+        out[0] = static_cast<char>(s & 0xff);
+        out[1] = static_cast<char>((s >> 8) & 0xff);
+        out[2] = static_cast<char>((s >> 16) & 0xff);
+        break;
+      }
+      case SampleFormat::Float32: {
+        const float s = static_cast<float>(v);
+        std::memcpy(out, &s, sizeof(s));
+        break;
+      }
+      }
+    }
+  }
+  return data;
+}
+
+static const char *format_name(SampleFormat format) {
+  switch (format) {
+  case SampleFormat::Int16:
+    return "int16";
+  case SampleFormat::Int24:
+    return "int24";
+  case SampleFormat::Float32:
+    return "float32";
+  }
+  return "?";
+}
+
+static void run(const AudioFormat &format, double seconds) {
+  const std::vector<char> audio = make_audio(format, seconds);
+  // Whole frames per packet, like a sender would
+  const size_t packet = kPacketBytes / format.frameBytes() * format.frameBytes();
+
+  PcmConverter converter(format, kOutputRate);
+  size_t produced = 0;
+  auto t0 = Clock::now();
+  for (size_t offset = 0; offset < audio.size(); offset += packet) {
+    const size_t n = std::min(packet, audio.size() - offset);
+    produced += converter.convert(audio.data() + offset, n, format.format).size();
+  }
+  const double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  std::printf("%-8s %6d Hz %d ch %10.1f MB/s %10.0fx realtime %9zu samples out\n",
+              format_name(format.format), format.sample_rate, format.channels,
+              audio.size() / elapsed / 1e6, seconds / elapsed, produced);
+}
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 60.0;
+  std::printf("%.0f s of audio per case, %zu-byte packets, output mono %d Hz\n\n",
+              seconds, kPacketBytes, kOutputRate);
+
+  for (SampleFormat sample_format :
+       {SampleFormat::Int16, SampleFormat::Int24, SampleFormat::Float32}) {
+    for (int rate : {16000, 44100, 48000}) {
+      for (int channels : {1, 2}) {
+        AudioFormat format;
+        format.sample_rate = rate;
+        format.channels = channels;
+        format.format = sample_format;
+        run(format, seconds);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Stand-alone ESP32 simulator, for running livestreaming by hand:
+//
+//   ./bin/esp32_sim --wav speech.wav --port 5001 &
+//   ./bin/livestreaming --esp32-ip 127.0.0.1 --esp32-port 5001
+#include "esp32_simulator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s --wav FILE [--port N] [--speed X] [--packet-samples N]\n"
+               "          [--loss P] [--jitter-ms MS] [--raw] [--loop]\n",
+               program);
+}
+
+int main(int argc, char **argv) {
+  SimulatorOptions options;
+  std::string wav;
+  bool loop = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (arg == "--raw") {
+      options.framed = false;
+    } else if (arg == "--loop") {
+      loop = true;
+    } else if (value == nullptr) {
+      usage(argv[0]);
+      return 1;
+    } else if (arg == "--wav") {
+      wav = value, i++;
+    } else if (arg == "--port") {
+      options.port = std::atoi(value), i++;
+    } else if (arg == "--speed") {
+      options.speed = std::atof(value), i++;
+    } else if (arg == "--packet-samples") {
+      options.packet_samples = std::strtoul(value, nullptr, 10), i++;
+    } else if (arg == "--loss") {
+      options.loss = std::atof(value), i++;
+    } else if (arg == "--jitter-ms") {
+      options.jitter_ms = std::atof(value), i++;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (wav.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Esp32Simulator simulator(options);
+  if (!simulator.loadWav(wav) || !simulator.bind()) {
+    return 1;
+  }
+
+  std::printf("Waiting for hello on UDP port %d\n", options.port);
+  if (!simulator.waitForHello(std::chrono::hours(24))) {
+    return 1;
+  }
+
+  do {
+    std::printf("Streaming %.1f s of audio at %.1fx\n",
+                simulator.samples().size() / double(simulator.sampleRate()),
+                options.speed);
+    if (!simulator.replay()) {
+      return 1;
+    }
+    const SimulatorStats &stats = simulator.stats();
+    std::printf("Sent %llu packets, dropped %llu, reordered %llu\n",
+                (unsigned long long)stats.packets_sent,
+                (unsigned long long)stats.packets_dropped,
+                (unsigned long long)stats.packets_reordered);
+  } while (loop);
+  return 0;
+}
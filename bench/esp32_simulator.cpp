@@ -0,0 +1,210 @@
+#include "esp32_simulator.hpp"
+#include "packet_protocol.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <netinet/in.h>
+#include <numeric>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+template <typename T> static T load_le(const char *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+Esp32Simulator::Esp32Simulator(const SimulatorOptions &options)
+    : options_(options) {
+  options_.packet_samples = std::max<size_t>(options_.packet_samples, 1);
+  options_.speed = options_.speed > 0.0 ? options_.speed : 1.0;
+}
+
+Esp32Simulator::~Esp32Simulator() {
+  if (sock_ >= 0) {
+    ::close(sock_);
+  }
+}
+
+bool Esp32Simulator::loadWav(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  if (data.size() < 12 || std::memcmp(data.data(), "RIFF", 4) != 0 ||
+      std::memcmp(data.data() + 8, "WAVE", 4) != 0) {
+    std::fprintf(stderr, "%s: not a WAV file\n", path.c_str());
+    return false;
+  }
+
+  uint16_t format = 0, channels = 0, bits = 0;
+  size_t pos = 12;
+  while (pos + 8 <= data.size()) {
+    const char *chunk = data.data() + pos;
+    uint32_t size = load_le<uint32_t>(chunk + 4);
+    const char *body = chunk + 8;
+    size = static_cast<uint32_t>(std::min<size_t>(size, data.size() - pos - 8));
+
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      format = load_le<uint16_t>(body);
+      channels = load_le<uint16_t>(body + 2);
+      sample_rate_ = static_cast<int>(load_le<uint32_t>(body + 4));
+      bits = load_le<uint16_t>(body + 14);
+    } else if (std::memcmp(chunk, "data", 4) == 0 && channels > 0) {
+      const size_t frame = channels * (bits / 8);
+      const size_t frames = frame > 0 ? size / frame : 0;
+      samples_.resize(frames);
+      for (size_t i = 0; i < frames; i++) {
+        const char *p = body + i * frame;
+        if (format == 1 && bits == 16) {
+          samples_[i] = load_le<int16_t>(p);
+        } else if (format == 3 && bits == 32) {
+          float v = std::clamp(load_le<float>(p), -1.0f, 1.0f);
+          samples_[i] = static_cast<int16_t>(v * 32767.0f);
+        } else {
+          std::fprintf(stderr, "%s: only 16-bit PCM and float WAV are supported\n",
+                       path.c_str());
+          return false;
+        }
+      }
+      break;
+    }
+    pos += 8 + size + (size & 1);
+  }
+
+  if (samples_.empty()) {
+    std::fprintf(stderr, "%s: no audio found\n", path.c_str());
+    return false;
+  }
+  if (sample_rate_ != 16000) {
+    std::fprintf(stderr, "%s: %d Hz audio is sent as-is, the client expects 16000 Hz\n",
+                 path.c_str(), sample_rate_);
+  }
+  return true;
+}
+
+bool Esp32Simulator::bind() {
+  sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock_ < 0) {
+    std::perror("socket");
+    return false;
+  }
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+  if (::bind(sock_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    std::fprintf(stderr, "Failed to bind UDP port %d: %s\n", options_.port,
+                 std::strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool Esp32Simulator::waitForHello(std::chrono::milliseconds timeout) {
+  const auto deadline = Clock::now() + timeout;
+  char buffer[64];
+  struct sockaddr_in from;
+
+  while (!stopping_ && Clock::now() < deadline) {
+    struct pollfd pfd = {sock_, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(sock_, buffer, sizeof(buffer), 0,
+                         reinterpret_cast<struct sockaddr *>(&from), &from_len);
+    if (n == 5 && std::memcmp(buffer, "hello", 5) == 0) {
+      client_addr_.assign(reinterpret_cast<char *>(&from),
+                          reinterpret_cast<char *>(&from) + from_len);
+      return true;
+    }
+  }
+  return false;
+}
+
+Esp32Simulator::Clock::time_point Esp32Simulator::sampleDue(int64_t sample) const {
+  const double seconds = static_cast<double>(sample) / sample_rate_ / options_.speed;
+  return replay_start_ + std::chrono::duration_cast<Clock::duration>(
+                             std::chrono::duration<double>(seconds));
+}
+
+bool Esp32Simulator::replay() {
+  if (client_addr_.empty()) {
+    return false;
+  }
+
+  const size_t packet_samples = options_.packet_samples;
+  const size_t packets = (samples_.size() + packet_samples - 1) / packet_samples;
+
+  // Precompute the send schedule: a packet leaves when its last sample has
+  // been "recorded", plus its jitter; sorting by that time reorders packets
+  std::mt19937 rng(options_.seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::vector<double> send_s(packets);
+  std::vector<bool> dropped(packets);
+  for (size_t i = 0; i < packets; i++) {
+    size_t end = std::min(samples_.size(), (i + 1) * packet_samples);
+    send_s[i] = static_cast<double>(end) / sample_rate_ / options_.speed +
+                unit(rng) * options_.jitter_ms / 1000.0;
+    dropped[i] = unit(rng) < options_.loss;
+  }
+  std::vector<size_t> order(packets);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return send_s[a] < send_s[b]; });
+
+  std::vector<char> packet(kAudioPacketHeaderSize + packet_samples * sizeof(int16_t));
+  size_t highest_sent = 0;
+  replay_start_ = Clock::now();
+
+  for (size_t i : order) {
+    if (stopping_) {
+      return false;
+    }
+    if (dropped[i]) {
+      stats_.packets_dropped++;
+      continue;
+    }
+    std::this_thread::sleep_until(replay_start_ + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(send_s[i])));
+
+    const size_t first = i * packet_samples;
+    const size_t count = std::min(packet_samples, samples_.size() - first);
+    size_t offset = 0;
+    if (options_.framed) {
+      AudioPacket header;
+      header.stream_id = options_.stream_id;
+      header.sequence = static_cast<uint32_t>(i);
+      header.sample_index = first;
+      header.timestamp_us = static_cast<uint64_t>(
+          static_cast<double>(first) * 1000000.0 / sample_rate_);
+      write_audio_packet_header(header, packet.data());
+      offset = kAudioPacketHeaderSize;
+    }
+    std::memcpy(packet.data() + offset, samples_.data() + first, count * sizeof(int16_t));
+
+    if (sendto(sock_, packet.data(), offset + count * sizeof(int16_t), 0,
+               reinterpret_cast<const struct sockaddr *>(client_addr_.data()),
+               static_cast<socklen_t>(client_addr_.size())) < 0) {
+      std::fprintf(stderr, "sendto failed: %s\n", std::strerror(errno));
+      return false;
+    }
+
+    stats_.packets_sent++;
+    stats_.samples_sent += count;
+    if (stats_.packets_sent > 1 && i < highest_sent) {
+      stats_.packets_reordered++;
+    }
+    highest_sent = std::max(highest_sent, i);
+  }
+  return true;
+}
@@ -0,0 +1,74 @@
+// Local stand-in for the ESP32 microphone: waits for the "hello" datagram
+// that AudioManager::start sends, then streams a WAV file back to the
+// sender the way the board streams its microphone.
+#ifndef ESP32_SIMULATOR_HPP
+#define ESP32_SIMULATOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SimulatorOptions {
+  int port = 5001;
+  // Replay speed; 1.0 is real time
+  double speed = 1.0;
+  size_t packet_samples = 512;
+  // Fraction of packets never sent
+  double loss = 0.0;
+  // Each packet is delayed by a uniform 0..jitter_ms, which also reorders
+  double jitter_ms = 0.0;
+  // WSPK-framed packets; raw int16 PCM like the original firmware otherwise
+  bool framed = true;
+  uint16_t stream_id = 1;
+  uint32_t seed = 1;
+};
+
+struct SimulatorStats {
+  uint64_t packets_sent = 0;
+  uint64_t packets_dropped = 0;
+  uint64_t packets_reordered = 0;
+  uint64_t samples_sent = 0;
+};
+
+class Esp32Simulator {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit Esp32Simulator(const SimulatorOptions &options);
+  ~Esp32Simulator();
+
+  Esp32Simulator(const Esp32Simulator &) = delete;
+  Esp32Simulator &operator=(const Esp32Simulator &) = delete;
+
+  // 16-bit PCM or 32-bit float WAV; the first channel is used
+  bool loadWav(const std::string &path);
+  const std::vector<int16_t> &samples() const { return samples_; }
+  int sampleRate() const { return sample_rate_; }
+
+  bool bind();
+  // Wait for the client's hello; false on timeout or stop()
+  bool waitForHello(std::chrono::milliseconds timeout);
+  // Stream the whole file; returns once the last packet is sent
+  bool replay();
+  void stop() { stopping_ = true; }
+
+  // When replay() started; sample n is due at start + n / rate / speed
+  Clock::time_point replayStart() const { return replay_start_; }
+  Clock::time_point sampleDue(int64_t sample) const;
+  const SimulatorStats &stats() const { return stats_; }
+
+private:
+  SimulatorOptions options_;
+  std::vector<int16_t> samples_;
+  int sample_rate_ = 16000;
+
+  int sock_ = -1;
+  std::vector<char> client_addr_;
+  std::atomic<bool> stopping_{false};
+  Clock::time_point replay_start_;
+  SimulatorStats stats_;
+};
+
+#endif // ESP32_SIMULATOR_HPP
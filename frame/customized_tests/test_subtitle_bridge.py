@@ -0,0 +1,55 @@
+import asyncio
+import json
+import sys
+import time
+from frame_sdk import Frame
+from frame_sdk.display import PaletteColors
+
+# livestreaming --subtitle-socket /tmp/subtitles.sock
+SOCKET_PATH = sys.argv[1] if len(sys.argv) > 1 else "/tmp/subtitles.sock"
+# Updates per second; every refresh costs a BLE round trip
+RATE_HZ = 2
+# Characters that fit on the glasses
+SHOWN_CHARS = 80
+
+
+def apply(state, message):
+    if message.get("r"):
+        state["committed"] = ""
+        state["tail"] = ""
+    state["committed"] += message.get("a", "")
+    if "t" in message:
+        # k counts bytes of the previous tail that are kept
+        kept = state["tail"].encode("utf-8")[:message.get("k", 0)]
+        state["tail"] = kept.decode("utf-8", errors="ignore") + message["t"]
+
+
+async def main():
+    reader, writer = await asyncio.open_unix_connection(SOCKET_PATH)
+    writer.write(f"rate {RATE_HZ}\n".encode())
+    await writer.drain()
+
+    async with Frame() as frame:
+        state = {"committed": "", "tail": ""}
+        shown = ""
+        while True:
+            line = await reader.readline()
+            if not line:
+                print("字幕服务已断开")
+                break
+            apply(state, json.loads(line))
+
+            text = (state["committed"] + state["tail"]).strip()[-SHOWN_CHARS:]
+            if text == shown:
+                continue
+            shown = text
+
+            start_time = time.time()
+            await frame.display.show_text(text, color=PaletteColors.YELLOW)
+            delay = time.time() - start_time
+            print(f"发送: {text} ({len(line)} 字节)")
+            print(f"延迟: {delay:.4f} 秒")
+
+
+# Run the main function
+asyncio.run(main())
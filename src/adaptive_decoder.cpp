@@ -0,0 +1,205 @@
+#include "adaptive_decoder.hpp"
+#include "inference_scheduler.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Window of whisper's own entropy check
+constexpr size_t kEntropyTokens = 32;
+
+int64_t elapsed_us(AdaptiveDecoder::Clock::time_point from,
+                   AdaptiveDecoder::Clock::time_point to) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+std::string state_text(whisper_state *state) {
+  std::string text;
+  const int n_segments = whisper_full_n_segments_from_state(state);
+  for (int i = 0; i < n_segments; ++i) {
+    text += whisper_full_get_segment_text_from_state(state, i);
+  }
+  return text;
+}
+
+} // namespace
+
+DecodeQuality measure_decode(whisper_context *ctx, whisper_state *state,
+                             const whisper_full_params &params,
+                             float min_confidence) {
+  const whisper_token eot = whisper_token_eot(ctx);
+  std::vector<whisper_token> ids;
+  double p_sum = 0.0;
+  double plog_sum = 0.0;
+
+  const int n_segments = whisper_full_n_segments_from_state(state);
+  for (int i = 0; i < n_segments; ++i) {
+    const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+    for (int j = 0; j < n_tokens; ++j) {
+      const whisper_token_data token = whisper_full_get_token_data_from_state(state, i, j);
+      if (token.id >= eot) {
+        continue; // timestamps and other special tokens
+      }
+      ids.push_back(token.id);
+      p_sum += token.p;
+      plog_sum += token.plog;
+    }
+  }
+
+  DecodeQuality quality;
+  quality.tokens = static_cast<int>(ids.size());
+  if (ids.empty()) {
+    return quality; // nothing said, nothing to doubt
+  }
+  quality.confidence = static_cast<float>(p_sum / ids.size());
+  quality.avg_logprob = static_cast<float>(plog_sum / ids.size());
+
+  std::map<whisper_token, int> counts;
+  const size_t window = std::min(kEntropyTokens, ids.size());
+  for (size_t i = ids.size() - window; i < ids.size(); ++i) {
+    counts[ids[i]]++;
+  }
+  double entropy = 0.0;
+  for (const auto &count : counts) {
+    const double p = static_cast<double>(count.second) / window;
+    entropy -= p * std::log(p);
+  }
+  quality.entropy = static_cast<float>(entropy);
+
+  quality.low_confidence = quality.confidence < min_confidence;
+  quality.low_logprob = quality.avg_logprob < params.logprob_thold;
+  // Short output has a low entropy without repeating anything
+  quality.repetitive = ids.size() > kEntropyTokens && quality.entropy < params.entropy_thold;
+  return quality;
+}
+
+AdaptiveDecoder::AdaptiveDecoder(const AdaptiveOptions &options) : options_(options) {
+  // Starting guesses; the first retries of each kind replace them
+  cost_ratio_[Beam] = std::max(1.5, options.beam_size / 2.0);
+  cost_ratio_[Sampled] = 1.5;
+}
+
+int AdaptiveDecoder::decode(whisper_context *ctx, whisper_state *state,
+                            whisper_full_params params, const float *samples,
+                            int n_samples, Clock::time_point deadline,
+                            std::string &text) {
+  static LatencyHistogram &retry_latency = global_metrics().histogram(
+      "adaptive_retry", "Re-decode of a low-confidence segment");
+
+  const bool adaptive =
+      params.strategy == WHISPER_SAMPLING_GREEDY && params.audio_ctx == 0;
+  whisper_full_params first = params;
+  if (adaptive) {
+    // Retries are decided here, with the deadline in view
+    first.temperature = 0.0f;
+    first.temperature_inc = 0.0f;
+  }
+
+  const Clock::time_point started = Clock::now();
+  int ret = whisper_full_timed(ctx, state, first, samples, n_samples);
+  const int64_t first_us = elapsed_us(started, Clock::now());
+  if (ret != 0) {
+    return ret;
+  }
+  text = state_text(state);
+  if (!adaptive) {
+    return ret;
+  }
+
+  const std::string first_text = text;
+  DecodeQuality best = measure_decode(ctx, state, params, options_.min_confidence);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.decodes++;
+    stats_.first_pass_us += static_cast<uint64_t>(first_us);
+    if (!best.ok()) {
+      stats_.unsure++;
+      stats_.low_confidence += best.low_confidence;
+      stats_.low_logprob += best.low_logprob;
+      stats_.repetitive += best.repetitive;
+    }
+  }
+
+  for (int pass = Beam; pass < PassCount && !best.ok(); ++pass) {
+    whisper_full_params retry = first;
+    if (pass == Beam) {
+      if (options_.beam_size <= 1) {
+        continue;
+      }
+      retry.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+      retry.beam_search.beam_size = options_.beam_size;
+    } else {
+      if (options_.temperature <= 0.0f) {
+        continue;
+      }
+      retry.temperature = options_.temperature;
+    }
+
+    double ratio;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ratio = cost_ratio_[pass];
+    }
+    const Clock::time_point retry_start = Clock::now();
+    const int64_t expected_us = static_cast<int64_t>(first_us * ratio);
+    if (retry_start + std::chrono::microseconds(expected_us) > deadline) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.over_budget++;
+      break;
+    }
+
+    const int retry_ret = whisper_full_timed(ctx, state, retry, samples, n_samples);
+    const int64_t retry_us = elapsed_us(retry_start, Clock::now());
+    retry_latency.record(retry_us);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.retries++;
+      stats_.retry_us += static_cast<uint64_t>(retry_us);
+      if (first_us > 0) {
+        cost_ratio_[pass] = 0.7 * cost_ratio_[pass] +
+                            0.3 * static_cast<double>(retry_us) / first_us;
+      }
+    }
+    if (retry_ret != 0) {
+      continue;
+    }
+
+    const DecodeQuality quality =
+        measure_decode(ctx, state, params, options_.min_confidence);
+    // Repeating text is never preferred over text that does not repeat
+    const bool better = quality.repetitive != best.repetitive
+                            ? !quality.repetitive
+                            : quality.avg_logprob > best.avg_logprob;
+    if (better) {
+      best = quality;
+      text = state_text(state);
+    }
+  }
+  if (text != first_text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.improved++;
+  }
+  return ret;
+}
+
+AdaptiveStats AdaptiveDecoder::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string AdaptiveDecoder::describe() const {
+  AdaptiveStats s = getStats();
+  std::ostringstream out;
+  out << "Adaptive decoding: " << s.unsure << " of " << s.decodes << " decodes unsure ("
+      << s.triggerRate() * 100.0 << "%: " << s.low_confidence << " low confidence, "
+      << s.low_logprob << " low logprob, " << s.repetitive << " repetitive), "
+      << s.retries << " retries changed " << s.improved << " texts, " << s.over_budget
+      << " left alone for the deadline, retries cost " << s.retry_us / 1000 << " ms (+"
+      << s.retryOverhead() * 100.0 << "% decode time)";
+  return out.str();
+}
@@ -0,0 +1,99 @@
+#ifndef ADAPTIVE_DECODER_HPP
+#define ADAPTIVE_DECODER_HPP
+
+#include "whisper.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+struct AdaptiveOptions {
+  // Mean token probability below which a decode counts as unsure
+  float min_confidence = 0.6f;
+  // Beam width of the first retry; 0 or 1 goes straight to sampling
+  int beam_size = 5;
+  // Sampling temperature of the last retry; 0 for no sampling retry
+  float temperature = 0.4f;
+  // The mean log probability and token entropy limits are whisper's own
+  // logprob_thold and entropy_thold from the decode params
+};
+
+// How sure whisper was of a decode, from the tokens left in its state
+struct DecodeQuality {
+  int tokens = 0;
+  float confidence = 1.0f; // mean token probability
+  float avg_logprob = 0.0f;
+  // Entropy of the token histogram over the last 32 tokens; repeating
+  // output has little, and is what whisper's compression ratio test
+  // catches in the reference implementation
+  float entropy = 0.0f;
+  bool low_confidence = false;
+  bool low_logprob = false;
+  bool repetitive = false;
+
+  bool ok() const { return !low_confidence && !low_logprob && !repetitive; }
+};
+
+DecodeQuality measure_decode(whisper_context *ctx, whisper_state *state,
+                             const whisper_full_params &params,
+                             float min_confidence);
+
+struct AdaptiveStats {
+  uint64_t decodes = 0;
+  uint64_t unsure = 0; // first pass failed a check
+  uint64_t low_confidence = 0;
+  uint64_t low_logprob = 0;
+  uint64_t repetitive = 0;
+  uint64_t retries = 0;     // extra passes run
+  uint64_t improved = 0;    // decodes that kept a retry's text
+  uint64_t over_budget = 0; // unsure decodes left alone for lack of time
+  uint64_t first_pass_us = 0;
+  uint64_t retry_us = 0;
+
+  double triggerRate() const {
+    return decodes > 0 ? static_cast<double>(unsure) / decodes : 0.0;
+  }
+  // Extra decode time spent on retries, relative to the first passes
+  double retryOverhead() const {
+    return first_pass_us > 0 ? static_cast<double>(retry_us) / first_pass_us : 0.0;
+  }
+};
+
+// Greedy first, and more only where whisper was unsure.
+//
+// decode() runs a plain greedy pass without whisper's built-in temperature
+// fallback, then checks the tokens: mean probability, mean log probability
+// and token entropy. If a check fails and the retry is expected to finish
+// before the deadline, the same audio is decoded again with beam search,
+// then with sampling at a raised temperature, stopping at the first pass
+// that passes the checks. The text with the best mean log probability is
+// kept. Retry costs are learned from the passes run so far.
+class AdaptiveDecoder {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit AdaptiveDecoder(const AdaptiveOptions &options);
+
+  // Decodes `samples` on `state` and sets `text` to the accepted result.
+  // Returns whisper's result code. A beam or fitted audio_ctx first pass
+  // means the caller already chose the decode cost, so it is not retried.
+  int decode(whisper_context *ctx, whisper_state *state, whisper_full_params params,
+             const float *samples, int n_samples, Clock::time_point deadline,
+             std::string &text);
+
+  AdaptiveStats getStats() const;
+  std::string describe() const;
+
+private:
+  // Retry passes, in order of escalation
+  enum Pass { Beam, Sampled, PassCount };
+
+  mutable std::mutex mutex_;
+  AdaptiveOptions options_;
+  AdaptiveStats stats_;
+  // Smoothed cost of each retry pass relative to the greedy pass
+  double cost_ratio_[PassCount];
+};
+
+#endif // ADAPTIVE_DECODER_HPP
@@ -1,14 +1,47 @@
 #include "audio_manager.hpp"
+#include "metrics.hpp"
 #include "params.cpp"
+#include "sample_convert.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
 #include <cstring> // For strlen
 #include <stdexcept>
 #include <sys/stat.h>
+#include <time.h>
+
+// Largest datagram we accept; the ESP32 sends well under this
+static constexpr size_t kMaxDatagramBytes = 2048;
+// Room for SCM_TIMESTAMPNS plus SO_RXQ_OVFL per message
+static constexpr size_t kControlBytes = 128;
+
+static int64_t realtime_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
 
 AudioManager::AudioManager(int sample_rate, const std::string &server_ip,
-                           int server_port)
-    : sample_rate_(sample_rate), server_ip_(server_ip),
-      server_port_(server_port) {
+                           int server_port, int buffer_duration_s,
+                           const IngestOptions &ingest)
+    : sample_rate_(sample_rate),
+      audio_buffer(static_cast<size_t>(sample_rate) * buffer_duration_s),
+      server_ip_(server_ip), server_port_(server_port), ingest_(ingest),
+      converter_(ingest.input, sample_rate),
+      // The jitter buffer counts interleaved samples at the input rate
+      jitter_(static_cast<size_t>(ingest.input.sample_rate) *
+                  converter_.input().channels * ingest.jitter_depth_ms / 1000,
+              static_cast<size_t>(ingest.input.sample_rate) *
+                  converter_.input().channels * kJitterResyncSeconds,
+              ingest.concealment,
+              [this](const int16_t *samples, size_t count) {
+                if (converter_.passthrough()) {
+                  convertInt16ToFloat(samples, count);
+                } else {
+                  ingestPcm(reinterpret_cast<const char *>(samples),
+                            count * sizeof(int16_t), SampleFormat::Int16);
+                }
+              }) {
 
     // Create timestamped directory for logs
     auto now = std::chrono::system_clock::now();
@@ -29,20 +62,40 @@ AudioManager::AudioManager(int sample_rate, const std::string &server_ip,
     throw std::runtime_error("Failed to create socket");
   }
 
-  // Set socket timeout
-  struct timeval tv;
-  tv.tv_sec = 1;
-  tv.tv_usec = 0;
-  setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tv, sizeof(tv));
+  // Large receive buffer so bursts survive while the receive thread is
+  // descheduled; read back what the kernel actually granted
+  int rcvbuf = ingest_.recv_buffer_bytes;
+  setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, (const char *)&rcvbuf, sizeof(rcvbuf));
+  socklen_t optlen = sizeof(recv_buffer_bytes_);
+  getsockopt(sock_, SOL_SOCKET, SO_RCVBUF, (char *)&recv_buffer_bytes_, &optlen);
+
+#ifdef __linux__
+  int on = 1;
+  if (ingest_.kernel_timestamps) {
+    setsockopt(sock_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+  }
+  // Ask for the socket's cumulative drop counter on every datagram
+  setsockopt(sock_, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif
+
+  // Self-pipe used by stop() to wake the receive thread out of poll()
+  if (pipe(wake_pipe_) != 0) {
+    ::close(sock_);
+    throw std::runtime_error("Failed to create wakeup pipe");
+  }
 
   std::cout << "AudioManager initialized, ready to connect to ESP32 at "
             << server_ip_ << ":" << server_port_ << std::endl;
+  if (!converter_.passthrough()) {
+    std::cout << "Converting " << converter_.input().channels << " channel "
+              << converter_.input().sample_rate << " Hz input to mono "
+              << sample_rate_ << " Hz" << std::endl;
+  }
 }
 
 AudioManager::~AudioManager() {
-  if (running_) {
-    stop();
-  }
+  // Also waits for a stop() in progress on another thread
+  stop();
 
 // Close socket
 #ifdef _WIN32
@@ -50,6 +103,8 @@ AudioManager::~AudioManager() {
   WSACleanup();
 #else
   ::close(sock_);
+  ::close(wake_pipe_[0]);
+  ::close(wake_pipe_[1]);
 #endif
 }
 
@@ -58,6 +113,21 @@ bool AudioManager::start() {
     return true;
   }
 
+  if (!ingest_.replay_path.empty()) {
+    replay_ = std::make_unique<PacketCaptureReader>();
+    if (!replay_->open(ingest_.replay_path)) {
+      replay_.reset();
+      return false;
+    }
+    running_ = true;
+    capturing_ = true;
+    receive_thread_ = std::thread(&AudioManager::_replay_loop, this);
+    std::cout << "Replaying " << replay_->packetCount() << " packets ("
+              << (replay_->lastArrivalNs() - replay_->firstArrivalNs()) / 1000000000
+              << " s) from " << ingest_.replay_path << std::endl;
+    return true;
+  }
+
   // Connect to the UDP server (ESP32)
   struct sockaddr_in server_addr;
   server_addr.sin_family = AF_INET;
@@ -78,6 +148,13 @@ bool AudioManager::start() {
     return false;
   }
 
+  if (!ingest_.capture_path.empty()) {
+    capture_ = std::make_unique<PacketCaptureWriter>(ingest_.capture_path, ingest_.input);
+    if (!capture_->isOpen()) {
+      capture_.reset();
+    }
+  }
+
   running_ = true;
   capturing_ = true;
 
@@ -89,132 +166,415 @@ bool AudioManager::start() {
 }
 
 bool AudioManager::stop() {
+  std::lock_guard<std::mutex> stop_lock(stop_mutex_);
   if (!running_) {
     return false;
   }
 
-  running_ = false;
-  capturing_ = false;
+  {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    running_ = false;
+    capturing_ = false;
+  }
+  data_ready_.notify_all();
+
+  const char wake = 1;
+  if (write(wake_pipe_[1], &wake, 1) < 0) {
+    std::cerr << "Failed to wake receive thread: " << strerror(errno)
+              << std::endl;
+  }
 
   if (receive_thread_.joinable()) {
     receive_thread_.join();
   }
+  if (capture_) {
+    capture_->close();
+    const CaptureStats &capture = capture_->stats();
+    std::cout << "Captured " << capture.packets << " packets ("
+              << capture.bytes_written / 1024 << " KB in " << capture.blocks
+              << " blocks) to " << capture_->path() << std::endl;
+  }
+  if (replay_) {
+    std::cout << "Replayed " << packets_.load() << " of " << replay_->packetCount()
+              << " packets from " << ingest_.replay_path << std::endl;
+  }
+
+  IngestStats stats = getStats();
+  std::cout << "Ingest stats: " << stats.packets << " packets, "
+            << stats.batches << " batches, " << stats.kernel_drops
+            << " kernel drops, " << stats.overrun_samples
+            << " overrun samples, " << stats.truncated_packets
+            << " truncated, max arrival gap "
+            << stats.max_arrival_gap_ns / 1000000 << " ms" << std::endl;
+  if (stats.framed_packets > 0) {
+    std::cout << "Jitter stats: " << stats.jitter.lost_packets << " lost, "
+              << stats.jitter.reordered << " reordered, "
+              << stats.jitter.duplicates << " duplicate, " << stats.jitter.late
+              << " late, " << stats.jitter.concealed_samples
+              << " concealed samples, " << stats.jitter.resyncs << " resyncs"
+              << std::endl;
+  }
 
   return true;
 }
 
-bool AudioManager::waitForAudioSegment(std::vector<float> &audio_context, int segment_duration_s) {
-  size_t required_samples = sample_rate_ * segment_duration_s;
+size_t AudioManager::waitForSamples(size_t required_samples) {
+  static LatencyHistogram &buffer_wait = global_metrics().histogram(
+      "buffer_wait", "Consumer blocked waiting for captured audio");
+  if (audio_buffer.size() >= required_samples) {
+    buffer_wait.record(0);
+    return required_samples;
+  }
 
-  while (true) {
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (audio_buffer.size() >= required_samples) {
-        break;
-      }
-    }
+  const auto wait_start = LatencyHistogram::Clock::now();
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wanted_samples_.store(required_samples);
+  // Pairs with the fence in publishSamples so one side always sees
+  // the other's update and no wakeup is lost
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  data_ready_.wait(lock, [&] {
+    return !running_ || input_ended_ || audio_buffer.size() >= required_samples;
+  });
+  wanted_samples_.store(SIZE_MAX);
+  buffer_wait.recordSince(wait_start);
+
+  const size_t available = audio_buffer.size();
+  if (available >= required_samples) {
+    return required_samples;
+  }
+  // The end of a replay is decoded too, even if shorter than asked for
+  return running_ && input_ended_ ? available : 0;
+}
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    if (!running_)
-      return false;
+bool AudioManager::waitForAudioSegment(std::vector<float> &audio_context, int segment_duration_s) {
+  size_t required_samples = waitForSamples(sample_rate_ * segment_duration_s);
+  if (required_samples == 0) {
+    return false;
   }
 
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
+  // Extract exactly one segment from the front of the buffer
+  audio_context.resize(required_samples);
+  audio_buffer.read(audio_context.data(), required_samples);
 
-    // Extract exactly 8 seconds of audio from the front of the buffer
-    audio_context.resize(required_samples);
+  std::cout << "Extracted " << segment_duration_s
+            << "s segment. Remaining buffer size: " << audio_buffer.size()
+            << " samples (" << audio_buffer.size() / sample_rate_
+            << " seconds)" << std::endl;
 
-    // Copy the first 8 seconds to the output vector
-    std::copy(audio_buffer.begin(), audio_buffer.begin() + required_samples,
-              audio_context.begin());
+  return true;
+}
 
-    // Remove the processed 8 seconds from the buffer
-    audio_buffer.erase(audio_buffer.begin(),
-                       audio_buffer.begin() + required_samples);
+bool AudioManager::acquireAudioSegment(AudioSegmentLease &lease,
+                                       int segment_duration_s) {
+  lease.release();
 
-    std::cout << "Extracted 8s segment. Remaining buffer size: "
-              << audio_buffer.size() << " samples ("
-              << audio_buffer.size() / sample_rate_ << " seconds)" << std::endl;
+  size_t required_samples = waitForSamples(sample_rate_ * segment_duration_s);
+  if (required_samples == 0) {
+    return false;
   }
 
-  return true;
-}
-
-bool AudioManager::pollEvents() { return running_; }
+  auto view = audio_buffer.peek(required_samples);
+  lease.owner_ = this;
+  lease.size_ = required_samples;
+
+  if (view.second_size == 0) {
+    // Contiguous in the ring: hand out a pointer into it
+    lease.data_ = view.first;
+  } else {
+    // Wrapped: stitch the two halves together in the pooled scratch buffer
+    lease_scratch_.resize(required_samples);
+    std::copy(view.first, view.first + view.first_size, lease_scratch_.begin());
+    std::copy(view.second, view.second + view.second_size,
+              lease_scratch_.begin() + view.first_size);
+    lease.data_ = lease_scratch_.data();
+  }
 
-void AudioManager::cleanup() { stop(); }
+  std::cout << "Leased " << segment_duration_s
+            << "s segment. Buffered behind it: "
+            << audio_buffer.size() - required_samples << " samples ("
+            << (audio_buffer.size() - required_samples) / sample_rate_
+            << " seconds)" << std::endl;
 
-bool AudioManager::saveAudioSegment(const std::vector<float> &audio_data,
-                                    int segment_count) {
-  std::string filename =
-      log_directory + "/audio_input_" + std::to_string(segment_count) + ".wav";
-  std::ofstream wav_file(filename, std::ios::binary);
+  return true;
+}
 
-  if (!wav_file.is_open()) {
-    std::cerr << "Failed to open file: " << filename << std::endl;
+bool AudioManager::appendNewAudio(std::vector<float> &window,
+                                  size_t min_samples, size_t max_samples) {
+  if (waitForSamples(std::max<size_t>(min_samples, 1)) == 0) {
     return false;
   }
 
-  // Write WAV header
-  writeWavHeader(wav_file, audio_data.size() * sizeof(float));
+  size_t count = std::min(audio_buffer.size(), max_samples);
+  size_t offset = window.size();
+  window.resize(offset + count);
+  audio_buffer.read(window.data() + offset, count);
+  return true;
+}
 
-  // Write audio data
-  wav_file.write(reinterpret_cast<const char *>(audio_data.data()),
-                 audio_data.size() * sizeof(float));
+size_t AudioManager::discardOldest(size_t count) {
+  count = audio_buffer.peek(count).size();
+  audio_buffer.release(count);
+  return count;
+}
 
-  wav_file.close();
-  std::cout << "Saved audio segment to " << filename << std::endl;
-  return true;
+size_t AudioManager::compactOldest(size_t count,
+                                   const std::function<size_t(float *, size_t)> &compact) {
+  auto view = audio_buffer.peek(count);
+  compact_scratch_.resize(view.size());
+  std::copy(view.first, view.first + view.first_size, compact_scratch_.begin());
+  std::copy(view.second, view.second + view.second_size,
+            compact_scratch_.begin() + view.first_size);
+
+  const size_t kept = std::min(compact(compact_scratch_.data(), view.size()), view.size());
+  audio_buffer.replaceOldest(view.size(), compact_scratch_.data(), kept);
+  return view.size() - kept;
 }
 
-bool AudioManager::saveTextOutput(const std::string &text, int segment_count) {
-  std::string filename =
-      log_directory + "/text_output_" + std::to_string(segment_count) + ".txt";
-  std::ofstream text_file(filename);
+void AudioManager::releaseAudioSegment(size_t sample_count) {
+  audio_buffer.release(sample_count);
+}
 
-  if (!text_file.is_open()) {
-    std::cerr << "Failed to open file: " << filename << std::endl;
-    return false;
+AudioSegmentLease &AudioSegmentLease::operator=(AudioSegmentLease &&other) noexcept {
+  if (this != &other) {
+    release();
+    owner_ = other.owner_;
+    data_ = other.data_;
+    size_ = other.size_;
+    other.owner_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
   }
+  return *this;
+}
 
-  text_file << text;
-  text_file.close();
-  std::cout << "Saved transcription to " << filename << std::endl;
-  return true;
+void AudioSegmentLease::release() {
+  if (owner_ != nullptr) {
+    owner_->releaseAudioSegment(size_);
+  }
+  owner_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+bool AudioManager::pollEvents() {
+  // A replay ends once its last audio has been taken
+  return running_ && !(input_ended_ && audio_buffer.size() == 0);
+}
+
+IngestStats AudioManager::getStats() const {
+  IngestStats stats;
+  stats.packets = packets_.load(std::memory_order_relaxed);
+  stats.bytes = bytes_.load(std::memory_order_relaxed);
+  stats.batches = batches_.load(std::memory_order_relaxed);
+  stats.truncated_packets = truncated_packets_.load(std::memory_order_relaxed);
+  stats.kernel_drops = kernel_drops_.load(std::memory_order_relaxed);
+  stats.overrun_samples = overrun_samples_.load(std::memory_order_relaxed);
+  stats.last_arrival_ns = last_arrival_ns_.load(std::memory_order_relaxed);
+  stats.max_arrival_gap_ns = max_arrival_gap_ns_.load(std::memory_order_relaxed);
+  stats.recv_buffer_bytes = recv_buffer_bytes_;
+  stats.framed_packets = framed_packets_.load(std::memory_order_relaxed);
+  stats.legacy_packets = legacy_packets_.load(std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(jitter_stats_mutex_);
+    stats.jitter = jitter_stats_;
+  }
+  return stats;
 }
 
+void AudioManager::cleanup() { stop(); }
+
 void AudioManager::_receive_loop() {
-  const size_t buffer_size = 2048;
-  char buffer[buffer_size];
-  struct sockaddr_in sender_addr;
-  socklen_t sender_addr_size = sizeof(sender_addr);
+  const size_t batch = static_cast<size_t>(std::max(1, ingest_.recv_batch));
+  std::vector<char> buffers(batch * kMaxDatagramBytes);
+
+#ifdef __linux__
+  std::vector<struct mmsghdr> msgs(batch);
+  std::vector<struct iovec> iovs(batch);
+  std::vector<char> controls(batch * kControlBytes);
+#endif
+
+  struct pollfd fds[2];
+  fds[0].fd = sock_;
+  fds[0].events = POLLIN;
+  fds[1].fd = wake_pipe_[0];
+  fds[1].events = POLLIN;
 
   while (running_) {
-    try {
-      int received_bytes =
-          recvfrom(sock_, buffer, buffer_size, 0,
-                   (struct sockaddr *)&sender_addr, &sender_addr_size);
-
-      if (received_bytes > 0) {
-        // Process as int16 data
-        int16_t *int16_data = reinterpret_cast<int16_t *>(buffer);
-        int sample_count = received_bytes / 2; // Each sample is 2 bytes
-
-        // Check for leading zeros and skip if necessary
-        int start_idx = 0;
-        if (sample_count >= 2 && int16_data[0] == 0 && int16_data[1] == 0) {
-          start_idx = 2;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "Error polling socket: " << strerror(errno) << std::endl;
+      break;
+    }
+    if (fds[1].revents & POLLIN) {
+      break; // stop() requested
+    }
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
+
+#ifdef __linux__
+    // Drain up to `batch` datagrams with a single syscall
+    for (size_t i = 0; i < batch; i++) {
+      iovs[i].iov_base = &buffers[i * kMaxDatagramBytes];
+      iovs[i].iov_len = kMaxDatagramBytes;
+      std::memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = &controls[i * kControlBytes];
+      msgs[i].msg_hdr.msg_controllen = kControlBytes;
+    }
+
+    int received = recvmmsg(sock_, msgs.data(), batch, MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        std::cerr << "Error receiving data: " << strerror(errno) << std::endl;
+      }
+      continue;
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+
+    const int64_t now_ns = realtime_ns();
+    for (int i = 0; i < received; i++) {
+      struct msghdr &hdr = msgs[i].msg_hdr;
+      int64_t arrival_ns = now_ns;
+
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+           cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+          continue;
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+          struct timespec ts;
+          std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          arrival_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        } else if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+          uint32_t dropped;
+          std::memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+          kernel_drops_.store(dropped, std::memory_order_relaxed);
         }
+      }
 
-        // Convert int16 samples to float and add to buffer
-        convertInt16ToFloat(&int16_data[start_idx], sample_count - start_idx);
+      if (hdr.msg_flags & MSG_TRUNC) {
+        truncated_packets_.fetch_add(1, std::memory_order_relaxed);
+      }
+      if (capture_) {
+        capture_->append(&buffers[i * kMaxDatagramBytes], msgs[i].msg_len, arrival_ns);
+      }
+      handlePacket(&buffers[i * kMaxDatagramBytes], msgs[i].msg_len, arrival_ns);
+    }
+#else
+    // No recvmmsg: drain what is queued one datagram at a time
+    size_t received = 0;
+    for (; received < batch; received++) {
+      ssize_t received_bytes =
+          recv(sock_, buffers.data(), kMaxDatagramBytes, MSG_DONTWAIT);
+      if (received_bytes < 0) {
+        break;
+      }
+      const int64_t arrival_ns = realtime_ns();
+      if (capture_) {
+        capture_->append(buffers.data(), received_bytes, arrival_ns);
+      }
+      handlePacket(buffers.data(), received_bytes, arrival_ns);
+    }
+    if (received > 0) {
+      batches_.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+  }
+}
+
+void AudioManager::_replay_loop() {
+  const float speed = ingest_.replay_speed;
+  const int64_t first_ns = replay_->firstArrivalNs();
+  const auto started = std::chrono::steady_clock::now();
+  CapturedPacket packet;
+
+  while (running_ && replay_->next(packet)) {
+    if (speed > 0.0f) {
+      const auto due = started + std::chrono::nanoseconds(static_cast<int64_t>(
+                                     (packet.arrival_ns - first_ns) / speed));
+      // Short naps so stop() is never held up by a long recorded gap
+      for (auto now = std::chrono::steady_clock::now(); running_ && now < due;
+           now = std::chrono::steady_clock::now()) {
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            due - now, std::chrono::milliseconds(50)));
+      }
+    } else {
+      // Run ahead only while the consumer waits for audio, so the backlog
+      // reflects decoding rather than how fast the file can be read
+      while (running_ && audio_buffer.size() >= static_cast<size_t>(sample_rate_) &&
+             wanted_samples_.load() == SIZE_MAX) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
       }
-    } catch (const std::exception &e) {
-      std::cerr << "Error receiving data: " << e.what() << std::endl;
-      std::this_thread::sleep_for(std::chrono::seconds(1));
     }
+    if (!running_) {
+      break;
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    handlePacket(packet.data, packet.size, realtime_ns());
+  }
+
+  // Framed packets still held for reordering go out with the rest
+  jitter_.flush();
+  {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    input_ended_ = true;
+  }
+  data_ready_.notify_all();
+}
+
+void AudioManager::handlePacket(const char *data, size_t size,
+                                int64_t arrival_ns) {
+  // Kernel arrival to samples in the ring (or the jitter buffer)
+  static LatencyHistogram &packet_ingest = global_metrics().histogram(
+      "packet_ingest", "Packet kernel arrival to buffered");
+  packets_.fetch_add(1, std::memory_order_relaxed);
+  bytes_.fetch_add(size, std::memory_order_relaxed);
+
+  int64_t previous_ns = last_arrival_ns_.exchange(arrival_ns, std::memory_order_relaxed);
+  if (previous_ns != 0 && arrival_ns - previous_ns > max_arrival_gap_ns_.load(std::memory_order_relaxed)) {
+    max_arrival_gap_ns_.store(arrival_ns - previous_ns, std::memory_order_relaxed);
+  }
+
+  if (size < 2) {
+    return;
+  }
+
+  // Sequenced packets go through the jitter buffer, which restores order
+  // and conceals gaps before the samples reach the ring
+  AudioPacket packet;
+  if (parse_audio_packet(data, size, packet)) {
+    framed_packets_.fetch_add(1, std::memory_order_relaxed);
+    jitter_.push(packet);
+    if (jitter_stats_mutex_.try_lock()) {
+      jitter_stats_ = jitter_.stats();
+      jitter_stats_mutex_.unlock();
+    }
+    packet_ingest.record((realtime_ns() - arrival_ns) / 1000);
+    return;
+  }
+  legacy_packets_.fetch_add(1, std::memory_order_relaxed);
+
+  if (!converter_.passthrough()) {
+    ingestPcm(data, size, ingest_.input.format);
+    packet_ingest.record((realtime_ns() - arrival_ns) / 1000);
+    return;
+  }
+
+  // Legacy raw PCM: process as int16 data
+  const int16_t *int16_data = reinterpret_cast<const int16_t *>(data);
+  size_t sample_count = size / 2; // Each sample is 2 bytes
+
+  // Check for leading zeros and skip if necessary
+  size_t start_idx = 0;
+  if (sample_count >= 2 && int16_data[0] == 0 && int16_data[1] == 0) {
+    start_idx = 2;
   }
+
+  // Convert int16 samples to float and add to buffer
+  convertInt16ToFloat(&int16_data[start_idx], sample_count - start_idx);
+  packet_ingest.record((realtime_ns() - arrival_ns) / 1000);
 }
 
 void AudioManager::convertInt16ToFloat(const int16_t *int16_data,
@@ -222,43 +582,41 @@ void AudioManager::convertInt16ToFloat(const int16_t *int16_data,
   if (sample_count == 0)
     return;
 
-  std::lock_guard<std::mutex> lock(mutex_);
+  // Convert int16 to float [-1.0, 1.0] straight into the ring; never blocks
+  size_t written = audio_buffer.produce(
+      sample_count, [int16_data](float *dst, size_t offset, size_t count) {
+        convert_int16_to_float(int16_data + offset, dst, count);
+      });
+  publishSamples(sample_count, written);
+}
 
-  // Reserve space to avoid reallocations
-  size_t original_size = audio_buffer.size();
+void AudioManager::ingestPcm(const char *data, size_t bytes, SampleFormat format) {
+  const std::vector<float> &samples = converter_.convert(data, bytes, format);
+  pushSamples(samples.data(), samples.size());
+}
 
-  // Convert int16 to float [-1.0, 1.0] and add to buffer
-  for (size_t i = 0; i < sample_count; i++) {
-    // Normalize to [-1, 1] range
-    audio_buffer.push_back(int16_data[i] / 32768.0f);
-  }
+void AudioManager::pushSamples(const float *samples, size_t sample_count) {
+  if (sample_count == 0)
+    return;
+
+  size_t written = audio_buffer.produce(
+      sample_count, [samples](float *dst, size_t offset, size_t count) {
+        std::copy(samples + offset, samples + offset + count, dst);
+      });
+  publishSamples(sample_count, written);
 }
 
-void AudioManager::writeWavHeader(std::ofstream &file, size_t data_size_bytes) {
-  // RIFF header
-  file.write("RIFF", 4);
-  uint32_t file_size = 36 + data_size_bytes;
-  file.write(reinterpret_cast<const char *>(&file_size), 4);
-  file.write("WAVE", 4);
-
-  // fmt subchunk
-  file.write("fmt ", 4);
-  uint32_t subchunk1_size = 16;
-  uint16_t audio_format = 3; // IEEE float
-  uint16_t num_channels = 1; // Mono
-  uint32_t byte_rate = sample_rate_ * num_channels * sizeof(float);
-  uint16_t block_align = num_channels * sizeof(float);
-  uint16_t bits_per_sample = 32; // 32-bit float
-
-  file.write(reinterpret_cast<const char *>(&subchunk1_size), 4);
-  file.write(reinterpret_cast<const char *>(&audio_format), 2);
-  file.write(reinterpret_cast<const char *>(&num_channels), 2);
-  file.write(reinterpret_cast<const char *>(&sample_rate_), 4);
-  file.write(reinterpret_cast<const char *>(&byte_rate), 4);
-  file.write(reinterpret_cast<const char *>(&block_align), 2);
-  file.write(reinterpret_cast<const char *>(&bits_per_sample), 2);
-
-  // data subchunk
-  file.write("data", 4);
-  file.write(reinterpret_cast<const char *>(&data_size_bytes), 4);
+void AudioManager::publishSamples(size_t sample_count, size_t written) {
+  // The consumer fell a whole buffer behind; drop the newest samples
+  if (written < sample_count) {
+    overrun_samples_.fetch_add(sample_count - written,
+                               std::memory_order_relaxed);
+  }
+
+  // Wake the consumer only when its threshold is crossed
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (audio_buffer.size() >= wanted_samples_.load()) {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    data_ready_.notify_one();
+  }
 }
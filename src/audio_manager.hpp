@@ -3,14 +3,22 @@
 
 #include <atomic>
 #include <chrono>
-#include <deque> // Using deque for efficient front removal
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "jitter_buffer.hpp"
+#include "packet_capture.hpp"
+#include "resampler.hpp"
+#include "ring_buffer.hpp"
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -20,6 +28,7 @@ typedef int socklen_t;
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #define SOCKET int
@@ -27,37 +36,149 @@ typedef int socklen_t;
 #define SOCKET_ERROR -1
 #endif
 
+class AudioManager;
+
+// Socket-level tuning for the UDP receive path
+struct IngestOptions {
+  // Requested SO_RCVBUF in bytes (the kernel may clamp or double it)
+  int recv_buffer_bytes = 4 * 1024 * 1024;
+  // Datagrams drained per recvmmsg() call
+  int recv_batch = 32;
+  // Record SO_TIMESTAMPNS kernel arrival times
+  bool kernel_timestamps = true;
+  // How much later audio may queue behind a missing framed packet before
+  // the gap is concealed
+  int jitter_depth_ms = 60;
+  ConcealmentMode concealment = ConcealmentMode::Interpolate;
+  // What the sender captures; anything other than mono int16 at the
+  // pipeline rate is downmixed and resampled in the receive thread.
+  // Framed packets are always int16 but follow the rate and channels.
+  AudioFormat input;
+  // Record every datagram with its arrival time to this file
+  std::string capture_path;
+  // Read datagrams from a capture instead of the network
+  std::string replay_path;
+  // Replay timing: 1 as recorded, 2 twice as fast, 0 as fast as the
+  // consumer takes the audio
+  float replay_speed = 1.0f;
+};
+
+// Ingest counters, safe to read from any thread
+struct IngestStats {
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  uint64_t batches = 0;
+  uint64_t truncated_packets = 0;
+  // Datagrams the kernel dropped because the socket buffer was full
+  uint64_t kernel_drops = 0;
+  // Samples dropped because the consumer fell a whole ring behind
+  uint64_t overrun_samples = 0;
+  // Kernel arrival time of the newest packet (CLOCK_REALTIME ns)
+  int64_t last_arrival_ns = 0;
+  // Largest gap seen between consecutive packet arrivals
+  int64_t max_arrival_gap_ns = 0;
+  int recv_buffer_bytes = 0;
+  // Packets with and without the sequenced header
+  uint64_t framed_packets = 0;
+  uint64_t legacy_packets = 0;
+  JitterStats jitter;
+};
+
+// Read-only view of one audio segment, borrowed from AudioManager's ring
+// buffer. The samples stay valid until the lease is released or destroyed;
+// only one lease can be outstanding at a time.
+class AudioSegmentLease {
+public:
+  AudioSegmentLease() = default;
+  ~AudioSegmentLease() { release(); }
+  AudioSegmentLease(AudioSegmentLease &&other) noexcept { *this = std::move(other); }
+  AudioSegmentLease &operator=(AudioSegmentLease &&other) noexcept;
+  AudioSegmentLease(const AudioSegmentLease &) = delete;
+  AudioSegmentLease &operator=(const AudioSegmentLease &) = delete;
+
+  const float *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Return the samples to the ring so the receive thread can reuse them
+  void release();
+
+private:
+  friend class AudioManager;
+
+  AudioManager *owner_ = nullptr;
+  const float *data_ = nullptr;
+  size_t size_ = 0;
+};
+
 class AudioManager {
 public:
   AudioManager(int sample_rate, const std::string &server_ip = "192.168.4.1",
-               int server_port = 5001);
+               int server_port = 5001, int buffer_duration_s = 120,
+               const IngestOptions &ingest = IngestOptions());
   ~AudioManager();
 
   bool start();
   bool stop();
   bool waitForAudioSegment(std::vector<float> &audio_context, int segment_duration_s);
+  // Block until a full segment is buffered and lease it without copying
+  bool acquireAudioSegment(AudioSegmentLease &lease, int segment_duration_s);
+  // Block until at least min_samples are buffered, then move everything
+  // buffered (up to max_samples) onto the end of `window`
+  bool appendNewAudio(std::vector<float> &window, size_t min_samples,
+                      size_t max_samples = SIZE_MAX);
   bool pollEvents();
   void cleanup();
-
-  // New methods for segment handling
-  bool saveAudioSegment(const std::vector<float> &audio_data,
-                        int segment_count);
-  bool saveTextOutput(const std::string &text, int segment_count);
+  IngestStats getStats() const;
+  // Samples captured but not yet taken by the consumer; safe to sample
+  // from any thread
+  size_t bufferedSamples() const { return audio_buffer.size(); }
+  size_t capacitySamples() const { return audio_buffer.capacity(); }
+  // Consumer, with no lease outstanding: drop the oldest `count` buffered
+  // samples. Returns how many were dropped.
+  size_t discardOldest(size_t count);
+  // Consumer, with no lease outstanding: `compact` rewrites the oldest
+  // `count` buffered samples, moving the ones to keep to the front, and
+  // returns how many it kept; the rest are dropped. Returns the number
+  // dropped.
+  size_t compactOldest(size_t count, const std::function<size_t(float *, size_t)> &compact);
 
   std::string log_directory;
 
 private:
+  friend class AudioSegmentLease;
+
   void _receive_loop();
-  void writeWavHeader(std::ofstream &file, size_t data_size_bytes);
+  void _replay_loop();
+  void handlePacket(const char *data, size_t size, int64_t arrival_ns);
+  // Samples the consumer may take: required_samples, whatever is left
+  // once a replay has ended, or 0 when stopping
+  size_t waitForSamples(size_t required_samples);
+  void releaseAudioSegment(size_t sample_count);
   void convertInt16ToFloat(const int16_t *int16_data, size_t sample_count);
+  // Declared-format PCM through the converter into the ring
+  void ingestPcm(const char *data, size_t bytes, SampleFormat format);
+  void pushSamples(const float *samples, size_t sample_count);
+  void publishSamples(size_t sample_count, size_t written);
 
   int sample_rate_;
 
-  std::mutex mutex_;
   std::atomic<bool> capturing_{false};
 
-  // Using deque for efficient front removal
-  std::deque<float> audio_buffer;
+  // Written only by the receive thread, read only by the consumer
+  SpscRingBuffer<float> audio_buffer;
+  std::atomic<uint64_t> overrun_samples_{0};
+
+  // The consumer publishes how many samples it is waiting for; the receive
+  // thread only touches the mutex when it crosses that threshold.
+  std::mutex wait_mutex_;
+  std::condition_variable data_ready_;
+  std::atomic<size_t> wanted_samples_{SIZE_MAX};
+
+  // Reused when a leased segment wraps around the end of the ring
+  std::vector<float> lease_scratch_;
+  // Reused by compactOldest()
+  std::vector<float> compact_scratch_;
 
   // UDP connection
   std::string server_ip_;
@@ -65,6 +186,36 @@ private:
   SOCKET sock_;
   std::thread receive_thread_;
   std::atomic<bool> running_{false};
+  // stop() may be called from a signal-watching thread as well
+  std::mutex stop_mutex_;
+
+  // Batched ingest; stop() writes to wake_pipe_ to interrupt poll()
+  IngestOptions ingest_;
+  // Receive thread only
+  PcmConverter converter_;
+  int wake_pipe_[2] = {-1, -1};
+  int recv_buffer_bytes_ = 0;
+  std::atomic<uint64_t> packets_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> truncated_packets_{0};
+  std::atomic<uint64_t> kernel_drops_{0};
+  std::atomic<int64_t> last_arrival_ns_{0};
+  std::atomic<int64_t> max_arrival_gap_ns_{0};
+  std::atomic<uint64_t> framed_packets_{0};
+  std::atomic<uint64_t> legacy_packets_{0};
+
+  // Receive thread only, once started
+  std::unique_ptr<PacketCaptureWriter> capture_;
+  std::unique_ptr<PacketCaptureReader> replay_;
+  // Every replayed packet has been handed to the ring
+  std::atomic<bool> input_ended_{false};
+
+  // Reorders framed packets; owned by the receive thread, which publishes
+  // a stats snapshot with try_lock so it never waits on a reader
+  JitterBuffer jitter_;
+  mutable std::mutex jitter_stats_mutex_;
+  JitterStats jitter_stats_;
 };
 
 #endif // AUDIO_MANAGER_HPP
@@ -0,0 +1,148 @@
+#include "compute_governor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+// Encoder positions per second of audio (1500 for 30 s)
+static constexpr int kAudioCtxPerSecond = 50;
+static constexpr int kFullAudioCtx = 1500;
+// Extra frames so words at the very end are not cut off
+static constexpr int kAudioCtxMargin = 64;
+
+void DecodeSettings::apply(whisper_full_params &params, size_t n_samples,
+                           int n_threads, int sample_rate) const {
+  if (beam_size > 1) {
+    params.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+    params.beam_search.beam_size = beam_size;
+  } else {
+    params.strategy = WHISPER_SAMPLING_GREEDY;
+  }
+
+  if (fit_audio_ctx) {
+    const double seconds = static_cast<double>(n_samples) / sample_rate;
+    int ctx = static_cast<int>(std::ceil(seconds * kAudioCtxPerSecond)) + kAudioCtxMargin;
+    params.audio_ctx = ctx < kFullAudioCtx ? ctx : 0;
+  }
+
+  params.n_threads = thread_cap > 0 ? std::min(n_threads, thread_cap) : n_threads;
+}
+
+ComputeGovernor::ComputeGovernor(InferenceScheduler &primary,
+                                 InferenceScheduler *fallback,
+                                 const GovernorOptions &options)
+    : primary_(primary), fallback_(fallback), options_(options) {
+  options_.min_threads = std::max(1, options_.min_threads);
+  options_.settle_decodes = std::max(1, options_.settle_decodes);
+
+  if (options_.beam_size > 1) {
+    tiers_.push_back({"beam " + std::to_string(options_.beam_size),
+                      options_.beam_size, false, false});
+  }
+  tiers_.push_back({"greedy", 0, false, false});
+  tiers_.push_back({"greedy, fitted audio_ctx", 0, true, false});
+  if (fallback_ != nullptr) {
+    tiers_.push_back({"fallback model", 0, true, true});
+  }
+}
+
+DecodeSettings ComputeGovernor::current() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const GovernorTier &tier = tiers_[stats_.tier];
+  DecodeSettings settings;
+  settings.scheduler = tier.fallback_model ? fallback_ : &primary_;
+  settings.tier = stats_.tier;
+  settings.beam_size = tier.beam_size;
+  settings.fit_audio_ctx = tier.fit_audio_ctx;
+  settings.thread_cap = stats_.thread_cap;
+  return settings;
+}
+
+void ComputeGovernor::record(double audio_s, double decode_s, double backlog_s,
+                             int n_threads) {
+  if (audio_s <= 0.0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const double rtf = decode_s / audio_s;
+  // Start fresh after a change so the old settings don't linger
+  stats_.smoothed_rtf = measured_ ? stats_.smoothed_rtf * (1.0 - options_.smoothing) +
+                                        rtf * options_.smoothing
+                                  : rtf;
+  measured_ = true;
+  stats_.backlog_s = backlog_s;
+  stats_.decodes++;
+
+  if (settle_ > 0) {
+    settle_--;
+    return;
+  }
+
+  const GovernorStats before = stats_;
+  // The scheduler's grant, less any cap already in force
+  const int threads = stats_.thread_cap > 0 ? std::min(n_threads, stats_.thread_cap)
+                                            : n_threads;
+  const bool behind = stats_.smoothed_rtf > options_.target_rtf ||
+                      backlog_s > options_.max_backlog_s;
+  const bool headroom = stats_.smoothed_rtf < options_.headroom_rtf &&
+                        backlog_s < options_.max_backlog_s / 2;
+
+  if (behind) {
+    if (stats_.thread_cap > 0) {
+      stats_.thread_cap = 0;
+      change("behind, lifting thread cap", before);
+    } else if (stats_.tier + 1 < tiers_.size()) {
+      stats_.tier++;
+      stats_.step_downs++;
+      change("behind", before);
+    }
+  } else if (headroom) {
+    if (stats_.tier > 0) {
+      stats_.tier--;
+      stats_.step_ups++;
+      change("headroom", before);
+    } else if (stats_.smoothed_rtf < options_.headroom_rtf / 2 &&
+               threads > options_.min_threads) {
+      // Already at the best tier: hand back a core
+      stats_.thread_cap = threads - 1;
+      change("headroom, capping threads", before);
+    }
+  }
+}
+
+void ComputeGovernor::change(const std::string &reason, const GovernorStats &before) {
+  measured_ = false;
+  settle_ = options_.settle_decodes;
+
+  std::ostringstream line;
+  line << "Governor: " << reason << " (rtf " << before.smoothed_rtf << ", backlog "
+       << before.backlog_s << " s): " << tiers_[before.tier].name;
+  if (before.thread_cap > 0) {
+    line << " on " << before.thread_cap << " threads";
+  }
+  line << " -> " << tiers_[stats_.tier].name;
+  if (stats_.thread_cap > 0) {
+    line << " on " << stats_.thread_cap << " threads";
+  }
+  std::cout << line.str() << std::endl;
+}
+
+GovernorStats ComputeGovernor::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string ComputeGovernor::describe() const {
+  GovernorStats s = getStats();
+  std::ostringstream out;
+  out << "Governor: " << tiers_[s.tier].name;
+  if (s.thread_cap > 0) {
+    out << " on " << s.thread_cap << " threads";
+  }
+  out << ", rtf " << s.smoothed_rtf << ", backlog " << s.backlog_s << " s, "
+      << s.step_downs << " steps down, " << s.step_ups << " up over "
+      << s.decodes << " decodes";
+  return out.str();
+}
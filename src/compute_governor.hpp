@@ -0,0 +1,97 @@
+#ifndef COMPUTE_GOVERNOR_HPP
+#define COMPUTE_GOVERNOR_HPP
+
+#include "inference_scheduler.hpp"
+#include "whisper.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct GovernorOptions {
+  int sample_rate = 16000;
+  // Decode time per second of audio the governor steers below
+  float target_rtf = 0.8f;
+  // Settings only step back up below this, so they don't flap
+  float headroom_rtf = 0.4f;
+  // Captured audio waiting longer than this counts as falling behind
+  float max_backlog_s = 10.0f;
+  // Decodes to let a change settle before judging it again
+  int settle_decodes = 3;
+  // Weight of the newest decode in the smoothed real-time factor
+  float smoothing = 0.3f;
+  // Beam width for the best tier; 0 or 1 never uses beam search
+  int beam_size = 0;
+  int min_threads = 1;
+};
+
+// One rung of the quality/speed ladder, best quality first
+struct GovernorTier {
+  std::string name;
+  int beam_size = 0;          // > 1 selects beam search
+  bool fit_audio_ctx = false; // encode only the frames the audio needs
+  bool fallback_model = false;
+};
+
+// Settings for one decode, taken with ComputeGovernor::current()
+struct DecodeSettings {
+  InferenceScheduler *scheduler = nullptr;
+  size_t tier = 0;
+  int beam_size = 0;
+  bool fit_audio_ctx = false;
+  int thread_cap = 0; // 0 = whatever the scheduler grants
+
+  // Rewrite params for a decode of `n_samples` on `n_threads` threads
+  void apply(whisper_full_params &params, size_t n_samples, int n_threads,
+             int sample_rate) const;
+};
+
+struct GovernorStats {
+  uint64_t decodes = 0;
+  uint64_t step_downs = 0;
+  uint64_t step_ups = 0;
+  double smoothed_rtf = 0.0;
+  double backlog_s = 0.0;
+  size_t tier = 0;
+  int thread_cap = 0;
+};
+
+// Keeps decoding at real time on hosts that cannot afford the configured
+// settings.
+//
+// After every decode the caller reports the audio it covered, the decode
+// time and how much captured audio is still waiting. When the smoothed
+// real-time factor passes the target or the backlog grows too long, the
+// governor first lifts any thread cap it set, then walks down the ladder:
+// beam -> greedy -> truncated audio_ctx -> the preloaded fallback model.
+// With enough headroom it walks back up, and once at the top it gives
+// back threads it does not need. Every change is logged.
+class ComputeGovernor {
+public:
+  // `fallback` may be null; it runs a smaller model on its own states
+  ComputeGovernor(InferenceScheduler &primary, InferenceScheduler *fallback,
+                  const GovernorOptions &options);
+
+  DecodeSettings current() const;
+  void record(double audio_s, double decode_s, double backlog_s, int n_threads);
+
+  const std::vector<GovernorTier> &tiers() const { return tiers_; }
+  GovernorStats getStats() const;
+  std::string describe() const;
+
+private:
+  void change(const std::string &reason, const GovernorStats &before);
+
+  InferenceScheduler &primary_;
+  InferenceScheduler *fallback_;
+  GovernorOptions options_;
+  std::vector<GovernorTier> tiers_;
+
+  mutable std::mutex mutex_;
+  GovernorStats stats_;
+  bool measured_ = false;
+  int settle_ = 0;
+};
+
+#endif // COMPUTE_GOVERNOR_HPP
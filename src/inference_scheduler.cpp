@@ -0,0 +1,335 @@
+#include "inference_scheduler.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+static int64_t elapsed_us(InferenceScheduler::Clock::time_point from,
+                          InferenceScheduler::Clock::time_point to) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+}
+
+InferenceScheduler::InferenceScheduler(whisper_context *ctx,
+                                       const SchedulerOptions &options)
+    : ctx_(ctx), options_(options) {
+  options_.workers = std::max(1, options_.workers);
+  total_threads_ = options_.total_threads > 0
+                       ? options_.total_threads
+                       : static_cast<int>(std::thread::hardware_concurrency());
+  total_threads_ = std::max(total_threads_, 1);
+  base_threads_ = std::max(1, total_threads_ / options_.workers);
+}
+
+InferenceScheduler::~InferenceScheduler() { stop(); }
+
+bool InferenceScheduler::start() {
+  for (int i = 0; i < options_.workers; i++) {
+    whisper_state *state = whisper_init_state(ctx_);
+    if (state == nullptr) {
+      std::cerr << "Failed to allocate whisper state for decode worker " << i
+                << std::endl;
+      break;
+    }
+    states_.push_back(state);
+  }
+  if (states_.empty()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < states_.size(); i++) {
+    threads_.emplace_back(&InferenceScheduler::workerLoop, this, static_cast<int>(i));
+  }
+  return true;
+}
+
+void InferenceScheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+
+  // swapModel() and submit() read threads_ under the lock
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads.swap(threads_);
+  }
+  for (auto &thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto *state : states_) {
+    whisper_free_state(state);
+  }
+  states_.clear();
+}
+
+whisper_context *InferenceScheduler::swapModel(whisper_context *ctx) {
+  // One swap at a time
+  std::lock_guard<std::mutex> swap_lock(swap_mutex_);
+  size_t workers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || threads_.empty()) {
+      return nullptr;
+    }
+    workers = states_.size();
+  }
+
+  std::vector<whisper_state *> states;
+  for (size_t i = 0; i < workers; i++) {
+    whisper_state *state = whisper_init_state(ctx);
+    if (state == nullptr) {
+      std::cerr << "Failed to allocate whisper state for the new model" << std::endl;
+      for (auto *allocated : states) {
+        whisper_free_state(allocated);
+      }
+      return nullptr;
+    }
+    states.push_back(state);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  // stop() may have joined the workers while the states were allocated
+  if (stopping_ || threads_.empty()) {
+    lock.unlock();
+    for (auto *allocated : states) {
+      whisper_free_state(allocated);
+    }
+    return nullptr;
+  }
+  whisper_context *previous = ctx_;
+  ctx_ = ctx;
+  next_states_ = std::move(states);
+  migrated_ = 0;
+  generation_++;
+  work_cv_.notify_all();
+  // The workers were running when the generation changed, and each one
+  // migrates before it can exit, so this completes even if stop() is
+  // called now. Returning on stopping_ instead would hand back a context
+  // a worker may still be using.
+  swapped_cv_.wait(lock, [this] { return migrated_ == next_states_.size(); });
+  next_states_.clear();
+  return previous;
+}
+
+std::future<JobTiming> InferenceScheduler::submit(std::string name,
+                                                  Clock::time_point deadline,
+                                                  Job job) {
+  auto pending = std::make_shared<Pending>();
+  pending->name = std::move(name);
+  pending->deadline = deadline;
+  pending->submitted = Clock::now();
+  pending->job = std::move(job);
+  std::future<JobTiming> result = pending->done.get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || threads_.empty()) {
+      // Nobody will run it; the job is dropped without being called
+      pending->done.set_value(JobTiming{});
+      return result;
+    }
+    pending->seq = next_seq_++;
+    pending_.push(std::move(pending));
+    stats_.max_pending = std::max(stats_.max_pending, pending_.size());
+  }
+  work_cv_.notify_one();
+  return result;
+}
+
+JobTiming InferenceScheduler::run(std::string name, Clock::time_point deadline,
+                                  Job job) {
+  return submit(std::move(name), deadline, std::move(job)).get();
+}
+
+size_t InferenceScheduler::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.size();
+}
+
+void InferenceScheduler::workerLoop(int worker) {
+  whisper_context *ctx;
+  whisper_state *state;
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ctx = ctx_;
+    state = states_[worker];
+    generation = generation_;
+  }
+  LatencyHistogram &queue_wait =
+      global_metrics().histogram("decode_queue_wait", "Decode job submit to start");
+  LatencyHistogram &service =
+      global_metrics().histogram("decode_service", "Decode job start to finish");
+
+  while (true) {
+    std::shared_ptr<Pending> pending;
+    whisper_state *retired = nullptr;
+    int threads = base_threads_;
+    bool stolen = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [&] {
+        return stopping_ || !pending_.empty() || generation != generation_;
+      });
+      if (generation != generation_) {
+        // Between jobs, so nothing uses the old state any more
+        retired = state;
+        ctx = ctx_;
+        state = next_states_[worker];
+        states_[worker] = state;
+        generation = generation_;
+      } else if (pending_.empty()) {
+        break; // stopping and drained
+      } else {
+        pending = pending_.top();
+        pending_.pop();
+
+        // Nothing else waiting: borrow whatever the busy workers leave idle
+        if (pending_.empty()) {
+          int idle = total_threads_ - busy_threads_ - base_threads_;
+          if (idle > 0) {
+            threads += idle;
+            stolen = true;
+          }
+        }
+        busy_threads_ += threads;
+      }
+    }
+    if (retired != nullptr) {
+      whisper_free_state(retired);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        migrated_++;
+      }
+      swapped_cv_.notify_all();
+      continue;
+    }
+
+    const Clock::time_point started = Clock::now();
+    pending->job(ctx, state, threads);
+    const Clock::time_point finished = Clock::now();
+
+    JobTiming timing;
+    timing.queue_wait_us = elapsed_us(pending->submitted, started);
+    timing.service_us = elapsed_us(started, finished);
+    timing.threads = threads;
+    timing.missed_deadline = finished > pending->deadline;
+    queue_wait.record(timing.queue_wait_us);
+    service.record(timing.service_us);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_threads_ -= threads;
+      stats_.jobs++;
+      stats_.missed_deadlines += timing.missed_deadline ? 1 : 0;
+      stats_.stolen += stolen ? 1 : 0;
+      stats_.total_queue_wait_us += timing.queue_wait_us;
+      stats_.max_queue_wait_us = std::max(stats_.max_queue_wait_us, timing.queue_wait_us);
+      stats_.total_service_us += timing.service_us;
+      stats_.max_service_us = std::max(stats_.max_service_us, timing.service_us);
+    }
+    pending->done.set_value(timing);
+  }
+}
+
+SchedulerStats InferenceScheduler::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string InferenceScheduler::describe() const {
+  SchedulerStats s = getStats();
+  std::ostringstream out;
+  out << "Scheduler: " << s.jobs << " decodes on " << states_.size() << "x"
+      << base_threads_ << " threads, queue wait " << s.meanQueueWaitMs()
+      << " ms mean / " << s.max_queue_wait_us / 1000.0 << " ms max, service "
+      << s.meanServiceMs() << " ms mean / " << s.max_service_us / 1000.0
+      << " ms max, " << s.missed_deadlines << " past deadline, " << s.stolen
+      << " with borrowed threads";
+  return out.str();
+}
+
+namespace {
+
+struct PhaseTimer {
+  InferenceScheduler::Clock::time_point start;
+  InferenceScheduler::Clock::time_point encode_begin;
+  InferenceScheduler::Clock::time_point decode_begin;
+  bool encoding = false;
+  bool decoding = false;
+
+  whisper_encoder_begin_callback encoder_begin = nullptr;
+  void *encoder_begin_data = nullptr;
+  whisper_logits_filter_callback logits_filter = nullptr;
+  void *logits_filter_data = nullptr;
+};
+
+bool on_encoder_begin(whisper_context *ctx, whisper_state *state, void *user_data) {
+  auto *timer = static_cast<PhaseTimer *>(user_data);
+  if (!timer->encoding) {
+    timer->encoding = true;
+    timer->encode_begin = InferenceScheduler::Clock::now();
+  }
+  return timer->encoder_begin == nullptr ||
+         timer->encoder_begin(ctx, state, timer->encoder_begin_data);
+}
+
+void on_logits_filter(whisper_context *ctx, whisper_state *state,
+                      const whisper_token_data *tokens, int n_tokens,
+                      float *logits, void *user_data) {
+  auto *timer = static_cast<PhaseTimer *>(user_data);
+  if (!timer->decoding) {
+    timer->decoding = true;
+    timer->decode_begin = InferenceScheduler::Clock::now();
+  }
+  if (timer->logits_filter != nullptr) {
+    timer->logits_filter(ctx, state, tokens, n_tokens, logits, timer->logits_filter_data);
+  }
+}
+
+} // namespace
+
+int whisper_full_timed(whisper_context *ctx, whisper_state *state,
+                       whisper_full_params params, const float *samples,
+                       int n_samples) {
+  static LatencyHistogram &full =
+      global_metrics().histogram("whisper_full", "whisper_full call, all phases");
+  static LatencyHistogram &mel =
+      global_metrics().histogram("whisper_mel", "Log-mel spectrogram");
+  static LatencyHistogram &encode =
+      global_metrics().histogram("whisper_encode", "Encoder, first window");
+  static LatencyHistogram &decode =
+      global_metrics().histogram("whisper_decode", "Decoder and any fallback passes");
+
+  PhaseTimer timer;
+  timer.encoder_begin = params.encoder_begin_callback;
+  timer.encoder_begin_data = params.encoder_begin_callback_user_data;
+  timer.logits_filter = params.logits_filter_callback;
+  timer.logits_filter_data = params.logits_filter_callback_user_data;
+  params.encoder_begin_callback = on_encoder_begin;
+  params.encoder_begin_callback_user_data = &timer;
+  params.logits_filter_callback = on_logits_filter;
+  params.logits_filter_callback_user_data = &timer;
+
+  timer.start = InferenceScheduler::Clock::now();
+  int result = whisper_full_with_state(ctx, state, params, samples, n_samples);
+  const auto finished = InferenceScheduler::Clock::now();
+
+  full.record(elapsed_us(timer.start, finished));
+  // An aborted encode or empty audio never reaches the later phases
+  if (timer.encoding) {
+    mel.record(elapsed_us(timer.start, timer.encode_begin));
+    if (timer.decoding) {
+      encode.record(elapsed_us(timer.encode_begin, timer.decode_begin));
+      decode.record(elapsed_us(timer.decode_begin, finished));
+    }
+  }
+  return result;
+}
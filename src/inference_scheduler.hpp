@@ -0,0 +1,148 @@
+#ifndef INFERENCE_SCHEDULER_HPP
+#define INFERENCE_SCHEDULER_HPP
+
+#include "whisper.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SchedulerOptions {
+  // Concurrent decodes, each with its own whisper_state
+  int workers = 1;
+  // Cores split between the workers; 0 uses every hardware thread
+  int total_threads = 0;
+};
+
+struct JobTiming {
+  int64_t queue_wait_us = 0; // submit -> start
+  int64_t service_us = 0;    // start -> finish
+  int threads = 0;
+  bool missed_deadline = false;
+};
+
+struct SchedulerStats {
+  uint64_t jobs = 0;
+  uint64_t missed_deadlines = 0;
+  uint64_t stolen = 0; // jobs that ran with an idle worker's threads
+  int64_t total_queue_wait_us = 0;
+  int64_t max_queue_wait_us = 0;
+  int64_t total_service_us = 0;
+  int64_t max_service_us = 0;
+  size_t max_pending = 0;
+
+  double meanQueueWaitMs() const {
+    return jobs > 0 ? total_queue_wait_us / 1000.0 / jobs : 0.0;
+  }
+  double meanServiceMs() const {
+    return jobs > 0 ? total_service_us / 1000.0 / jobs : 0.0;
+  }
+};
+
+// Earliest-deadline-first decode scheduler over one shared model.
+//
+// Each worker owns a whisper_state on the shared context and a fixed share
+// of the cores. Pending jobs are ordered by deadline, so a short job queued
+// behind a long one runs as soon as any worker frees up. A job that starts
+// while nothing else is waiting also takes the shares of idle workers;
+// whisper decodes cannot be preempted, so a worker that picks up a job
+// later runs it on its own share rather than waiting for them.
+class InferenceScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+  // Runs on a worker thread; n_threads is this job's share of the cores
+  using Job = std::function<void(whisper_context *ctx, whisper_state *state, int n_threads)>;
+
+  InferenceScheduler(whisper_context *ctx, const SchedulerOptions &options);
+  ~InferenceScheduler();
+
+  InferenceScheduler(const InferenceScheduler &) = delete;
+  InferenceScheduler &operator=(const InferenceScheduler &) = delete;
+
+  // Allocates one state per worker; false if the model has no room
+  bool start();
+  // Runs the jobs already queued, then joins the workers
+  void stop();
+
+  // Moves the workers onto `ctx` between jobs and returns the previous
+  // context once no worker uses it, for the caller to free. Jobs keep
+  // running meanwhile, and every job started after the call returns sees
+  // `ctx`. nullptr, with nothing changed, if `ctx` has no room for the
+  // workers' states or the scheduler is not running.
+  whisper_context *swapModel(whisper_context *ctx);
+
+  std::future<JobTiming> submit(std::string name, Clock::time_point deadline, Job job);
+  // submit() and wait
+  JobTiming run(std::string name, Clock::time_point deadline, Job job);
+
+  int workers() const { return static_cast<int>(states_.size()); }
+  int threadsPerWorker() const { return base_threads_; }
+  size_t pending() const;
+
+  SchedulerStats getStats() const;
+  std::string describe() const;
+
+private:
+  struct Pending {
+    std::string name;
+    Clock::time_point deadline;
+    Clock::time_point submitted;
+    uint64_t seq;
+    Job job;
+    std::promise<JobTiming> done;
+  };
+
+  // Min-heap on deadline, FIFO among equal deadlines
+  struct Later {
+    bool operator()(const std::shared_ptr<Pending> &a,
+                    const std::shared_ptr<Pending> &b) const {
+      return a->deadline != b->deadline ? a->deadline > b->deadline : a->seq > b->seq;
+    }
+  };
+
+  void workerLoop(int worker);
+
+  whisper_context *ctx_;
+  SchedulerOptions options_;
+  int total_threads_;
+  int base_threads_;
+
+  std::vector<whisper_state *> states_;
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::priority_queue<std::shared_ptr<Pending>,
+                      std::vector<std::shared_ptr<Pending>>, Later>
+      pending_;
+  uint64_t next_seq_ = 0;
+  int busy_threads_ = 0;
+  bool stopping_ = false;
+  SchedulerStats stats_;
+
+  // Model swap: workers adopt next_states_ when they see a new generation
+  std::mutex swap_mutex_;
+  std::condition_variable swapped_cv_;
+  std::vector<whisper_state *> next_states_;
+  uint64_t generation_ = 0;
+  size_t migrated_ = 0;
+};
+
+// whisper_full_with_state() that also records how long the call spent in
+// the mel spectrogram, the encoder and the decoder into the global metrics.
+// whisper_get_timings() only covers a context's default state, so the split
+// comes from the encoder-begin and logits-filter callbacks; callbacks
+// already set in `params` are still called.
+int whisper_full_timed(whisper_context *ctx, whisper_state *state,
+                       whisper_full_params params, const float *samples,
+                       int n_samples);
+
+#endif // INFERENCE_SCHEDULER_HPP
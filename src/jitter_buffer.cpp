@@ -0,0 +1,156 @@
+#include "jitter_buffer.hpp"
+
+#include <algorithm>
+
+static constexpr size_t kPlayedHistory = 256;
+
+JitterBuffer::JitterBuffer(size_t depth_samples, size_t resync_samples,
+                           ConcealmentMode mode, Sink sink, size_t max_packets)
+    : depth_samples_(depth_samples), resync_samples_(resync_samples), mode_(mode),
+      sink_(std::move(sink)),
+      slots_(max_packets), played_(kPlayedHistory, -1) {}
+
+void JitterBuffer::reset(uint64_t sample_index) {
+  for (auto &slot : slots_) {
+    slot.used = false;
+  }
+  std::fill(played_.begin(), played_.end(), -1);
+  started_ = true;
+  next_sample_ = sample_index;
+  buffered_end_ = sample_index;
+}
+
+void JitterBuffer::push(const AudioPacket &packet) {
+  stats_.packets++;
+  if (packet.sample_count == 0) {
+    return;
+  }
+
+  const uint64_t start = packet.sample_index;
+  const uint64_t end = start + packet.sample_count;
+
+  if (!started_) {
+    reset(start);
+    last_sequence_ = packet.sequence - 1;
+    highest_sequence_ = packet.sequence;
+  } else if (start > next_sample_ + resync_samples_ ||
+             end + resync_samples_ < next_sample_) {
+    flush();
+    stats_.resyncs++;
+    reset(start);
+    last_sequence_ = packet.sequence - 1;
+    highest_sequence_ = packet.sequence;
+  }
+
+  if (end <= next_sample_) {
+    // Entirely in the past: either a repeat or it lost the race to PLC
+    if (played_[packet.sequence % kPlayedHistory] == packet.sequence) {
+      stats_.duplicates++;
+    } else {
+      stats_.late++;
+    }
+    return;
+  }
+
+  for (const auto &slot : slots_) {
+    if (slot.used && slot.sample_index == start) {
+      stats_.duplicates++;
+      return;
+    }
+  }
+
+  if (static_cast<int32_t>(packet.sequence - highest_sequence_) < 0) {
+    stats_.reordered++;
+  } else {
+    highest_sequence_ = packet.sequence;
+  }
+
+  auto free_slot = std::find_if(slots_.begin(), slots_.end(),
+                                [](const Slot &slot) { return !slot.used; });
+  if (free_slot == slots_.end()) {
+    // Every slot is waiting on a gap; give up on it now
+    drain(true);
+    free_slot = std::find_if(slots_.begin(), slots_.end(),
+                             [](const Slot &slot) { return !slot.used; });
+  }
+
+  free_slot->used = true;
+  free_slot->sequence = packet.sequence;
+  free_slot->sample_index = start;
+  free_slot->samples.assign(packet.samples, packet.samples + packet.sample_count);
+  buffered_end_ = std::max(buffered_end_, end);
+
+  drain(false);
+}
+
+void JitterBuffer::flush() {
+  while (earliest() != nullptr) {
+    drain(true);
+  }
+}
+
+JitterBuffer::Slot *JitterBuffer::earliest() {
+  Slot *best = nullptr;
+  for (auto &slot : slots_) {
+    if (slot.used && (best == nullptr || slot.sample_index < best->sample_index)) {
+      best = &slot;
+    }
+  }
+  return best;
+}
+
+void JitterBuffer::drain(bool force) {
+  while (Slot *slot = earliest()) {
+    if (slot->sample_index > next_sample_) {
+      // Wait for the missing audio unless enough has queued behind the gap
+      if (!force && buffered_end_ - next_sample_ <= depth_samples_) {
+        return;
+      }
+      conceal(slot->sample_index - next_sample_, slot->samples.front());
+      force = false;
+    }
+    emit(*slot);
+  }
+}
+
+void JitterBuffer::emit(Slot &slot) {
+  slot.used = false;
+
+  // Skip any prefix that overlaps audio already played out
+  size_t skip = static_cast<size_t>(
+      std::min<uint64_t>(next_sample_ - std::min(next_sample_, slot.sample_index),
+                         slot.samples.size()));
+  if (skip == slot.samples.size()) {
+    stats_.duplicates++;
+    return;
+  }
+
+  int32_t gap = static_cast<int32_t>(slot.sequence - last_sequence_) - 1;
+  if (gap > 0) {
+    stats_.lost_packets += gap;
+  }
+  if (static_cast<int32_t>(slot.sequence - last_sequence_) > 0) {
+    last_sequence_ = slot.sequence;
+  }
+
+  played_[slot.sequence % kPlayedHistory] = slot.sequence;
+  sink_(slot.samples.data() + skip, slot.samples.size() - skip);
+  next_sample_ = slot.sample_index + slot.samples.size();
+  last_sample_ = slot.samples.back();
+}
+
+void JitterBuffer::conceal(size_t count, int16_t next_sample) {
+  fill_.resize(count);
+  if (mode_ == ConcealmentMode::Interpolate) {
+    const float step = (next_sample - last_sample_) / static_cast<float>(count + 1);
+    for (size_t i = 0; i < count; i++) {
+      fill_[i] = static_cast<int16_t>(last_sample_ + step * (i + 1));
+    }
+  } else {
+    std::fill(fill_.begin(), fill_.end(), int16_t{0});
+  }
+
+  sink_(fill_.data(), count);
+  stats_.concealed_samples += count;
+  next_sample_ += count;
+}
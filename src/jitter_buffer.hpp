@@ -0,0 +1,83 @@
+#ifndef JITTER_BUFFER_HPP
+#define JITTER_BUFFER_HPP
+
+#include "packet_protocol.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+enum class ConcealmentMode {
+  Silence,     // fill gaps with zeros
+  Interpolate, // linear ramp between the samples either side of the gap
+};
+
+struct JitterStats {
+  uint64_t packets = 0;
+  uint64_t duplicates = 0;   // already buffered or already played out
+  uint64_t late = 0;         // arrived after its gap was concealed
+  uint64_t reordered = 0;    // arrived out of order but in time
+  uint64_t lost_packets = 0; // sequence numbers never seen
+  uint64_t concealed_samples = 0;
+  uint64_t resyncs = 0;      // sender restarted or jumped its timeline
+};
+
+// A jump this far from the expected position is treated as a sender
+// restart rather than loss
+static constexpr int kJitterResyncSeconds = 10;
+
+// Reorders framed packets by sample index and plays them out contiguously.
+//
+// Packets are held until either the next expected one arrives or more than
+// `depth_samples` of later audio has queued up behind a gap, at which point
+// the gap is concealed so the timeline never shifts. A packet more than
+// `resync_samples` away from the expected position restarts the timeline.
+// Both count interleaved samples at the sender's rate. Slots are reused, so
+// the steady state does not allocate.
+class JitterBuffer {
+public:
+  using Sink = std::function<void(const int16_t *samples, size_t count)>;
+
+  JitterBuffer(size_t depth_samples, size_t resync_samples, ConcealmentMode mode,
+               Sink sink, size_t max_packets = 64);
+
+  void push(const AudioPacket &packet);
+  // Play out everything still held, concealing any remaining gaps
+  void flush();
+
+  const JitterStats &stats() const { return stats_; }
+
+private:
+  struct Slot {
+    bool used = false;
+    uint32_t sequence = 0;
+    uint64_t sample_index = 0;
+    std::vector<int16_t> samples;
+  };
+
+  void reset(uint64_t sample_index);
+  void drain(bool force);
+  Slot *earliest();
+  void emit(Slot &slot);
+  void conceal(size_t count, int16_t next_sample);
+
+  size_t depth_samples_;
+  uint64_t resync_samples_;
+  ConcealmentMode mode_;
+  Sink sink_;
+  std::vector<Slot> slots_;
+  std::vector<int16_t> fill_;
+  // Recently played sequence numbers, to tell duplicates from late packets
+  std::vector<int64_t> played_;
+
+  bool started_ = false;
+  uint64_t next_sample_ = 0;   // first sample not yet played out
+  uint64_t buffered_end_ = 0;  // one past the newest buffered sample
+  uint32_t last_sequence_ = 0; // sequence of the last packet played out
+  uint32_t highest_sequence_ = 0;
+  int16_t last_sample_ = 0;
+  JitterStats stats_;
+};
+
+#endif // JITTER_BUFFER_HPP
@@ -0,0 +1,293 @@
+#include "mel_frontend.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef WHISPER_STREAMING_FFTW
+#include <fftw3.h>
+#include <mutex>
+#endif
+
+// Power spectrum of one real frame of kFftSize samples into kBins values
+#ifdef WHISPER_STREAMING_FFTW
+struct IncrementalMel::Fft {
+  float *in;
+  fftwf_complex *out;
+  fftwf_plan plan;
+
+  // The FFTW planner is not thread-safe
+  static std::mutex &plannerMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  Fft() {
+    std::lock_guard<std::mutex> lock(plannerMutex());
+    in = fftwf_alloc_real(kFftSize);
+    out = fftwf_alloc_complex(kBins);
+    plan = fftwf_plan_dft_r2c_1d(kFftSize, in, out, FFTW_ESTIMATE);
+  }
+
+  ~Fft() {
+    std::lock_guard<std::mutex> lock(plannerMutex());
+    fftwf_destroy_plan(plan);
+    fftwf_free(in);
+    fftwf_free(out);
+  }
+
+  void power(const float *frame, float *power) {
+    std::copy(frame, frame + kFftSize, in);
+    fftwf_execute(plan);
+    for (int k = 0; k < kBins; k++) {
+      power[k] = out[k][0] * out[k][0] + out[k][1] * out[k][1];
+    }
+  }
+};
+#else
+// Same decomposition as whisper's own FFT (radix 2 down to an odd length,
+// then a direct DFT), with the twiddles and scratch allocated once
+struct IncrementalMel::Fft {
+  std::vector<float> cos_table = std::vector<float>(kFftSize);
+  std::vector<float> sin_table = std::vector<float>(kFftSize);
+  std::vector<float> out = std::vector<float>(2 * kFftSize);
+
+  Fft() {
+    for (int i = 0; i < kFftSize; i++) {
+      cos_table[i] = static_cast<float>(std::cos(2.0 * M_PI * i / kFftSize));
+      sin_table[i] = static_cast<float>(std::sin(2.0 * M_PI * i / kFftSize));
+    }
+  }
+
+  // Complex spectrum of in[0], in[stride], ... (n values) into out[0, 2n)
+  void transform(const float *in, size_t stride, int n, float *dst) const {
+    const int step = kFftSize / n;
+    if (n % 2 == 1) {
+      for (int k = 0; k < n; k++) {
+        float re = 0.0f, im = 0.0f;
+        for (int t = 0; t < n; t++) {
+          const int idx = (k * t % n) * step;
+          re += in[t * stride] * cos_table[idx];
+          im -= in[t * stride] * sin_table[idx];
+        }
+        dst[2 * k] = re;
+        dst[2 * k + 1] = im;
+      }
+      return;
+    }
+
+    const int half = n / 2;
+    transform(in, stride * 2, half, dst);
+    transform(in + stride, stride * 2, half, dst + n);
+    for (int k = 0; k < half; k++) {
+      const float wr = cos_table[k * step];
+      const float wi = -sin_table[k * step];
+      const float ore = dst[n + 2 * k], oim = dst[n + 2 * k + 1];
+      const float tre = wr * ore - wi * oim;
+      const float tim = wr * oim + wi * ore;
+      const float ere = dst[2 * k], eim = dst[2 * k + 1];
+      dst[2 * k] = ere + tre;
+      dst[2 * k + 1] = eim + tim;
+      dst[n + 2 * k] = ere - tre;
+      dst[n + 2 * k + 1] = eim - tim;
+    }
+  }
+
+  void power(const float *frame, float *power) {
+    transform(frame, 1, kFftSize, out.data());
+    for (int k = 0; k < kBins; k++) {
+      power[k] = out[2 * k] * out[2 * k] + out[2 * k + 1] * out[2 * k + 1];
+    }
+  }
+};
+#endif
+
+// Slaney mel scale, as used by librosa and so by whisper's filters
+static double hz_to_mel(double hz) {
+  const double min_log_hz = 1000.0, min_log_mel = 15.0;
+  const double log_step = std::log(6.4) / 27.0;
+  return hz < min_log_hz ? hz * 3.0 / 200.0
+                         : min_log_mel + std::log(hz / min_log_hz) / log_step;
+}
+
+static double mel_to_hz(double mel) {
+  const double min_log_hz = 1000.0, min_log_mel = 15.0;
+  const double log_step = std::log(6.4) / 27.0;
+  return mel < min_log_mel ? mel * 200.0 / 3.0
+                           : min_log_hz * std::exp(log_step * (mel - min_log_mel));
+}
+
+IncrementalMel::IncrementalMel(int n_mel, size_t cache_frames)
+    : n_mel_(0), cache_frames_(std::max<size_t>(cache_frames, 1)), fft_(new Fft()) {
+  window_fn_.resize(kFftSize);
+  for (int i = 0; i < kFftSize; i++) {
+    window_fn_[i] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * M_PI * i / kFftSize)));
+  }
+  frame_.resize(kFftSize);
+  reset(n_mel);
+}
+
+IncrementalMel::~IncrementalMel() { delete fft_; }
+
+void IncrementalMel::reset(int n_mel) {
+  cached_ = 0;
+  head_ = 0;
+  if (n_mel == n_mel_) {
+    return;
+  }
+  n_mel_ = n_mel;
+  cache_.assign(cache_frames_ * n_mel_, 0.0f);
+
+  // librosa.filters.mel(sr=16000, n_fft=400, n_mels=n_mel), slaney-normalized
+  std::vector<double> points(n_mel_ + 2);
+  const double mel_max = hz_to_mel(kSampleRate / 2.0);
+  for (int i = 0; i < n_mel_ + 2; i++) {
+    points[i] = mel_to_hz(mel_max * i / (n_mel_ + 1));
+  }
+  filter_first_.assign(n_mel_, 0);
+  filter_weights_.assign(n_mel_, {});
+  for (int m = 0; m < n_mel_; m++) {
+    const double norm = 2.0 / (points[m + 2] - points[m]);
+    for (int k = 0; k < kBins; k++) {
+      const double hz = static_cast<double>(k) * kSampleRate / kFftSize;
+      const double lower = (hz - points[m]) / (points[m + 1] - points[m]);
+      const double upper = (points[m + 2] - hz) / (points[m + 2] - points[m + 1]);
+      const double weight = std::max(0.0, std::min(lower, upper)) * norm;
+      if (weight <= 0.0) {
+        continue;
+      }
+      if (filter_weights_[m].empty()) {
+        filter_first_[m] = k;
+      }
+      // Keep interior zeros so the band stays one contiguous run
+      filter_weights_[m].resize(k - filter_first_[m] + 1, 0.0f);
+      filter_weights_[m].back() = static_cast<float>(weight);
+    }
+  }
+}
+
+void IncrementalMel::transform(const float *frame, float *out) {
+  float power[kBins];
+  for (int i = 0; i < kFftSize; i++) {
+    frame_[i] = frame[i] * window_fn_[i];
+  }
+  fft_->power(frame_.data(), power);
+
+  for (int m = 0; m < n_mel_; m++) {
+    const float *bins = power + filter_first_[m];
+    const std::vector<float> &weights = filter_weights_[m];
+    double sum = 0.0;
+    for (size_t k = 0; k < weights.size(); k++) {
+      sum += static_cast<double>(bins[k]) * weights[k];
+    }
+    out[m] = static_cast<float>(std::log10(std::max(sum, 1e-10)));
+  }
+  stats_.frames_computed++;
+}
+
+const float *IncrementalMel::cachedFrame(int64_t center) const {
+  if (cached_ == 0 || center < first_center_ || (center - first_center_) % kHop != 0) {
+    return nullptr;
+  }
+  const size_t index = static_cast<size_t>((center - first_center_) / kHop);
+  if (index >= cached_) {
+    return nullptr;
+  }
+  return &cache_[((head_ + index) % cache_frames_) * n_mel_];
+}
+
+int IncrementalMel::compute(const float *samples, size_t n, int64_t start,
+                            std::vector<float> &mel, int &n_len) {
+  static LatencyHistogram &latency =
+      global_metrics().histogram("mel_frontend", "Incremental log-mel, per window");
+  const auto t_start = LatencyHistogram::Clock::now();
+  const int half = kFftSize / 2;
+
+  // Frames k are centered on sample k * kHop of the window; those that
+  // touch audio are transformed, the rest are pure padding. The counts
+  // follow whisper's log_mel_spectrogram().
+  const int audio_frames = static_cast<int>((n + half) / kHop) + 1;
+  const int seek_end = n >= static_cast<size_t>(half) ? 1 + static_cast<int>((n - half) / kHop) : 0;
+  n_len = std::max(audio_frames, static_cast<int>((n + kPadFrames * kHop) / kHop));
+  frames_.resize(static_cast<size_t>(audio_frames) * n_mel_);
+
+  // Drop cached frames the window has moved past. The first frame that
+  // can be cached is k = 2; a window that starts a fraction of a hop away
+  // shares no frames with the cache at all.
+  if (cached_ > 0) {
+    const int64_t offset = start + 2 * kHop - first_center_;
+    if (offset % kHop != 0) {
+      cached_ = 0;
+    } else if (offset > 0) {
+      const size_t skip = std::min(static_cast<size_t>(offset / kHop), cached_);
+      head_ = (head_ + skip) % cache_frames_;
+      first_center_ += static_cast<int64_t>(skip) * kHop;
+      cached_ -= skip;
+    }
+  }
+
+  float padded[kFftSize];
+  for (int k = 0; k < audio_frames; k++) {
+    float *out = &frames_[static_cast<size_t>(k) * n_mel_];
+    const int64_t first = static_cast<int64_t>(k) * kHop - half;
+    const bool interior = first >= 0 && first + kFftSize <= static_cast<int64_t>(n);
+
+    const int64_t center = start + static_cast<int64_t>(k) * kHop;
+    if (interior) {
+      if (const float *cached = cachedFrame(center)) {
+        std::copy(cached, cached + n_mel_, out);
+        stats_.frames_reused++;
+        continue;
+      }
+      transform(samples + first, out);
+
+      // Extend the ring if this frame continues it, otherwise restart it
+      if (cached_ == 0 || center != first_center_ + static_cast<int64_t>(cached_) * kHop) {
+        cached_ = 0;
+        head_ = 0;
+        first_center_ = center;
+      }
+      if (cached_ == cache_frames_) {
+        head_ = (head_ + 1) % cache_frames_;
+        first_center_ += kHop;
+        cached_--;
+      }
+      std::copy(out, out + n_mel_, &cache_[((head_ + cached_) % cache_frames_) * n_mel_]);
+      cached_++;
+      continue;
+    }
+
+    // Edge frame: whisper reflects the first samples and zero-pads the end
+    for (int i = 0; i < kFftSize; i++) {
+      const int64_t s = std::abs(first + i);
+      padded[i] = s < static_cast<int64_t>(n) ? samples[s] : 0.0f;
+    }
+    transform(padded, out);
+  }
+
+  // Clamp to 8 below the window's peak and scale, as whisper does; the
+  // silence padding sits at log10(1e-10)
+  float peak = -10.0f;
+  for (float v : frames_) {
+    peak = std::max(peak, v);
+  }
+  const float floor = peak - 8.0f;
+  const float pad = (std::max(-10.0f, floor) + 4.0f) / 4.0f;
+
+  mel.assign(static_cast<size_t>(n_mel_) * n_len, pad);
+  for (int k = 0; k < audio_frames; k++) {
+    const float *frame = &frames_[static_cast<size_t>(k) * n_mel_];
+    for (int m = 0; m < n_mel_; m++) {
+      mel[static_cast<size_t>(m) * n_len + k] = (std::max(frame[m], floor) + 4.0f) / 4.0f;
+    }
+  }
+
+  stats_.calls++;
+  const int64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 LatencyHistogram::Clock::now() - t_start)
+                                 .count();
+  stats_.compute_us += elapsed_us;
+  latency.record(elapsed_us);
+  return seek_end;
+}
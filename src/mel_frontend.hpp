@@ -0,0 +1,82 @@
+#ifndef MEL_FRONTEND_HPP
+#define MEL_FRONTEND_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MelFrontendStats {
+  uint64_t calls = 0;
+  uint64_t frames_computed = 0;
+  uint64_t frames_reused = 0;
+  int64_t compute_us = 0;
+};
+
+// Log-mel spectrogram in whisper's format, computed incrementally.
+//
+// A rolling decode window mostly covers audio that was already transformed
+// on the previous pass. Frames that lie wholly inside the audio depend only
+// on their own samples, so they are kept in a ring keyed by absolute sample
+// position and reused; only the new frames, plus the few at each window
+// edge that see whisper's reflection or zero padding, go through the FFT.
+// The per-window max clamp and scaling are cheap and always redone, so the
+// output matches whisper_pcm_to_mel() for the same samples.
+//
+// Frames are reused only when consecutive windows start a whole number of
+// hops apart. Build with WHISPER_STREAMING_FFTW to use FFTW's real FFT.
+class IncrementalMel {
+public:
+  static constexpr int kSampleRate = 16000;
+  static constexpr int kFftSize = 400;
+  static constexpr int kHop = 160;
+  static constexpr int kBins = kFftSize / 2 + 1;
+  // whisper pads every input with 30 s of silence
+  static constexpr int kPadFrames = 30 * kSampleRate / kHop;
+
+  // `cache_frames` bounds the ring; a 30 s window needs 3000
+  explicit IncrementalMel(int n_mel = 80, size_t cache_frames = 3200);
+  ~IncrementalMel();
+
+  IncrementalMel(const IncrementalMel &) = delete;
+  IncrementalMel &operator=(const IncrementalMel &) = delete;
+
+  // Spectrogram of samples[0, n), which start at absolute sample `start`,
+  // written to `mel` as n_mel rows of `n_len` frames including the silence
+  // padding. Returns the number of frames that cover audio, which is what
+  // whisper decodes up to (whisper_full_params::duration_ms = frames * 10).
+  int compute(const float *samples, size_t n, int64_t start,
+              std::vector<float> &mel, int &n_len);
+
+  int nMel() const { return n_mel_; }
+  // Switch to another mel count (a different model); drops the cache
+  void reset(int n_mel);
+  const MelFrontendStats &stats() const { return stats_; }
+
+private:
+  struct Fft;
+
+  // Log10 mel energies of one frame of kFftSize samples
+  void transform(const float *frame, float *out);
+  const float *cachedFrame(int64_t center) const;
+
+  int n_mel_;
+  size_t cache_frames_;
+
+  std::vector<float> window_fn_; // periodic Hann
+  // Mel filters are triangular: only bins [first, first + weights) count
+  std::vector<int> filter_first_;
+  std::vector<std::vector<float>> filter_weights_;
+  Fft *fft_;
+
+  // Ring of log-mel frames for centers first_center_ + k * kHop
+  std::vector<float> cache_;
+  int64_t first_center_ = 0;
+  size_t cached_ = 0;
+  size_t head_ = 0; // ring slot of first_center_
+
+  std::vector<float> frame_;
+  std::vector<float> frames_; // log-mel of the current window, frame-major
+  MelFrontendStats stats_;
+};
+
+#endif // MEL_FRONTEND_HPP
@@ -0,0 +1,303 @@
+#include "metrics.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr const char *kMetricPrefix = "whisper_streaming_";
+
+const std::array<int64_t, LatencyHistogram::kBuckets> &LatencyHistogram::bounds() {
+  static const std::array<int64_t, kBuckets> values = [] {
+    std::array<int64_t, kBuckets> b{};
+    int64_t decade = 10;
+    for (size_t i = 0; i < kBuckets; decade *= 10) {
+      for (int step : {1, 2, 5}) {
+        if (i < kBuckets) {
+          b[i++] = decade * step;
+        }
+      }
+    }
+    return b;
+  }();
+  return values;
+}
+
+void LatencyHistogram::record(int64_t us) {
+  us = std::max<int64_t>(us, 0);
+  const auto &b = bounds();
+  size_t bucket = std::lower_bound(b.begin(), b.end(), us) - b.begin();
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(us, std::memory_order_relaxed);
+
+  int64_t max = max_us_.load(std::memory_order_relaxed);
+  while (us > max && !max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+  Snapshot s;
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    s.count += s.buckets[i];
+  }
+  s.sum_us = sum_us_.load(std::memory_order_relaxed);
+  s.max_us = max_us_.load(std::memory_order_relaxed);
+  return s;
+}
+
+double LatencyHistogram::Snapshot::quantileMs(double q) const {
+  if (count == 0) {
+    return 0.0;
+  }
+  const auto &b = bounds();
+  const double target = q * count;
+  double seen = 0.0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    if (buckets[i] == 0 || seen + buckets[i] < target) {
+      seen += buckets[i];
+      continue;
+    }
+    double lower = i == 0 ? 0.0 : static_cast<double>(b[i - 1]);
+    double upper = i < b.size() ? static_cast<double>(b[i]) : static_cast<double>(max_us);
+    upper = std::min(upper, static_cast<double>(max_us));
+    double fraction = (target - seen) / buckets[i];
+    return std::max(lower, lower + (upper - lower) * fraction) / 1000.0;
+  }
+  return max_us / 1000.0;
+}
+
+LatencyHistogram &MetricsRegistry::histogram(const std::string &name,
+                                             const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &entry : entries_) {
+    if (entry.name == name) {
+      return entry.histogram;
+    }
+  }
+  entries_.emplace_back();
+  entries_.back().name = name;
+  entries_.back().help = help;
+  return entries_.back().histogram;
+}
+
+void MetricsRegistry::forEach(const std::function<void(const Entry &)> &fn) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &entry : entries_) {
+    fn(entry);
+  }
+}
+
+MetricsRegistry &global_metrics() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsExporter::MetricsExporter(MetricsRegistry &registry,
+                                 const MetricsOptions &options)
+    : registry_(registry), options_(options) {}
+
+MetricsExporter::~MetricsExporter() { stop(); }
+
+void MetricsExporter::addGauge(const std::string &name, const std::string &help,
+                               std::function<double()> sample) {
+  std::lock_guard<std::mutex> lock(gauges_mutex_);
+  gauges_.push_back({name, help, std::move(sample)});
+}
+
+bool MetricsExporter::start() {
+  if (options_.http_port > 0) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(options_.http_port));
+    if (listen_fd_ < 0 ||
+        bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 8) < 0) {
+      std::cerr << "Failed to serve metrics on port " << options_.http_port
+                << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    std::cout << "Metrics at http://127.0.0.1:" << options_.http_port
+              << "/metrics" << std::endl;
+  }
+
+  if (pipe(wake_pipe_) != 0) {
+    std::cerr << "Failed to create metrics wake pipe" << std::endl;
+    return false;
+  }
+  running_ = true;
+  thread_ = std::thread(&MetricsExporter::loop, this);
+  return true;
+}
+
+void MetricsExporter::stop() {
+  if (running_.exchange(false)) {
+    const char wake = 1;
+    if (write(wake_pipe_[1], &wake, 1) < 0) {
+      std::cerr << "Failed to wake metrics thread" << std::endl;
+    }
+  }
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  for (int *fd : {&listen_fd_, &wake_pipe_[0], &wake_pipe_[1]}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+void MetricsExporter::loop() {
+  std::ofstream json_file;
+  if (!options_.json_path.empty()) {
+    json_file.open(options_.json_path, std::ios::app);
+  }
+  const auto interval = std::chrono::seconds(std::max(1, options_.interval_s));
+  auto next_export = std::chrono::steady_clock::now() + interval;
+
+  struct pollfd fds[2];
+  fds[0].fd = wake_pipe_[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = listen_fd_;
+  fds[1].events = POLLIN;
+  const nfds_t nfds = listen_fd_ >= 0 ? 2 : 1;
+
+  while (running_) {
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next_export - std::chrono::steady_clock::now());
+    int ready = poll(fds, nfds, static_cast<int>(std::max<int64_t>(timeout.count(), 0)));
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      break;
+    }
+    if (nfds > 1 && (fds[1].revents & POLLIN)) {
+      int client = accept(listen_fd_, nullptr, nullptr);
+      if (client >= 0) {
+        serveClient(client);
+        ::close(client);
+      }
+    }
+    if (std::chrono::steady_clock::now() >= next_export) {
+      next_export += interval;
+      if (json_file.is_open()) {
+        json_file << jsonLine() << '\n';
+        json_file.flush();
+      }
+    }
+  }
+
+  // One last line so short runs are recorded too
+  if (json_file.is_open()) {
+    json_file << jsonLine() << std::endl;
+  }
+}
+
+void MetricsExporter::serveClient(int fd) {
+  // Only the request line matters; one read is enough for a GET
+  struct pollfd pfd = {fd, POLLIN, 0};
+  char request[1024] = {0};
+  if (poll(&pfd, 1, 1000) <= 0 || recv(fd, request, sizeof(request) - 1, 0) <= 0) {
+    return;
+  }
+
+  std::string line(request, strcspn(request, "\r\n"));
+  std::string status = "200 OK";
+  std::string type = "text/plain; version=0.0.4";
+  std::string body;
+  if (line.rfind("GET /metrics.json", 0) == 0) {
+    type = "application/json";
+    body = jsonLine() + "\n";
+  } else if (line.rfind("GET /metrics", 0) == 0 || line.rfind("GET / ", 0) == 0) {
+    body = prometheusText();
+  } else {
+    status = "404 Not Found";
+    body = "try /metrics or /metrics.json\n";
+  }
+
+  std::ostringstream response;
+  response << "HTTP/1.0 " << status << "\r\nContent-Type: " << type
+           << "\r\nContent-Length: " << body.size()
+           << "\r\nConnection: close\r\n\r\n"
+           << body;
+  const std::string out = response.str();
+  size_t sent = 0;
+  while (sent < out.size()) {
+    ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += static_cast<size_t>(n);
+  }
+}
+
+std::string MetricsExporter::jsonLine() const {
+  nlohmann::json line;
+  line["ts_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+
+  registry_.forEach([&](const MetricsRegistry::Entry &entry) {
+    LatencyHistogram::Snapshot s = entry.histogram.snapshot();
+    line["latency_ms"][entry.name] = {
+        {"count", s.count},
+        {"mean", s.meanMs()},
+        {"p50", s.quantileMs(0.50)},
+        {"p90", s.quantileMs(0.90)},
+        {"p99", s.quantileMs(0.99)},
+        {"max", s.max_us / 1000.0},
+    };
+  });
+
+  std::lock_guard<std::mutex> lock(gauges_mutex_);
+  for (const auto &gauge : gauges_) {
+    line["gauges"][gauge.name] = gauge.sample();
+  }
+  return line.dump();
+}
+
+std::string MetricsExporter::prometheusText() const {
+  std::ostringstream out;
+  registry_.forEach([&](const MetricsRegistry::Entry &entry) {
+    const std::string name = kMetricPrefix + entry.name + "_seconds";
+    LatencyHistogram::Snapshot s = entry.histogram.snapshot();
+    out << "# HELP " << name << " " << entry.help << "\n"
+        << "# TYPE " << name << " histogram\n";
+    uint64_t cumulative = 0;
+    const auto &bounds = LatencyHistogram::bounds();
+    for (size_t i = 0; i < bounds.size(); i++) {
+      cumulative += s.buckets[i];
+      out << name << "_bucket{le=\"" << bounds[i] / 1e6 << "\"} " << cumulative << "\n";
+    }
+    out << name << "_bucket{le=\"+Inf\"} " << s.count << "\n"
+        << name << "_sum " << s.sum_us / 1e6 << "\n"
+        << name << "_count " << s.count << "\n";
+  });
+
+  std::lock_guard<std::mutex> lock(gauges_mutex_);
+  for (const auto &gauge : gauges_) {
+    const std::string name = kMetricPrefix + gauge.name;
+    out << "# HELP " << name << " " << gauge.help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << " " << gauge.sample() << "\n";
+  }
+  return out.str();
+}
@@ -0,0 +1,119 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed-bucket latency histogram. record() is a handful of relaxed atomic
+// adds, cheap enough for the per-packet path.
+class LatencyHistogram {
+public:
+  using Clock = std::chrono::steady_clock;
+  // 1-2-5 steps from 10 us to 100 s, plus an overflow bucket
+  static constexpr size_t kBuckets = 22;
+  static const std::array<int64_t, kBuckets> &bounds();
+
+  struct Snapshot {
+    uint64_t count = 0;
+    int64_t sum_us = 0;
+    int64_t max_us = 0;
+    std::array<uint64_t, kBuckets + 1> buckets{};
+
+    double meanMs() const { return count > 0 ? sum_us / 1000.0 / count : 0.0; }
+    // Interpolated within the bucket that holds the quantile
+    double quantileMs(double q) const;
+  };
+
+  void record(int64_t us);
+  void recordSince(Clock::time_point start) {
+    record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+  }
+  Snapshot snapshot() const;
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets + 1> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<int64_t> sum_us_{0};
+  std::atomic<int64_t> max_us_{0};
+};
+
+// Process-wide set of named histograms. Components look theirs up once and
+// keep the reference; entries are never removed.
+class MetricsRegistry {
+public:
+  struct Entry {
+    std::string name;
+    std::string help;
+    LatencyHistogram histogram;
+  };
+
+  LatencyHistogram &histogram(const std::string &name, const std::string &help);
+  void forEach(const std::function<void(const Entry &)> &fn) const;
+
+private:
+  mutable std::mutex mutex_;
+  std::deque<Entry> entries_; // stable addresses
+};
+
+MetricsRegistry &global_metrics();
+
+struct MetricsOptions {
+  // Serve /metrics (Prometheus text) and /metrics.json on 127.0.0.1; 0 = off
+  int http_port = 0;
+  // Append one JSON object per interval; empty = off
+  std::string json_path;
+  int interval_s = 10;
+};
+
+// Exports the registry, plus gauges sampled at export time, as JSON lines
+// and over a small local HTTP endpoint, from one background thread.
+class MetricsExporter {
+public:
+  MetricsExporter(MetricsRegistry &registry, const MetricsOptions &options);
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  // Gauges are read on the exporter thread, so `sample` must be thread-safe
+  // and outlive the exporter
+  void addGauge(const std::string &name, const std::string &help,
+                std::function<double()> sample);
+
+  bool start();
+  void stop();
+
+  std::string jsonLine() const;
+  std::string prometheusText() const;
+
+private:
+  struct Gauge {
+    std::string name;
+    std::string help;
+    std::function<double()> sample;
+  };
+
+  void loop();
+  void serveClient(int fd);
+
+  MetricsRegistry &registry_;
+  MetricsOptions options_;
+
+  mutable std::mutex gauges_mutex_;
+  std::vector<Gauge> gauges_;
+
+  int listen_fd_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+#endif // METRICS_HPP
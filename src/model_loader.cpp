@@ -0,0 +1,203 @@
+#include "model_loader.hpp"
+#include "inference_scheduler.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct MappedModel {
+  const char *data = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+};
+
+size_t mapped_read(void *ctx, void *output, size_t read_size) {
+  auto *model = static_cast<MappedModel *>(ctx);
+  const size_t n = std::min(read_size, model->size - model->offset);
+  std::memcpy(output, model->data + model->offset, n);
+  model->offset += n;
+  return n;
+}
+
+bool mapped_eof(void *ctx) {
+  auto *model = static_cast<MappedModel *>(ctx);
+  return model->offset >= model->size;
+}
+
+// Unmapped by load_model_mapped() once whisper is done with it
+void mapped_close(void *) {}
+
+} // namespace
+
+whisper_context *load_model_mapped(const std::string &path,
+                                   const whisper_context_params &cparams) {
+  static LatencyHistogram &model_load =
+      global_metrics().histogram("model_load", "Model file to usable context");
+  const auto started = LatencyHistogram::Clock::now();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+    std::cerr << "Failed to open model " << path << ": " << strerror(errno) << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return nullptr;
+  }
+  MappedModel model;
+  model.size = static_cast<size_t>(st.st_size);
+  void *data = mmap(nullptr, model.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map model " << path << ": " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  // Tensors are read front to back; let the kernel read ahead of them
+  madvise(data, model.size, MADV_SEQUENTIAL);
+  madvise(data, model.size, MADV_WILLNEED);
+  model.data = static_cast<const char *>(data);
+
+  whisper_model_loader loader;
+  loader.context = &model;
+  loader.read = mapped_read;
+  loader.eof = mapped_eof;
+  loader.close = mapped_close;
+  whisper_context *ctx = whisper_init_with_params_no_state(&loader, cparams);
+  munmap(data, model.size);
+
+  if (ctx != nullptr) {
+    model_load.recordSince(started);
+    std::cout << "Loaded model " << path << " (" << model.size / (1024 * 1024)
+              << " MB) in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     LatencyHistogram::Clock::now() - started)
+                     .count()
+              << " ms" << std::endl;
+  }
+  return ctx;
+}
+
+bool warm_up_model(whisper_context *ctx, whisper_state *state,
+                   whisper_full_params wparams, int n_threads) {
+  static LatencyHistogram &warm_up =
+      global_metrics().histogram("model_warm_up", "Warm-up decode of a newly loaded model");
+  const auto started = LatencyHistogram::Clock::now();
+
+  const std::vector<float> silence(WHISPER_SAMPLE_RATE, 0.0f);
+  wparams.n_threads = n_threads;
+  wparams.max_tokens = 4;
+  wparams.new_segment_callback = nullptr;
+  wparams.encoder_begin_callback = nullptr;
+  wparams.logits_filter_callback = nullptr;
+  // Not whisper_full_timed(): the decode histograms are for real audio
+  const bool ok = whisper_full_with_state(ctx, state, wparams, silence.data(),
+                                          static_cast<int>(silence.size())) == 0;
+  warm_up.recordSince(started);
+  return ok;
+}
+
+ModelSwapper::ModelSwapper(InferenceScheduler &scheduler, whisper_context *ctx,
+                           const std::string &path,
+                           const whisper_context_params &cparams,
+                           const whisper_full_params &wparams)
+    : scheduler_(scheduler), cparams_(cparams), wparams_(wparams), ctx_(ctx),
+      path_(path) {}
+
+ModelSwapper::~ModelSwapper() {
+  std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool ModelSwapper::load(const std::string &path) {
+  std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+  if (released_) {
+    return false;
+  }
+  if (loading_.exchange(true)) {
+    std::cerr << "A model is already loading; try again once it is swapped in"
+              << std::endl;
+    return false;
+  }
+  // The previous load has finished, so this join returns at once
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  thread_ = std::thread(&ModelSwapper::swapIn, this, path);
+  return true;
+}
+
+whisper_context *ModelSwapper::release() {
+  {
+    std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+    released_ = true;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ctx_;
+}
+
+std::string ModelSwapper::path() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return path_;
+}
+
+void ModelSwapper::swapIn(const std::string &path) {
+  const auto started = LatencyHistogram::Clock::now();
+  whisper_context *next = load_model_mapped(path, cparams_);
+  if (next == nullptr) {
+    std::cerr << "Keeping model " << this->path() << std::endl;
+    loading_ = false;
+    return;
+  }
+
+  // Warm up on a state of its own while the workers keep decoding
+  whisper_state *state = whisper_init_state(next);
+  if (state == nullptr ||
+      !warm_up_model(next, state, wparams_, scheduler_.threadsPerWorker())) {
+    std::cerr << "Warm-up decode failed on " << path << "; keeping "
+              << this->path() << std::endl;
+    if (state != nullptr) {
+      whisper_free_state(state);
+    }
+    whisper_free(next);
+    loading_ = false;
+    return;
+  }
+  whisper_free_state(state);
+
+  whisper_context *previous = scheduler_.swapModel(next);
+  if (previous == nullptr) {
+    std::cerr << "Could not swap in " << path << "; keeping " << this->path()
+              << std::endl;
+    whisper_free(next);
+    loading_ = false;
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ctx_ = next;
+    path_ = path;
+  }
+  whisper_free(previous);
+  swaps_++;
+  std::cout << "Swapped in model " << path << " after "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   LatencyHistogram::Clock::now() - started)
+                   .count()
+            << " ms" << std::endl;
+  loading_ = false;
+}
@@ -0,0 +1,69 @@
+#ifndef MODEL_LOADER_HPP
+#define MODEL_LOADER_HPP
+
+#include "whisper.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class InferenceScheduler;
+
+// whisper_init_from_file_with_params_no_state() through a read-only mapping
+// of the model file, advised as sequential and needed soon so the kernel
+// reads ahead of whisper copying the tensors into its own buffers. The
+// mapping is dropped once the context is built; the weights are not shared
+// with other processes. nullptr on failure.
+whisper_context *load_model_mapped(const std::string &path,
+                                   const whisper_context_params &cparams);
+
+// Decodes a second of silence on `state` so the first real decode does not
+// pay for compute buffer allocation and first-touch page faults
+bool warm_up_model(whisper_context *ctx, whisper_state *state,
+                   whisper_full_params wparams, int n_threads);
+
+// Replaces the scheduler's model at runtime. load() maps and warms up the
+// new model on a background thread while decoding continues on the old
+// one, then swaps it in between jobs; audio keeps buffering throughout, so
+// nothing is dropped.
+class ModelSwapper {
+public:
+  // `ctx` is the model the scheduler was started with
+  ModelSwapper(InferenceScheduler &scheduler, whisper_context *ctx,
+               const std::string &path, const whisper_context_params &cparams,
+               const whisper_full_params &wparams);
+  // Waits for a load in progress
+  ~ModelSwapper();
+
+  ModelSwapper(const ModelSwapper &) = delete;
+  ModelSwapper &operator=(const ModelSwapper &) = delete;
+
+  // False if a load is already running
+  bool load(const std::string &path);
+
+  // Waits for a load in progress and returns the model in use, for the
+  // caller to free once the scheduler has stopped
+  whisper_context *release();
+  std::string path() const;
+  int swaps() const { return swaps_; }
+
+private:
+  void swapIn(const std::string &path);
+
+  InferenceScheduler &scheduler_;
+  whisper_context_params cparams_;
+  whisper_full_params wparams_;
+
+  mutable std::mutex mutex_;
+  whisper_context *ctx_;
+  std::string path_;
+
+  std::mutex thread_mutex_;
+  std::thread thread_;
+  bool released_ = false;
+  std::atomic<bool> loading_{false};
+  std::atomic<int> swaps_{0};
+};
+
+#endif // MODEL_LOADER_HPP
@@ -0,0 +1,192 @@
+#include "overload_guard.hpp"
+#include "audio_manager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+bool parse_overload_policy(const std::string &name, OverloadPolicy &policy) {
+  if (name == "off") {
+    policy = OverloadPolicy::Off;
+  } else if (name == "skip-to-live") {
+    policy = OverloadPolicy::SkipToLive;
+  } else if (name == "drop-silence") {
+    policy = OverloadPolicy::DropSilence;
+  } else if (name == "reduce-context") {
+    policy = OverloadPolicy::ReduceContext;
+  } else if (name == "markers") {
+    policy = OverloadPolicy::Markers;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *overload_policy_name(OverloadPolicy policy) {
+  switch (policy) {
+  case OverloadPolicy::Off:
+    return "off";
+  case OverloadPolicy::SkipToLive:
+    return "skip-to-live";
+  case OverloadPolicy::DropSilence:
+    return "drop-silence";
+  case OverloadPolicy::ReduceContext:
+    return "reduce-context";
+  case OverloadPolicy::Markers:
+    return "markers";
+  }
+  return "?";
+}
+
+OverloadGuard::OverloadGuard(const OverloadOptions &options)
+    : options_(options),
+      max_samples_(static_cast<size_t>(options.max_backlog_s * options.sample_rate)),
+      target_samples_(static_cast<size_t>(
+          std::min(options.target_backlog_s, options.max_backlog_s) * options.sample_rate)),
+      keep_silence_samples_(static_cast<size_t>(options.keep_silence_ms) *
+                            options.sample_rate / 1000),
+      compact_above_(max_samples_), vad_(options.vad) {}
+
+bool OverloadGuard::check(AudioManager &audio, OverloadEvent &event) {
+  if (options_.policy == OverloadPolicy::Off) {
+    return false;
+  }
+
+  const size_t backlog = audio.bufferedSamples();
+  const size_t ceiling =
+      static_cast<size_t>(audio.capacitySamples() * options_.ceiling_fraction);
+  event = OverloadEvent();
+  event.policy = options_.policy;
+  event.backlog_before_s = static_cast<double>(backlog) / options_.sample_rate;
+  event.backlog_after_s = event.backlog_before_s;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.max_backlog_s = std::max(stats_.max_backlog_s, event.backlog_before_s);
+    if (!stats_.overloaded && backlog > max_samples_) {
+      stats_.overloaded = true;
+      if (options_.policy == OverloadPolicy::ReduceContext) {
+        stats_.events++;
+        log(event, "decoding the backlog with a fitted audio_ctx");
+      }
+    } else if (stats_.overloaded && backlog <= target_samples_) {
+      stats_.overloaded = false;
+      compact_above_ = max_samples_;
+      if (options_.policy == OverloadPolicy::ReduceContext) {
+        log(event, "caught up, back to the configured settings");
+      }
+    }
+  }
+
+  OverloadPolicy action = options_.policy;
+  if (backlog >= ceiling && backlog > target_samples_) {
+    // Whatever the policy, losing old audio beats overrunning the buffer
+    action = options_.policy == OverloadPolicy::Markers ? OverloadPolicy::Markers
+                                                        : OverloadPolicy::SkipToLive;
+    event.ceiling = true;
+  } else if (backlog <= max_samples_ || action == OverloadPolicy::ReduceContext) {
+    return false;
+  }
+
+  if (action == OverloadPolicy::DropSilence) {
+    if (backlog <= compact_above_) {
+      return false;
+    }
+    event.shed_samples = audio.compactOldest(
+        backlog, [this](float *samples, size_t count) { return compactSilence(samples, count); });
+    const size_t remaining = backlog - event.shed_samples;
+    // Compacting the same speech again would find nothing new to cut
+    compact_above_ = std::max(max_samples_, remaining + max_samples_ / 2);
+    if (event.shed_samples == 0) {
+      return false;
+    }
+  } else {
+    event.policy = action;
+    event.shed_samples = audio.discardOldest(backlog - target_samples_);
+  }
+  event.backlog_after_s =
+      static_cast<double>(backlog - event.shed_samples) / options_.sample_rate;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.events++;
+  if (action == OverloadPolicy::DropSilence) {
+    stats_.silence_samples += event.shed_samples;
+    log(event, "cut pauses out of the backlog");
+  } else {
+    stats_.skipped_samples += event.shed_samples;
+    if (action == OverloadPolicy::Markers) {
+      std::ostringstream marker;
+      marker << "-- " << std::lround(static_cast<double>(event.shed_samples) /
+                                     options_.sample_rate)
+             << " s of audio skipped --";
+      event.marker = marker.str();
+      stats_.markers++;
+    }
+    log(event, event.ceiling ? "capture buffer nearly full, skipped to live audio"
+                             : "skipped to live audio");
+  }
+  return true;
+}
+
+bool OverloadGuard::adjust(DecodeSettings &settings) {
+  if (options_.policy != OverloadPolicy::ReduceContext) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!stats_.overloaded) {
+    return false;
+  }
+  settings.beam_size = 0;
+  settings.fit_audio_ctx = true;
+  stats_.reduced_decodes++;
+  return true;
+}
+
+OverloadStats OverloadGuard::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+size_t OverloadGuard::compactSilence(float *samples, size_t count) {
+  const size_t frame = std::max<size_t>(
+      1, static_cast<size_t>(options_.vad.sample_rate) * options_.vad.frame_ms / 1000);
+  size_t kept = 0;
+  size_t silence_run = 0;
+  for (size_t i = 0; i < count; i += frame) {
+    const size_t n = std::min(frame, count - i);
+    const bool speech = vad_.processFrame(samples + i, n);
+    silence_run = speech ? 0 : silence_run + n;
+    if (speech || silence_run <= keep_silence_samples_) {
+      std::copy(samples + i, samples + i + n, samples + kept);
+      kept += n;
+    }
+  }
+  return kept;
+}
+
+void OverloadGuard::log(const OverloadEvent &event, const char *what) {
+  std::ostringstream line;
+  line << "Overload (" << overload_policy_name(options_.policy) << "): " << what;
+  if (event.shed_samples > 0) {
+    line << ", dropped " << static_cast<double>(event.shed_samples) / options_.sample_rate
+         << " s";
+  }
+  line << " (backlog " << event.backlog_before_s << " s";
+  if (event.backlog_after_s != event.backlog_before_s) {
+    line << " -> " << event.backlog_after_s << " s";
+  }
+  line << ")";
+  std::cout << line.str() << std::endl;
+}
+
+std::string OverloadGuard::describe() const {
+  OverloadStats s = getStats();
+  std::ostringstream out;
+  out << "Overload (" << overload_policy_name(options_.policy) << "): " << s.events
+      << " events, " << static_cast<double>(s.skipped_samples) / options_.sample_rate
+      << " s skipped, " << static_cast<double>(s.silence_samples) / options_.sample_rate
+      << " s of pauses cut, " << s.reduced_decodes << " reduced decodes, backlog peaked at "
+      << s.max_backlog_s << " s";
+  return out.str();
+}
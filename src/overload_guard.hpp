@@ -0,0 +1,103 @@
+#ifndef OVERLOAD_GUARD_HPP
+#define OVERLOAD_GUARD_HPP
+
+#include "compute_governor.hpp"
+#include "vad.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+class AudioManager;
+
+// What to give up once decoding has fallen too far behind live audio
+enum class OverloadPolicy {
+  Off,           // keep everything until the capture buffer overruns
+  SkipToLive,    // drop the oldest backlog
+  DropSilence,   // cut long pauses out of the backlog first
+  ReduceContext, // decode greedy with a fitted audio_ctx until caught up
+  Markers,       // skip to live and put a gap marker in the transcript
+};
+
+bool parse_overload_policy(const std::string &name, OverloadPolicy &policy);
+const char *overload_policy_name(OverloadPolicy policy);
+
+struct OverloadOptions {
+  int sample_rate = 16000;
+  OverloadPolicy policy = OverloadPolicy::SkipToLive;
+  // Backlog that counts as overloaded
+  float max_backlog_s = 30.0f;
+  // Backlog left after skipping, and below which overload ends
+  float target_backlog_s = 2.0f;
+  // Every policy skips to live once the capture buffer is this full, so
+  // the buffer itself never overruns
+  float ceiling_fraction = 0.9f;
+  // drop-silence keeps this much of every pause
+  int keep_silence_ms = 300;
+  VadOptions vad;
+};
+
+// One intervention, as logged
+struct OverloadEvent {
+  OverloadPolicy policy = OverloadPolicy::Off;
+  uint64_t shed_samples = 0; // dropped from the backlog
+  double backlog_before_s = 0.0;
+  double backlog_after_s = 0.0;
+  bool ceiling = false; // forced by the capture buffer filling up
+  // Text to put in the transcript where audio was skipped (markers)
+  std::string marker;
+};
+
+struct OverloadStats {
+  uint64_t events = 0;
+  uint64_t skipped_samples = 0; // dropped by skipping to live
+  uint64_t silence_samples = 0; // pauses cut out by drop-silence
+  uint64_t reduced_decodes = 0; // decodes run cheaper by reduce-context
+  uint64_t markers = 0;
+  double max_backlog_s = 0.0;
+  bool overloaded = false;
+
+  uint64_t shedSamples() const { return skipped_samples + silence_samples; }
+};
+
+// Keeps the backlog between capture and decoding bounded.
+//
+// The consumer calls check() before taking audio. Once the backlog passes
+// max_backlog_s the configured policy runs on the captured audio not yet
+// taken; any policy skips to live if the capture buffer is about to
+// overrun, since an overrun loses the newest audio instead of the oldest.
+// Every intervention is logged and counted.
+class OverloadGuard {
+public:
+  explicit OverloadGuard(const OverloadOptions &options);
+
+  // Returns true and fills `event` when audio was shed. The consumer's
+  // session position should advance by event.shed_samples, so positions
+  // stay aligned with live audio.
+  bool check(AudioManager &audio, OverloadEvent &event);
+
+  // reduce-context: greedy with a fitted audio_ctx while overloaded.
+  // True if `settings` were changed and need applying.
+  bool adjust(DecodeSettings &settings);
+
+  OverloadStats getStats() const;
+  std::string describe() const;
+
+private:
+  size_t compactSilence(float *samples, size_t count);
+  void log(const OverloadEvent &event, const char *what);
+
+  OverloadOptions options_;
+  size_t max_samples_;
+  size_t target_samples_;
+  size_t keep_silence_samples_;
+  // drop-silence runs again only once the backlog has grown past this
+  size_t compact_above_;
+  EnergyVad vad_;
+
+  mutable std::mutex mutex_;
+  OverloadStats stats_;
+};
+
+#endif // OVERLOAD_GUARD_HPP
@@ -0,0 +1,299 @@
+#include "packet_capture.hpp"
+#include "session_archive.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char kCaptureMagic[4] = {'W', 'S', 'P', 'C'};
+static const char kBlockMagic[4] = {'W', 'B', 'L', 'K'};
+static constexpr uint16_t kCaptureVersion = 1;
+static constexpr size_t kFileHeaderSize = 32;
+static constexpr size_t kBlockHeaderSize = 24;
+static constexpr size_t kIndexEntrySize = 24;
+static constexpr size_t kPacketHeaderSize = 6;
+// A block is written once it spans this long or grows this large
+static constexpr int64_t kBlockSpanNs = 1000000000;
+static constexpr size_t kBlockBytes = 64 * 1024;
+
+template <typename T> static T load_le(const char *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <typename T> static void store_le(char *p, T value) {
+  std::memcpy(p, &value, sizeof(T));
+}
+
+PacketCaptureWriter::PacketCaptureWriter(const std::string &path,
+                                         const AudioFormat &input)
+    : path_(path) {
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  index_.open(path + ".idx", std::ios::binary | std::ios::trunc);
+  if (!file_.is_open() || !index_.is_open()) {
+    std::cerr << "Failed to open packet capture: " << path << std::endl;
+    file_.close();
+    index_.close();
+    return;
+  }
+
+  char header[kFileHeaderSize] = {0};
+  std::memcpy(header, kCaptureMagic, sizeof(kCaptureMagic));
+  store_le<uint16_t>(header + 4, kCaptureVersion);
+  store_le<uint16_t>(header + 6, kFileHeaderSize);
+  store_le<uint32_t>(header + 8, static_cast<uint32_t>(input.sample_rate));
+  store_le<uint16_t>(header + 12, static_cast<uint16_t>(input.channels));
+  header[14] = static_cast<char>(input.format);
+  store_le<uint64_t>(header + 16, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::system_clock::now().time_since_epoch())
+                                      .count());
+  file_.write(header, sizeof(header));
+  file_.flush();
+  file_bytes_ = kFileHeaderSize;
+  stats_.bytes_written = kFileHeaderSize;
+  block_.reserve(kBlockBytes + kPacketHeaderSize + 65536);
+  std::cout << "Capturing packets to " << path << std::endl;
+}
+
+PacketCaptureWriter::~PacketCaptureWriter() { close(); }
+
+void PacketCaptureWriter::append(const char *data, size_t size, int64_t arrival_ns) {
+  if (!file_.is_open()) {
+    return;
+  }
+  if (block_packets_ > 0 &&
+      (arrival_ns - block_first_ns_ >= kBlockSpanNs || block_.size() >= kBlockBytes)) {
+    writeBlock();
+  }
+  if (block_packets_ == 0) {
+    block_first_ns_ = arrival_ns;
+  }
+
+  // Arrival times can step back with the wall clock; keep them ordered
+  const int64_t offset_us = std::max<int64_t>(0, (arrival_ns - block_first_ns_) / 1000);
+  size = std::min<size_t>(size, UINT16_MAX);
+  char packet[kPacketHeaderSize];
+  store_le<uint32_t>(packet, static_cast<uint32_t>(offset_us));
+  store_le<uint16_t>(packet + 4, static_cast<uint16_t>(size));
+  block_.insert(block_.end(), packet, packet + sizeof(packet));
+  block_.insert(block_.end(), data, data + size);
+  block_packets_++;
+  stats_.packets++;
+}
+
+void PacketCaptureWriter::writeBlock() {
+  char header[kBlockHeaderSize] = {0};
+  std::memcpy(header, kBlockMagic, sizeof(kBlockMagic));
+  store_le<uint32_t>(header + 4, block_packets_);
+  store_le<int64_t>(header + 8, block_first_ns_);
+  store_le<uint32_t>(header + 16, static_cast<uint32_t>(block_.size()));
+  store_le<uint32_t>(header + 20, archive_crc32(reinterpret_cast<const uint8_t *>(block_.data()),
+                                                block_.size()));
+
+  char entry[kIndexEntrySize] = {0};
+  store_le<uint64_t>(entry, file_bytes_);
+  store_le<int64_t>(entry + 8, block_first_ns_);
+  store_le<uint64_t>(entry + 16, stats_.packets - block_packets_);
+
+  file_.write(header, sizeof(header));
+  file_.write(block_.data(), block_.size());
+  // The block goes out before its index entry, so the index never points
+  // past the data
+  file_.flush();
+  index_.write(entry, sizeof(entry));
+  index_.flush();
+  if (!file_.good() || !index_.good()) {
+    std::cerr << "Failed to write packet capture block to " << path_
+              << "; capture stopped" << std::endl;
+    file_.close();
+    index_.close();
+  }
+
+  file_bytes_ += kBlockHeaderSize + block_.size();
+  stats_.blocks++;
+  stats_.bytes_written += kBlockHeaderSize + block_.size() + kIndexEntrySize;
+  block_.clear();
+  block_packets_ = 0;
+}
+
+void PacketCaptureWriter::close() {
+  if (!file_.is_open()) {
+    return;
+  }
+  if (block_packets_ > 0) {
+    writeBlock();
+  }
+  file_.close();
+  index_.close();
+}
+
+PacketCaptureReader::~PacketCaptureReader() { close(); }
+
+bool PacketCaptureReader::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::cerr << "Failed to open packet capture " << path << ": " << strerror(errno)
+              << std::endl;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  if (static_cast<size_t>(st.st_size) < kFileHeaderSize) {
+    std::cerr << "Not a packet capture: " << path << std::endl;
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Failed to map packet capture " << path << ": " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  // Replay reads front to back
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(data);
+  size_ = static_cast<size_t>(st.st_size);
+
+  if (std::memcmp(data_, kCaptureMagic, sizeof(kCaptureMagic)) != 0) {
+    std::cerr << "Not a packet capture: " << path << std::endl;
+    close();
+    return false;
+  }
+  input_.sample_rate = static_cast<int>(load_le<uint32_t>(data_ + 8));
+  input_.channels = load_le<uint16_t>(data_ + 12);
+  input_.format = static_cast<SampleFormat>(data_[14]);
+
+  std::ifstream index(path + ".idx", std::ios::binary);
+  char entry[kIndexEntrySize];
+  while (index.read(entry, sizeof(entry))) {
+    CaptureIndexEntry e;
+    e.offset = load_le<uint64_t>(entry);
+    e.first_arrival_ns = load_le<int64_t>(entry + 8);
+    e.first_packet = load_le<uint64_t>(entry + 16);
+    if (e.offset + kBlockHeaderSize > size_) {
+      break; // index written past a truncated file
+    }
+    blocks_.push_back(e);
+  }
+  // Without an index, rebuild it from the block headers
+  if (blocks_.empty()) {
+    scanBlocks();
+  }
+
+  if (!blocks_.empty()) {
+    first_arrival_ns_ = blocks_.front().first_arrival_ns;
+    // The last block gives the packet count and the last arrival
+    CapturedPacket packet;
+    seek(blocks_.back().first_arrival_ns);
+    packet_count_ = blocks_.back().first_packet;
+    while (next(packet)) {
+      packet_count_++;
+      last_arrival_ns_ = packet.arrival_ns;
+    }
+  }
+  seek(first_arrival_ns_);
+  return true;
+}
+
+void PacketCaptureReader::close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  blocks_.clear();
+  packet_count_ = 0;
+  first_arrival_ns_ = 0;
+  last_arrival_ns_ = 0;
+  block_ = 0;
+  remaining_ = 0;
+}
+
+bool PacketCaptureReader::scanBlocks() {
+  uint64_t offset = kFileHeaderSize;
+  uint64_t packets = 0;
+  while (offset + kBlockHeaderSize <= size_ &&
+         std::memcmp(data_ + offset, kBlockMagic, sizeof(kBlockMagic)) == 0) {
+    CaptureIndexEntry e;
+    e.offset = offset;
+    e.first_arrival_ns = load_le<int64_t>(data_ + offset + 8);
+    e.first_packet = packets;
+    blocks_.push_back(e);
+    packets += load_le<uint32_t>(data_ + offset + 4);
+    offset += kBlockHeaderSize + load_le<uint32_t>(data_ + offset + 16);
+  }
+  return !blocks_.empty();
+}
+
+void PacketCaptureReader::seek(int64_t arrival_ns) {
+  // Blocks are in arrival order; start at the last one beginning at or
+  // before `arrival_ns`
+  auto it = std::upper_bound(blocks_.begin(), blocks_.end(), arrival_ns,
+                             [](int64_t t, const CaptureIndexEntry &e) {
+                               return t < e.first_arrival_ns;
+                             });
+  block_ = it == blocks_.begin() ? 0 : static_cast<size_t>(it - blocks_.begin()) - 1;
+  remaining_ = 0;
+  cursor_ = 0;
+  block_end_ = 0;
+  if (block_ < blocks_.size() && !loadBlock(block_)) {
+    block_ = blocks_.size();
+  }
+}
+
+bool PacketCaptureReader::loadBlock(size_t block) {
+  const uint64_t offset = blocks_[block].offset;
+  if (offset + kBlockHeaderSize > size_ ||
+      std::memcmp(data_ + offset, kBlockMagic, sizeof(kBlockMagic)) != 0) {
+    return false;
+  }
+  const char *header = data_ + offset;
+  const uint32_t bytes = load_le<uint32_t>(header + 16);
+  if (offset + kBlockHeaderSize + bytes > size_ ||
+      archive_crc32(reinterpret_cast<const uint8_t *>(header + kBlockHeaderSize), bytes) !=
+          load_le<uint32_t>(header + 20)) {
+    return false; // torn tail
+  }
+  remaining_ = load_le<uint32_t>(header + 4);
+  block_first_ns_ = load_le<int64_t>(header + 8);
+  cursor_ = offset + kBlockHeaderSize;
+  block_end_ = cursor_ + bytes;
+  return true;
+}
+
+bool PacketCaptureReader::next(CapturedPacket &packet) {
+  while (remaining_ == 0) {
+    if (block_ + 1 >= blocks_.size() || !loadBlock(++block_)) {
+      block_ = blocks_.size();
+      return false;
+    }
+  }
+  if (cursor_ + kPacketHeaderSize > block_end_) {
+    remaining_ = 0;
+    return false;
+  }
+  const uint32_t offset_us = load_le<uint32_t>(data_ + cursor_);
+  const uint16_t size = load_le<uint16_t>(data_ + cursor_ + 4);
+  if (cursor_ + kPacketHeaderSize + size > block_end_) {
+    remaining_ = 0;
+    return false;
+  }
+  packet.arrival_ns = block_first_ns_ + static_cast<int64_t>(offset_us) * 1000;
+  packet.data = data_ + cursor_ + kPacketHeaderSize;
+  packet.size = size;
+  cursor_ += kPacketHeaderSize + size;
+  remaining_--;
+  return true;
+}
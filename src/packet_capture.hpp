@@ -0,0 +1,123 @@
+#ifndef PACKET_CAPTURE_HPP
+#define PACKET_CAPTURE_HPP
+
+#include "resampler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// On-disk layout (little-endian):
+//
+//   <path>       32-byte file header, then blocks back to back. A block is
+//                a 24-byte header and its packets; each packet is its
+//                arrival in microseconds after the block's first packet
+//                (4 bytes), its size (2 bytes) and the datagram as received
+//   <path>.idx   one 24-byte entry per block: file offset, arrival time of
+//                its first packet and the number of packets before it
+//
+// Both files are append-only and a block is written whole, so a crash
+// loses at most the block being filled; a torn tail fails its CRC and the
+// reader stops there. Without an index the reader rebuilds it from the
+// block headers.
+
+struct CaptureIndexEntry {
+  uint64_t offset = 0;
+  int64_t first_arrival_ns = 0; // CLOCK_REALTIME
+  uint64_t first_packet = 0;
+};
+
+struct CaptureStats {
+  uint64_t packets = 0;
+  uint64_t blocks = 0;
+  uint64_t bytes_written = 0;
+};
+
+// Records every datagram as it arrived. Not thread-safe: the receive
+// thread owns it. Packets are gathered into blocks in memory and each block
+// is written with one call, at most once a second.
+class PacketCaptureWriter {
+public:
+  // `input` is the declared sender format, replayed along with the packets
+  PacketCaptureWriter(const std::string &path, const AudioFormat &input);
+  ~PacketCaptureWriter();
+
+  PacketCaptureWriter(const PacketCaptureWriter &) = delete;
+  PacketCaptureWriter &operator=(const PacketCaptureWriter &) = delete;
+
+  bool isOpen() const { return file_.is_open(); }
+  void append(const char *data, size_t size, int64_t arrival_ns);
+  // Writes the open block; later packets start a new one
+  void close();
+
+  const std::string &path() const { return path_; }
+  const CaptureStats &stats() const { return stats_; }
+
+private:
+  void writeBlock();
+
+  std::string path_;
+  std::ofstream file_;
+  std::ofstream index_;
+  uint64_t file_bytes_ = 0;
+
+  std::vector<char> block_;
+  uint32_t block_packets_ = 0;
+  int64_t block_first_ns_ = 0;
+  CaptureStats stats_;
+};
+
+struct CapturedPacket {
+  int64_t arrival_ns = 0;
+  const char *data = nullptr;
+  size_t size = 0;
+};
+
+// Reads a capture through a read-only mapping of the file; packets point
+// into the mapping and stay valid while the reader is open.
+class PacketCaptureReader {
+public:
+  PacketCaptureReader() = default;
+  ~PacketCaptureReader();
+
+  PacketCaptureReader(const PacketCaptureReader &) = delete;
+  PacketCaptureReader &operator=(const PacketCaptureReader &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  const AudioFormat &input() const { return input_; }
+  const std::vector<CaptureIndexEntry> &blocks() const { return blocks_; }
+  uint64_t packetCount() const { return packet_count_; }
+  // Arrival of the first and last packets
+  int64_t firstArrivalNs() const { return first_arrival_ns_; }
+  int64_t lastArrivalNs() const { return last_arrival_ns_; }
+
+  // Continue from the block holding the packet that arrived at `arrival_ns`
+  void seek(int64_t arrival_ns);
+  // The next packet in arrival order; false at the end or at a torn block
+  bool next(CapturedPacket &packet);
+
+private:
+  bool loadBlock(size_t block);
+  bool scanBlocks();
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  AudioFormat input_;
+  std::vector<CaptureIndexEntry> blocks_;
+  uint64_t packet_count_ = 0;
+  int64_t first_arrival_ns_ = 0;
+  int64_t last_arrival_ns_ = 0;
+
+  // Iteration state
+  size_t block_ = 0;
+  size_t block_end_ = 0; // offset of the end of the current block
+  size_t cursor_ = 0;
+  uint32_t remaining_ = 0;
+  int64_t block_first_ns_ = 0;
+};
+
+#endif // PACKET_CAPTURE_HPP
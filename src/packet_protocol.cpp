@@ -0,0 +1,49 @@
+#include "packet_protocol.hpp"
+
+#include <cstring>
+
+template <typename T> static T load_le(const char *p) {
+  // The ESP32 and every host we run on are little-endian
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <typename T> static void store_le(char *p, T value) {
+  std::memcpy(p, &value, sizeof(T));
+}
+
+bool parse_audio_packet(const char *data, size_t size, AudioPacket &packet) {
+  if (size < kAudioPacketHeaderSize ||
+      std::memcmp(data, kAudioPacketMagic, sizeof(kAudioPacketMagic)) != 0) {
+    return false;
+  }
+
+  packet.version = static_cast<uint8_t>(data[4]);
+  size_t header_size = static_cast<uint8_t>(data[5]);
+  if (packet.version == 0 || header_size < kAudioPacketHeaderSize ||
+      header_size > size || header_size % sizeof(int16_t) != 0) {
+    return false;
+  }
+
+  packet.stream_id = load_le<uint16_t>(data + 6);
+  packet.sequence = load_le<uint32_t>(data + 8);
+  packet.sample_index = load_le<uint64_t>(data + 12);
+  packet.timestamp_us = load_le<uint64_t>(data + 20);
+  packet.flags = load_le<uint16_t>(data + 28);
+  packet.samples = reinterpret_cast<const int16_t *>(data + header_size);
+  packet.sample_count = (size - header_size) / sizeof(int16_t);
+  return true;
+}
+
+void write_audio_packet_header(const AudioPacket &packet, char *out) {
+  std::memcpy(out, kAudioPacketMagic, sizeof(kAudioPacketMagic));
+  out[4] = static_cast<char>(kAudioPacketVersion);
+  out[5] = static_cast<char>(kAudioPacketHeaderSize);
+  store_le<uint16_t>(out + 6, packet.stream_id);
+  store_le<uint32_t>(out + 8, packet.sequence);
+  store_le<uint64_t>(out + 12, packet.sample_index);
+  store_le<uint64_t>(out + 20, packet.timestamp_us);
+  store_le<uint16_t>(out + 28, packet.flags);
+  store_le<uint16_t>(out + 30, 0);
+}
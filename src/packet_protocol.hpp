@@ -0,0 +1,45 @@
+#ifndef PACKET_PROTOCOL_HPP
+#define PACKET_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Optional framing for UDP audio packets. Framed packets start with the
+// 4-byte magic "WSPK" followed by the rest of the header; anything else is
+// treated as the legacy raw int16 PCM stream. All fields are little-endian.
+//
+//   offset size field
+//        0    4 magic "WSPK"
+//        4    1 version (kAudioPacketVersion)
+//        5    1 header_size in bytes (>= 32, payload starts here)
+//        6    2 stream_id
+//        8    4 sequence, +1 per packet
+//       12    8 sample_index of the first payload sample
+//       20    8 timestamp_us on the sender's clock
+//       28    2 flags
+//       30    2 reserved
+//       32      int16 PCM payload
+static constexpr char kAudioPacketMagic[4] = {'W', 'S', 'P', 'K'};
+static constexpr uint8_t kAudioPacketVersion = 1;
+static constexpr size_t kAudioPacketHeaderSize = 32;
+
+struct AudioPacket {
+  uint8_t version = 0;
+  uint16_t stream_id = 0;
+  uint32_t sequence = 0;
+  uint64_t sample_index = 0;
+  uint64_t timestamp_us = 0;
+  uint16_t flags = 0;
+  const int16_t *samples = nullptr;
+  size_t sample_count = 0;
+};
+
+// Returns false when `data` is not a framed packet (legacy raw PCM) or the
+// header is malformed.
+bool parse_audio_packet(const char *data, size_t size, AudioPacket &packet);
+
+// Writes a header for `packet` into out[0..kAudioPacketHeaderSize). Used by
+// senders and test tools; the payload is appended by the caller.
+void write_audio_packet_header(const AudioPacket &packet, char *out);
+
+#endif // PACKET_PROTOCOL_HPP
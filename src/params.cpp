@@ -20,29 +20,293 @@ private:
 
 public:
     float context_duration_s = 100.0f;
-    float archive_interval_s = 20.0f;
+    float archive_interval_s = 3600.0f;
     float recognition_interval_s = 0.2f;
 
+    bool streaming = false;
+    bool vad = false;
+    bool server = false;
     bool save_audio = false;
     bool save_sync = false;
     bool use_gpu = false;
     bool flash_attn = false;
+    bool no_governor = false;
+    bool no_partials = false;
+    bool redecode = false;
 
     int segment_duration_s = 7;
+    int recv_buffer_kb = 4096;
+    int recv_batch = 32;
+    int listen_port = 5001;
+    int esp32_port = 5001;
+    int decoders = 0;
+    int threads = 0;
+    int latency_ms = 0;
+    int stream_buffer_s = 30;
+    int translate_deadline_ms = 3000;
+    int translate_batch_ms = 0;
+    int translate_cache = 1024;
+    int vad_silence_ms = 500;
+    float vad_threshold_db = 9.0f;
+    float vad_max_segment_s = 10.0f;
+    int jitter_depth_ms = 60;
+    int input_rate = 16000;
+    int input_channels = 1;
+    int archive_max_mb = 256;
+    int beam_size = 0;
+    float target_rtf = 0.8f;
+    float max_backlog_s = 10.0f;
+    float redecode_confidence = 0.6f;
+    int redecode_beam = 5;
+    int prompt_tokens = 64;
+    int metrics_port = 0;
+    int metrics_interval_s = 10;
+    int subtitle_port = 0;
+    int capture_buffer_s = 120;
+    float overload_backlog_s = 30.0f;
+    float overload_target_s = 2.0f;
+    float subtitle_rate_hz = 10.0f;
+    float replay_speed = 1.0f;
 
     std::string model = std::string(WHISPER_MODEL_PATH) + "/ggml-tiny.en.bin";
     // std::string model = std::string(WHISPER_MODEL_PATH) + "/ggml-base.en.bin";
+    std::string fallback_model = "";
     std::string translate = "";
+    std::string esp32_ip = "192.168.4.1";
+    std::string concealment = "interp";
+    std::string input_format = "int16";
+    std::string translate_endpoint = "";
+    std::string translate_cache_file = "";
+    std::string archive_policy = "drop-oldest";
+    std::string archive_codec = "delta";
+    std::string translate_policy = "coalesce";
+    std::string metrics_file = "";
+    std::string subtitle_socket = "";
+    std::string overload_policy = "skip-to-live";
+    std::string capture_packets = "";
+    std::string replay = "";
 
     Params() {
         addParam("-ri", "--recognition-interval", "Interval between recognitions in seconds",
                  [this](const std::string& val) { recognition_interval_s = std::stof(val); },
                  [this]() { return std::to_string(recognition_interval_s); });
 
-        addParam("-ai", "--archive-interval", "Duration of the audio archive in seconds",
+        addParam("-cd", "--context-duration", "Maximum audio context in streaming mode in seconds",
+                 [this](const std::string& val) { context_duration_s = std::stof(val); },
+                 [this]() { return std::to_string(context_duration_s); });
+
+        addParam("-st", "--streaming", "Re-decode a rolling window every recognition interval",
+                 [this](const std::string&) { streaming = true; },
+                 [this]() { return streaming ? "true" : "false"; });
+
+        addParam("--no-partials", "", "Only show text once a segment or pass is decoded",
+                 [this](const std::string&) { no_partials = true; },
+                 [this]() { return no_partials ? "true" : "false"; });
+
+        addParam("--vad", "", "Skip silence and cut segments at speech pauses",
+                 [this](const std::string&) { vad = true; },
+                 [this]() { return vad ? "true" : "false"; });
+
+        addParam("-vt", "--vad-threshold", "Speech level above the noise floor in dB",
+                 [this](const std::string& val) { vad_threshold_db = std::stof(val); },
+                 [this]() { return std::to_string(vad_threshold_db); });
+
+        addParam("-vs", "--vad-silence", "Pause (ms) that ends a speech segment",
+                 [this](const std::string& val) { vad_silence_ms = std::stoi(val); },
+                 [this]() { return std::to_string(vad_silence_ms); });
+
+        addParam("-vm", "--vad-max-segment", "Longest speech segment in seconds",
+                 [this](const std::string& val) { vad_max_segment_s = std::stof(val); },
+                 [this]() { return std::to_string(vad_max_segment_s); });
+
+        addParam("-ai", "--archive-interval", "Audio per archive file in seconds before rotating",
                  [this](const std::string& val) { archive_interval_s = std::stof(val); },
                  [this]() { return std::to_string(archive_interval_s); });
 
+        addParam("-rb", "--recv-buffer", "UDP socket receive buffer in KB",
+                 [this](const std::string& val) { recv_buffer_kb = std::stoi(val); },
+                 [this]() { return std::to_string(recv_buffer_kb); });
+
+        addParam("-bs", "--recv-batch", "Datagrams drained per receive syscall",
+                 [this](const std::string& val) { recv_batch = std::stoi(val); },
+                 [this]() { return std::to_string(recv_batch); });
+
+        addParam("-jd", "--jitter-depth", "Audio (ms) queued behind a lost packet before concealing it",
+                 [this](const std::string& val) { jitter_depth_ms = std::stoi(val); },
+                 [this]() { return std::to_string(jitter_depth_ms); });
+
+        addParam("--plc", "", "Packet loss concealment: silence or interp",
+                 [this](const std::string& val) { concealment = val; },
+                 [this]() { return concealment; });
+
+        addParam("--input-rate", "", "Sample rate the ESP32 captures at; resampled to 16000",
+                 [this](const std::string& val) { input_rate = std::stoi(val); },
+                 [this]() { return std::to_string(input_rate); });
+
+        addParam("--input-channels", "", "Interleaved channels per packet; downmixed to mono",
+                 [this](const std::string& val) { input_channels = std::stoi(val); },
+                 [this]() { return std::to_string(input_channels); });
+
+        addParam("--input-format", "", "Raw packet sample format: int16, int24 or float32",
+                 [this](const std::string& val) { input_format = val; },
+                 [this]() { return input_format; });
+
+        addParam("--translate-endpoint", "", "Translation API URL (default: Google Translate v2)",
+                 [this](const std::string& val) { translate_endpoint = val; },
+                 [this]() { return translate_endpoint; });
+
+        addParam("--translate-deadline", "", "Per-request translation deadline in ms",
+                 [this](const std::string& val) { translate_deadline_ms = std::stoi(val); },
+                 [this]() { return std::to_string(translate_deadline_ms); });
+
+        addParam("--translate-batch", "", "Collect texts this many ms into one translation request",
+                 [this](const std::string& val) { translate_batch_ms = std::stoi(val); },
+                 [this]() { return std::to_string(translate_batch_ms); });
+
+        addParam("--translate-cache", "", "Cached translations kept in memory (0 disables)",
+                 [this](const std::string& val) { translate_cache = std::stoi(val); },
+                 [this]() { return std::to_string(translate_cache); });
+
+        addParam("--translate-cache-file", "", "Persist the translation cache to this file",
+                 [this](const std::string& val) { translate_cache_file = val; },
+                 [this]() { return translate_cache_file; });
+
+        addParam("--esp32-ip", "", "Address of the ESP32 microphone",
+                 [this](const std::string& val) { esp32_ip = val; },
+                 [this]() { return esp32_ip; });
+
+        addParam("--esp32-port", "", "UDP port of the ESP32 microphone",
+                 [this](const std::string& val) { esp32_port = std::stoi(val); },
+                 [this]() { return std::to_string(esp32_port); });
+
+        addParam("--server", "", "Accept many ESP32 streams sharing one model",
+                 [this](const std::string&) { server = true; },
+                 [this]() { return server ? "true" : "false"; });
+
+        addParam("-p", "--port", "UDP port to listen on in server mode",
+                 [this](const std::string& val) { listen_port = std::stoi(val); },
+                 [this]() { return std::to_string(listen_port); });
+
+        addParam("-dw", "--decoders", "Concurrent decodes, 0 for 1 (2 in server mode)",
+                 [this](const std::string& val) { decoders = std::stoi(val); },
+                 [this]() { return std::to_string(decoders); });
+
+        addParam("-t", "--threads", "Inference threads split across decoders, 0 for all cores",
+                 [this](const std::string& val) { threads = std::stoi(val); },
+                 [this]() { return std::to_string(threads); });
+
+        addParam("-lt", "--latency", "Decode deadline in ms, 0 for one segment or interval",
+                 [this](const std::string& val) { latency_ms = std::stoi(val); },
+                 [this]() { return std::to_string(latency_ms); });
+
+        addParam("-sb", "--stream-buffer", "Audio buffered per stream in server mode in seconds",
+                 [this](const std::string& val) { stream_buffer_s = std::stoi(val); },
+                 [this]() { return std::to_string(stream_buffer_s); });
+
+        addParam("-am", "--archive-max", "Archive file size in MB before rotating",
+                 [this](const std::string& val) { archive_max_mb = std::stoi(val); },
+                 [this]() { return std::to_string(archive_max_mb); });
+
+        addParam("--archive-codec", "", "Archived audio: int16 or delta (lossless)",
+                 [this](const std::string& val) { archive_codec = val; },
+                 [this]() { return archive_codec; });
+
+        addParam("--beam-size", "", "Beam width when the host keeps up, 0 for greedy",
+                 [this](const std::string& val) { beam_size = std::stoi(val); },
+                 [this]() { return std::to_string(beam_size); });
+
+        addParam("--target-rtf", "", "Decode time per second of audio to stay under",
+                 [this](const std::string& val) { target_rtf = std::stof(val); },
+                 [this]() { return std::to_string(target_rtf); });
+
+        addParam("--max-backlog", "", "Buffered audio in seconds that counts as falling behind",
+                 [this](const std::string& val) { max_backlog_s = std::stof(val); },
+                 [this]() { return std::to_string(max_backlog_s); });
+
+        addParam("--fallback-model", "", "Smaller model to switch to when even greedy falls behind",
+                 [this](const std::string& val) { fallback_model = val; },
+                 [this]() { return fallback_model; });
+
+        addParam("--prompt-tokens", "", "Tokens of recent text passed to each decode as context, 0 for none",
+                 [this](const std::string& val) { prompt_tokens = std::stoi(val); },
+                 [this]() { return std::to_string(prompt_tokens); });
+
+        addParam("--redecode", "", "Decode greedily, then again with beam search or sampling where unsure",
+                 [this](const std::string&) { redecode = true; },
+                 [this]() { return redecode ? "true" : "false"; });
+
+        addParam("--redecode-confidence", "", "Mean token probability below which --redecode tries again",
+                 [this](const std::string& val) { redecode_confidence = std::stof(val); },
+                 [this]() { return std::to_string(redecode_confidence); });
+
+        addParam("--redecode-beam", "", "Beam width of the --redecode retry, 0 to only sample",
+                 [this](const std::string& val) { redecode_beam = std::stoi(val); },
+                 [this]() { return std::to_string(redecode_beam); });
+
+        addParam("--no-governor", "", "Keep decode settings fixed instead of adapting to the host",
+                 [this](const std::string&) { no_governor = true; },
+                 [this]() { return no_governor ? "true" : "false"; });
+
+        addParam("--metrics-port", "", "Serve /metrics on 127.0.0.1 at this port, 0 for off",
+                 [this](const std::string& val) { metrics_port = std::stoi(val); },
+                 [this]() { return std::to_string(metrics_port); });
+
+        addParam("--metrics-interval", "", "Seconds between metrics file lines",
+                 [this](const std::string& val) { metrics_interval_s = std::stoi(val); },
+                 [this]() { return std::to_string(metrics_interval_s); });
+
+        addParam("--metrics-file", "", "JSON-lines metrics log, default metrics.jsonl in the log directory",
+                 [this](const std::string& val) { metrics_file = val; },
+                 [this]() { return metrics_file; });
+
+        addParam("--subtitle-socket", "", "Publish live subtitles on this unix socket path",
+                 [this](const std::string& val) { subtitle_socket = val; },
+                 [this]() { return subtitle_socket; });
+
+        addParam("--subtitle-port", "", "Publish live subtitles (JSON lines or WebSocket) on 127.0.0.1 at this port, 0 for off",
+                 [this](const std::string& val) { subtitle_port = std::stoi(val); },
+                 [this]() { return std::to_string(subtitle_port); });
+
+        addParam("--subtitle-rate", "", "Default subtitle updates per second per subscriber, 0 for every change",
+                 [this](const std::string& val) { subtitle_rate_hz = std::stof(val); },
+                 [this]() { return std::to_string(subtitle_rate_hz); });
+
+        addParam("--capture-buffer", "", "Seconds of captured audio held for decoding, 64 KB each",
+                 [this](const std::string& val) { capture_buffer_s = std::stoi(val); },
+                 [this]() { return std::to_string(capture_buffer_s); });
+
+        addParam("--overload-policy", "", "Backlog too long: skip-to-live, drop-silence, reduce-context, markers or off",
+                 [this](const std::string& val) { overload_policy = val; },
+                 [this]() { return overload_policy; });
+
+        addParam("--overload-backlog", "", "Seconds of undecoded audio that count as overloaded",
+                 [this](const std::string& val) { overload_backlog_s = std::stof(val); },
+                 [this]() { return std::to_string(overload_backlog_s); });
+
+        addParam("--overload-target", "", "Seconds of backlog left after skipping to live",
+                 [this](const std::string& val) { overload_target_s = std::stof(val); },
+                 [this]() { return std::to_string(overload_target_s); });
+
+        addParam("--capture-packets", "", "Record every packet from the ESP32 with its arrival time to this file",
+                 [this](const std::string& val) { capture_packets = val; },
+                 [this]() { return capture_packets; });
+
+        addParam("--replay", "", "Take packets from a --capture-packets file instead of the ESP32",
+                 [this](const std::string& val) { replay = val; },
+                 [this]() { return replay; });
+
+        addParam("--replay-speed", "", "Replay timing: 1 as recorded, 0 as fast as decoding goes",
+                 [this](const std::string& val) { replay_speed = std::stof(val); },
+                 [this]() { return std::to_string(replay_speed); });
+
+        addParam("--archive-policy", "", "Full disk queue: block, drop-oldest or coalesce",
+                 [this](const std::string& val) { archive_policy = val; },
+                 [this]() { return archive_policy; });
+
+        addParam("--translate-policy", "", "Full translation queue: block, drop-oldest or coalesce",
+                 [this](const std::string& val) { translate_policy = val; },
+                 [this]() { return translate_policy; });
+
         addParam("--save-audio", "", "Save audio to file",
                  [this](const std::string&) { save_audio = true; },
                  [this]() { return save_audio ? "true" : "false"; });
@@ -128,9 +392,23 @@ public:
         std::vector<std::pair<std::string, Param>> string_params;
 
         for (const auto& [key, param] : params) {
-            if (key.find("-ad") != std::string::npos || key.find("-cd") != std::string::npos || key.find("-ri") != std::string::npos) {
+            if (key.find("-ad") != std::string::npos || key.find("-cd") != std::string::npos || key.find("-ri") != std::string::npos ||
+                key.find("-rb") != std::string::npos || key.find("-bs") != std::string::npos ||
+                key.find("-jd") != std::string::npos || key.find("-vt") != std::string::npos ||
+                key.find("-vs") != std::string::npos || key.find("-vm") != std::string::npos ||
+                key.find("-deadline") != std::string::npos || key.find("--translate-batch") != std::string::npos ||
+                key == "--translate-cache" || key.find("-port") != std::string::npos ||
+                key.find("-dw") != std::string::npos || key.find("--threads") != std::string::npos ||
+                key.find("-lt") != std::string::npos || key.find("-am") != std::string::npos ||
+                key.find("-sb") != std::string::npos || key == "--metrics-interval" ||
+                key == "--beam-size" || key == "--target-rtf" || key == "--max-backlog" ||
+                key == "--input-rate" || key == "--input-channels" || key == "--subtitle-rate" ||
+                key == "--capture-buffer" || key == "--overload-backlog" || key == "--overload-target" ||
+                key == "--redecode-confidence" || key == "--redecode-beam" || key == "--prompt-tokens" ||
+                key == "--replay-speed") {
                 int_params.push_back({key, param});
-            } else if (key.find("--save") != std::string::npos || key.find("--use-gpu") != std::string::npos || key.find("--flash-attn") != std::string::npos) {
+            } else if (key.find("--save") != std::string::npos || key.find("--streaming") != std::string::npos ||
+                       key == "--vad" || key == "--server" || key == "--no-governor" || key == "--no-partials" || key == "--redecode" || key.find("--use-gpu") != std::string::npos || key.find("--flash-attn") != std::string::npos) {
                 bool_params.push_back({key, param});
             } else {
                 string_params.push_back({key, param});
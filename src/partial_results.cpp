@@ -0,0 +1,129 @@
+#include "partial_results.hpp"
+
+#include <utility>
+
+DecodeResultStream::DecodeResultStream(ResultCallback callback, int64_t offset_ms,
+                                       int64_t duration_ms)
+    : callback_(std::move(callback)), offset_ms_(offset_ms),
+      end_ms_(offset_ms + duration_ms), committed_ms_(offset_ms),
+      started_(LatencyHistogram::Clock::now()) {}
+
+void DecodeResultStream::attach(whisper_full_params &params) {
+  logits_filter_ = params.logits_filter_callback;
+  logits_filter_data_ = params.logits_filter_callback_user_data;
+  new_segment_ = params.new_segment_callback;
+  new_segment_data_ = params.new_segment_callback_user_data;
+  params.logits_filter_callback = onLogitsFilter;
+  params.logits_filter_callback_user_data = this;
+  params.new_segment_callback = onNewSegment;
+  params.new_segment_callback_user_data = this;
+  started_ = LatencyHistogram::Clock::now();
+}
+
+void DecodeResultStream::onLogitsFilter(whisper_context *ctx, whisper_state *state,
+                                        const whisper_token_data *tokens, int n_tokens,
+                                        float *logits, void *user_data) {
+  auto *stream = static_cast<DecodeResultStream *>(user_data);
+  stream->partial(ctx, tokens, n_tokens);
+  if (stream->logits_filter_ != nullptr) {
+    stream->logits_filter_(ctx, state, tokens, n_tokens, logits, stream->logits_filter_data_);
+  }
+}
+
+void DecodeResultStream::onNewSegment(whisper_context *ctx, whisper_state *state,
+                                      int n_new, void *user_data) {
+  auto *stream = static_cast<DecodeResultStream *>(user_data);
+  const int n_segments = whisper_full_n_segments_from_state(state);
+  for (int i = n_segments - n_new; i < n_segments; i++) {
+    stream->final(ctx, state, i);
+  }
+  if (stream->new_segment_ != nullptr) {
+    stream->new_segment_(ctx, state, n_new, stream->new_segment_data_);
+  }
+}
+
+void DecodeResultStream::partial(whisper_context *ctx, const whisper_token_data *tokens,
+                                 int n_tokens) {
+  static LatencyHistogram &first_partial = global_metrics().histogram(
+      "first_partial", "Decode start to its first tentative text");
+
+  // A shorter sequence is a new segment or a temperature fallback; equal
+  // lengths are the other beams of a step already reported
+  if (n_tokens < reported_tokens_) {
+    reported_tokens_ = 0;
+  }
+  if (n_tokens <= reported_tokens_) {
+    return;
+  }
+  reported_tokens_ = n_tokens;
+
+  // Timestamp and control tokens all sort after end-of-text; a step that
+  // only added one of those has no new text
+  const whisper_token eot = whisper_token_eot(ctx);
+  size_t text_tokens = 0;
+  for (int i = 0; i < n_tokens; i++) {
+    text_tokens += tokens[i].id < eot;
+  }
+  if (text_tokens == 0 || (!update_.final && text_tokens == update_.tokens.size())) {
+    return;
+  }
+
+  update_.final = false;
+  update_.text.clear();
+  update_.tokens.clear();
+  float p_sum = 0.0f;
+  for (int i = 0; i < n_tokens; i++) {
+    if (tokens[i].id >= eot) {
+      continue;
+    }
+    ResultToken token;
+    token.text = whisper_token_to_str(ctx, tokens[i].id);
+    token.p = tokens[i].p;
+    update_.text += token.text;
+    p_sum += token.p;
+    update_.tokens.push_back(std::move(token));
+  }
+  update_.t0_ms = committed_ms_;
+  update_.t1_ms = end_ms_;
+  update_.confidence = p_sum / update_.tokens.size();
+
+  if (partials_++ == 0) {
+    first_partial.recordSince(started_);
+  }
+  callback_(update_);
+}
+
+void DecodeResultStream::final(whisper_context *ctx, whisper_state *state, int segment) {
+  const whisper_token eot = whisper_token_eot(ctx);
+  update_.final = true;
+  update_.text = whisper_full_get_segment_text_from_state(state, segment);
+  update_.tokens.clear();
+  // Segment times are in 10 ms units from the start of the samples
+  update_.t0_ms = offset_ms_ + whisper_full_get_segment_t0_from_state(state, segment) * 10;
+  update_.t1_ms = offset_ms_ + whisper_full_get_segment_t1_from_state(state, segment) * 10;
+
+  float p_sum = 0.0f;
+  const int n_tokens = whisper_full_n_tokens_from_state(state, segment);
+  for (int i = 0; i < n_tokens; i++) {
+    const whisper_token_data data = whisper_full_get_token_data_from_state(state, segment, i);
+    if (data.id >= eot) {
+      continue;
+    }
+    ResultToken token;
+    token.text = whisper_full_get_token_text_from_state(ctx, state, segment, i);
+    token.p = data.p;
+    // Only set with token_timestamps
+    if (data.t0 >= 0 && data.t1 > data.t0) {
+      token.t0_ms = offset_ms_ + data.t0 * 10;
+      token.t1_ms = offset_ms_ + data.t1 * 10;
+    }
+    p_sum += token.p;
+    update_.tokens.push_back(std::move(token));
+  }
+  update_.confidence = update_.tokens.empty() ? 0.0f : p_sum / update_.tokens.size();
+
+  committed_ms_ = update_.t1_ms;
+  reported_tokens_ = 0;
+  finals_++;
+  callback_(update_);
+}
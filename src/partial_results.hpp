@@ -0,0 +1,86 @@
+#ifndef PARTIAL_RESULTS_HPP
+#define PARTIAL_RESULTS_HPP
+
+#include "metrics.hpp"
+#include "whisper.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ResultToken {
+  std::string text;
+  float p = 0.0f; // probability the decoder gave the token
+  // Session time in ms; -1 until whisper has placed the token
+  int64_t t0_ms = -1;
+  int64_t t1_ms = -1;
+};
+
+// Text reported while a decode is running (tentative) or once whisper has
+// finished a segment (final)
+struct ResultUpdate {
+  bool final = false;
+  std::string text;
+  // Session audio the text covers, in ms. Tentative text spans from the
+  // end of the last final segment to the end of the decoded audio.
+  int64_t t0_ms = 0;
+  int64_t t1_ms = 0;
+  float confidence = 0.0f; // mean token probability
+  std::vector<ResultToken> tokens;
+};
+
+using ResultCallback = std::function<void(const ResultUpdate &update)>;
+
+// Reports the text of one whisper_full call as it is decoded.
+//
+// attach() hooks the logits-filter callback, which whisper calls before
+// every sampling step with the tokens decoded so far, and the new-segment
+// callback, which fires when a segment is complete. Callbacks already set
+// in the params are still called. With beam search, only the first beam of
+// each step is reported. The callback runs on the decoding thread, so it
+// should hand the update off rather than do work.
+class DecodeResultStream {
+public:
+  // `offset_ms` is the session time of the first sample passed to
+  // whisper_full, and `duration_ms` how much audio follows it
+  DecodeResultStream(ResultCallback callback, int64_t offset_ms, int64_t duration_ms);
+
+  DecodeResultStream(const DecodeResultStream &) = delete;
+  DecodeResultStream &operator=(const DecodeResultStream &) = delete;
+
+  // Must stay alive until whisper_full returns
+  void attach(whisper_full_params &params);
+
+  int partials() const { return partials_; }
+  int finals() const { return finals_; }
+
+private:
+  static void onLogitsFilter(whisper_context *ctx, whisper_state *state,
+                             const whisper_token_data *tokens, int n_tokens,
+                             float *logits, void *user_data);
+  static void onNewSegment(whisper_context *ctx, whisper_state *state, int n_new,
+                           void *user_data);
+
+  void partial(whisper_context *ctx, const whisper_token_data *tokens, int n_tokens);
+  void final(whisper_context *ctx, whisper_state *state, int segment);
+
+  ResultCallback callback_;
+  int64_t offset_ms_;
+  int64_t end_ms_;
+  // End of the last final segment; tentative text starts here
+  int64_t committed_ms_;
+  // Tokens in the last partial, so each decoding step is reported once
+  int reported_tokens_ = 0;
+  int partials_ = 0;
+  int finals_ = 0;
+  LatencyHistogram::Clock::time_point started_;
+  ResultUpdate update_;
+
+  whisper_logits_filter_callback logits_filter_ = nullptr;
+  void *logits_filter_data_ = nullptr;
+  whisper_new_segment_callback new_segment_ = nullptr;
+  void *new_segment_data_ = nullptr;
+};
+
+#endif // PARTIAL_RESULTS_HPP
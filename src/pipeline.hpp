@@ -0,0 +1,196 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// What a full queue does with a new item
+enum class BackpressurePolicy {
+  Block,      // wait for the consumer
+  DropOldest, // discard the oldest queued item
+  Coalesce,   // merge into the newest queued item
+};
+
+inline bool parse_backpressure_policy(const std::string &name,
+                                      BackpressurePolicy &policy) {
+  if (name == "block") {
+    policy = BackpressurePolicy::Block;
+  } else if (name == "drop-oldest") {
+    policy = BackpressurePolicy::DropOldest;
+  } else if (name == "coalesce") {
+    policy = BackpressurePolicy::Coalesce;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct QueueStats {
+  size_t depth = 0;
+  size_t max_depth = 0;
+  size_t capacity = 0;
+  uint64_t pushed = 0;
+  uint64_t popped = 0;
+  uint64_t dropped = 0;
+  uint64_t coalesced = 0;
+};
+
+// Bounded multi-producer queue between pipeline stages.
+//
+// Stage queues carry a handful of items per second (segments, transcripts),
+// so a mutex is cheaper than it looks here; the only high-rate handoff,
+// capture -> inference, stays on the lock-free audio ring.
+template <typename T> class BoundedQueue {
+public:
+  using Merge = std::function<void(T &queued, T &&incoming)>;
+
+  BoundedQueue(std::string name, size_t capacity, BackpressurePolicy policy,
+               Merge merge = nullptr)
+      : name_(std::move(name)), capacity_(std::max<size_t>(capacity, 1)),
+        policy_(policy), merge_(std::move(merge)) {}
+
+  // Returns false once the queue is closed
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+      return false;
+    }
+
+    if (items_.size() >= capacity_) {
+      if (policy_ == BackpressurePolicy::Block) {
+        not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+          return false;
+        }
+      } else if (policy_ == BackpressurePolicy::Coalesce && merge_) {
+        merge_(items_.back(), std::move(item));
+        pushed_++;
+        coalesced_++;
+        return true;
+      } else {
+        items_.pop_front();
+        dropped_++;
+      }
+    }
+
+    items_.push_back(std::move(item));
+    pushed_++;
+    max_depth_ = std::max(max_depth_, items_.size());
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Blocks until an item is available; false once closed and drained
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+
+    item = std::move(items_.front());
+    items_.pop_front();
+    popped_++;
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Wake everyone; consumers still drain what is queued
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  const std::string &name() const { return name_; }
+
+  QueueStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    QueueStats stats;
+    stats.depth = items_.size();
+    stats.max_depth = max_depth_;
+    stats.capacity = capacity_;
+    stats.pushed = pushed_;
+    stats.popped = popped_;
+    stats.dropped = dropped_;
+    stats.coalesced = coalesced_;
+    return stats;
+  }
+
+  std::string describe() const {
+    QueueStats s = stats();
+    std::ostringstream out;
+    out << name_ << " " << s.depth << "/" << s.capacity << " (max "
+        << s.max_depth << ", " << s.dropped << " dropped, " << s.coalesced
+        << " coalesced)";
+    return out.str();
+  }
+
+private:
+  std::string name_;
+  size_t capacity_;
+  BackpressurePolicy policy_;
+  Merge merge_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<T> items_;
+  bool closed_ = false;
+
+  size_t max_depth_ = 0;
+  uint64_t pushed_ = 0;
+  uint64_t popped_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t coalesced_ = 0;
+};
+
+// A thread that drains one queue until it is closed. The queue must
+// outlive the stage.
+class PipelineStage {
+public:
+  template <typename T, typename Fn>
+  PipelineStage(std::string name, BoundedQueue<T> &input, Fn fn)
+      : name_(std::move(name)), close_([&input] { input.close(); }),
+        thread_([&input, fn]() mutable {
+          T item;
+          while (input.pop(item)) {
+            fn(item);
+          }
+        }) {}
+
+  // Closes the input so an early return never waits on a stage nothing
+  // feeds any more; whatever is queued is still processed
+  ~PipelineStage() {
+    close_();
+    join();
+  }
+
+  PipelineStage(const PipelineStage &) = delete;
+  PipelineStage &operator=(const PipelineStage &) = delete;
+
+  void join() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  const std::string &name() const { return name_; }
+
+private:
+  std::string name_;
+  std::function<void()> close_;
+  std::thread thread_;
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,116 @@
+#include "prompt_ring.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+PromptRing::PromptRing(int max_tokens) : max_tokens_(std::max(0, max_tokens)) {}
+
+void PromptRing::append(const std::string &text) {
+  if (max_tokens_ == 0 || text.find_first_not_of(' ') == std::string::npos) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.push_back({text, {}, 0});
+  // Every text is at least one token, so older ones are never needed
+  while (entries_.size() > static_cast<size_t>(max_tokens_)) {
+    entries_.pop_front();
+  }
+}
+
+void PromptRing::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+bool PromptRing::tokenize(whisper_context *ctx, Entry &entry) {
+  const int vocab = whisper_n_vocab(ctx);
+  if (entry.vocab == vocab) {
+    return true;
+  }
+  if (entry.vocab != 0) {
+    stats_.retokenized++;
+  }
+  stats_.tokenized++;
+
+  // A token covers at least one byte; the slack is for the first try only
+  entry.tokens.resize(entry.text.size() + 1);
+  int n = whisper_tokenize(ctx, entry.text.c_str(), entry.tokens.data(),
+                           static_cast<int>(entry.tokens.size()));
+  if (n < 0) {
+    entry.tokens.resize(-n);
+    n = whisper_tokenize(ctx, entry.text.c_str(), entry.tokens.data(),
+                         static_cast<int>(entry.tokens.size()));
+  }
+  if (n < 0) {
+    std::cerr << "Failed to tokenize prompt text: " << entry.text << std::endl;
+    entry.tokens.clear();
+    entry.vocab = 0;
+    return false;
+  }
+  entry.tokens.resize(n);
+  entry.vocab = vocab;
+  return true;
+}
+
+void PromptRing::apply(whisper_context *ctx, whisper_full_params &params,
+                       std::vector<whisper_token> &storage) {
+  storage.clear();
+  // A text prompt would replace the tokens
+  params.initial_prompt = nullptr;
+  params.prompt_tokens = nullptr;
+  params.prompt_n_tokens = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.decodes++;
+  const size_t limit =
+      std::min<size_t>(max_tokens_, std::max(0, whisper_n_text_ctx(ctx) / 2));
+  if (limit == 0 || entries_.empty()) {
+    return;
+  }
+
+  // Newest first, until the cap is covered
+  size_t first = entries_.size();
+  size_t total = 0;
+  while (first > 0 && total < limit) {
+    Entry &entry = entries_[--first];
+    if (!tokenize(ctx, entry)) {
+      entries_.erase(entries_.begin(), entries_.begin() + first + 1);
+      first = 0;
+      break;
+    }
+    total += entry.tokens.size();
+  }
+  // Texts older than the cap cannot be needed again
+  entries_.erase(entries_.begin(), entries_.begin() + first);
+
+  for (const Entry &entry : entries_) {
+    storage.insert(storage.end(), entry.tokens.begin(), entry.tokens.end());
+  }
+  if (storage.size() > limit) {
+    storage.erase(storage.begin(), storage.end() - limit);
+  }
+  if (!storage.empty()) {
+    params.prompt_tokens = storage.data();
+    params.prompt_n_tokens = static_cast<int>(storage.size());
+    stats_.prompted++;
+    stats_.prompt_tokens += storage.size();
+  }
+}
+
+PromptStats PromptRing::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string PromptRing::describe() const {
+  PromptStats s = getStats();
+  std::ostringstream out;
+  out << "Prompt: " << s.prompted << " of " << s.decodes << " decodes had context, "
+      << s.meanPromptTokens() << " tokens on average (cap " << max_tokens_ << "), "
+      << s.tokenized << " texts tokenized";
+  if (s.retokenized > 0) {
+    out << " (" << s.retokenized << " again after a model swap)";
+  }
+  return out.str();
+}
@@ -0,0 +1,67 @@
+#ifndef PROMPT_RING_HPP
+#define PROMPT_RING_HPP
+
+#include "whisper.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct PromptStats {
+  uint64_t decodes = 0;
+  uint64_t prompted = 0;      // decodes that had any context
+  uint64_t prompt_tokens = 0; // summed over decodes
+  uint64_t tokenized = 0;     // texts run through the tokenizer
+  uint64_t retokenized = 0;   // of those, again for a model with another vocabulary
+
+  double meanPromptTokens() const {
+    return decodes > 0 ? static_cast<double>(prompt_tokens) / decodes : 0.0;
+  }
+};
+
+// Recently committed text, fed to the next decode as prompt_tokens.
+//
+// Each committed text is tokenized once, by the first decode that needs
+// it, and its tokens are reused until they fall out of the ring. Tokens
+// belong to the model's vocabulary, so after a swap to a model with a
+// different one the texts are tokenized again. The prompt is capped at
+// max_tokens, and at half of whisper's text context as whisper itself
+// does, so it never grows the decoder's work beyond a fixed bound.
+class PromptRing {
+public:
+  // 0 decodes every segment without context
+  explicit PromptRing(int max_tokens);
+
+  // Text now final, in decode order
+  void append(const std::string &text);
+  // The next audio does not follow on from the text so far
+  void clear();
+
+  // Sets params.prompt_tokens to the newest context for `ctx`, which
+  // `storage` keeps alive until the decode returns. Called from the
+  // decode job.
+  void apply(whisper_context *ctx, whisper_full_params &params,
+             std::vector<whisper_token> &storage);
+
+  int maxTokens() const { return max_tokens_; }
+  PromptStats getStats() const;
+  std::string describe() const;
+
+private:
+  struct Entry {
+    std::string text;
+    std::vector<whisper_token> tokens;
+    int vocab = 0; // n_vocab of the model `tokens` are for, 0 before tokenizing
+  };
+
+  bool tokenize(whisper_context *ctx, Entry &entry);
+
+  const int max_tokens_;
+  mutable std::mutex mutex_;
+  std::deque<Entry> entries_;
+  PromptStats stats_;
+};
+
+#endif // PROMPT_RING_HPP
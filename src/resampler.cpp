@@ -0,0 +1,292 @@
+#include "resampler.hpp"
+#include "sample_convert.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define RESAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+static constexpr float kInt16Scale = 1.0f / 32768.0f;
+static constexpr float kInt24Scale = 1.0f / 8388608.0f;
+// Pass band edge as a fraction of the lower Nyquist frequency
+static constexpr double kPassBand = 0.9;
+// Kaiser window shape; ~80 dB stopband
+static constexpr double kKaiserBeta = 8.0;
+// Taps are rounded up to whole vectors
+static constexpr int kTapAlign = 8;
+
+bool parse_sample_format(const std::string &name, SampleFormat &format) {
+  if (name == "int16" || name == "s16") {
+    format = SampleFormat::Int16;
+  } else if (name == "int24" || name == "s24") {
+    format = SampleFormat::Int24;
+  } else if (name == "float32" || name == "f32") {
+    format = SampleFormat::Float32;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+size_t sample_format_bytes(SampleFormat format) {
+  switch (format) {
+  case SampleFormat::Int16:
+    return 2;
+  case SampleFormat::Int24:
+    return 3;
+  case SampleFormat::Float32:
+    return 4;
+  }
+  return 2;
+}
+
+static inline float read_sample(const char *p, SampleFormat format) {
+  switch (format) {
+  case SampleFormat::Int16: {
+    int16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v * kInt16Scale;
+  }
+  case SampleFormat::Int24: {
+    const uint8_t *b = reinterpret_cast<const uint8_t *>(p);
+    // Place the 24 bits at the top of an int32 and shift back to sign-extend
+    const int32_t v = static_cast<int32_t>(static_cast<uint32_t>(b[0]) << 8 |
+                                           static_cast<uint32_t>(b[1]) << 16 |
+                                           static_cast<uint32_t>(b[2]) << 24) >> 8;
+    return v * kInt24Scale;
+  }
+  case SampleFormat::Float32: {
+    float v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  }
+  return 0.0f;
+}
+
+void downmix_to_float(const char *data, size_t frames, int channels,
+                      SampleFormat format, float *out) {
+  if (channels == 1) {
+    if (format == SampleFormat::Int16) {
+      // The common case keeps the vectorized converter
+      if (reinterpret_cast<uintptr_t>(data) % alignof(int16_t) == 0) {
+        convert_int16_to_float(reinterpret_cast<const int16_t *>(data), out, frames);
+        return;
+      }
+    } else if (format == SampleFormat::Float32) {
+      std::memcpy(out, data, frames * sizeof(float));
+      return;
+    }
+  }
+
+  const size_t bytes = sample_format_bytes(format);
+  const size_t stride = bytes * channels;
+  const float scale = 1.0f / channels;
+  for (size_t i = 0; i < frames; i++) {
+    const char *frame = data + i * stride;
+    float sum = 0.0f;
+    for (int c = 0; c < channels; c++) {
+      sum += read_sample(frame + c * bytes, format);
+    }
+    out[i] = sum * scale;
+  }
+}
+
+// Zeroth-order modified Bessel function of the first kind, for the window
+static double bessel_i0(double x) {
+  double sum = 1.0, term = 1.0;
+  const double q = x * x / 4.0;
+  for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+    term *= q / (static_cast<double>(k) * k);
+    sum += term;
+  }
+  return sum;
+}
+
+// All kernels take n as a multiple of kTapAlign
+#if defined(RESAMPLER_X86)
+
+static float dot_sse(const float *a, const float *b, int n) {
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for (int i = 0; i < n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  __m128 acc = _mm_add_ps(acc0, acc1);
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  return _mm_cvtss_f32(acc);
+}
+
+#if defined(__GNUC__) || (defined(__AVX2__) && defined(__FMA__))
+#if defined(__GNUC__)
+#define RESAMPLER_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define RESAMPLER_AVX2_TARGET
+#endif
+
+RESAMPLER_AVX2_TARGET static float dot_avx2(const float *a, const float *b, int n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  if (i < n) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+#endif
+
+using DotFn = float (*)(const float *, const float *, int);
+
+static DotFn select_dot() {
+#if defined(__AVX2__) && defined(__FMA__)
+  return dot_avx2;
+#elif defined(__GNUC__)
+  // Built without -mavx2: pick the kernel once at runtime
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return dot_avx2;
+  }
+  return dot_sse;
+#else
+  return dot_sse;
+#endif
+}
+
+static float dot(const float *a, const float *b, int n) {
+  static const DotFn fn = select_dot();
+  return fn(a, b, n);
+}
+
+#elif defined(RESAMPLER_NEON)
+
+static float dot(const float *a, const float *b, int n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  for (int i = 0; i < n; i += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  float32x4_t acc = vaddq_f32(acc0, acc1);
+  float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+
+#else
+
+static float dot(const float *a, const float *b, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+#endif
+
+PolyphaseResampler::PolyphaseResampler(int in_rate, int out_rate, int taps) {
+  const int g = std::gcd(in_rate, out_rate);
+  up_ = out_rate / g;
+  down_ = in_rate / g;
+  // When decimating, the filter must span proportionally more input
+  // samples to keep the same transition band at the output rate
+  const int span = std::max(taps, kTapAlign) * std::max(1, (in_rate + out_rate - 1) / out_rate);
+  taps_ = (span + kTapAlign - 1) / kTapAlign * kTapAlign;
+
+  // Prototype low-pass at the upsampled rate in_rate * up_, cut below the
+  // lower of the two Nyquist frequencies. Gain up_ makes up for the zeros
+  // the upsampling inserts.
+  const int length = taps_ * up_;
+  const double cutoff = kPassBand * 0.5 * std::min(in_rate, out_rate) /
+                        (static_cast<double>(in_rate) * up_);
+  const double center = (length - 1) / 2.0;
+  const double window_norm = bessel_i0(kKaiserBeta);
+  std::vector<double> prototype(length);
+  double sum = 0.0;
+  for (int k = 0; k < length; k++) {
+    const double t = k - center;
+    const double x = 2.0 * M_PI * cutoff * t;
+    const double sinc = t == 0.0 ? 1.0 : std::sin(x) / x;
+    const double r = t / (center + 1.0);
+    const double window = bessel_i0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) /
+                          window_norm;
+    prototype[k] = 2.0 * cutoff * sinc * window;
+    sum += prototype[k];
+  }
+
+  // Phase p uses prototype[j * up_ + p] against input n - j
+  coefficients_.resize(static_cast<size_t>(length));
+  for (int p = 0; p < up_; p++) {
+    for (int j = 0; j < taps_; j++) {
+      coefficients_[static_cast<size_t>(p) * taps_ + (taps_ - 1 - j)] =
+          static_cast<float>(prototype[static_cast<size_t>(j) * up_ + p] * up_ / sum);
+    }
+  }
+  reset();
+}
+
+void PolyphaseResampler::reset() {
+  history_.assign(taps_ - 1, 0.0f);
+  next_ = taps_ - 1;
+  phase_ = 0;
+}
+
+void PolyphaseResampler::process(const float *in, size_t count, std::vector<float> &out) {
+  history_.insert(history_.end(), in, in + count);
+
+  // Output m sits at input position m * down_ / up_: the newest input it
+  // sees is next_, and phase_ is the remainder in units of 1 / up_
+  const size_t end = history_.size();
+  if (next_ < end) {
+    out.reserve(out.size() + (end - next_) * up_ / down_ + 1);
+  }
+  while (next_ < end) {
+    const float *taps = &coefficients_[static_cast<size_t>(phase_) * taps_];
+    out.push_back(dot(&history_[next_ + 1 - taps_], taps, taps_));
+    phase_ += down_;
+    next_ += phase_ / up_;
+    phase_ %= up_;
+  }
+
+  // Keep the last taps_ - 1 inputs for the next block
+  const size_t keep = static_cast<size_t>(taps_ - 1);
+  const size_t drop = end - keep;
+  history_.erase(history_.begin(), history_.begin() + drop);
+  next_ -= drop;
+}
+
+PcmConverter::PcmConverter(const AudioFormat &input, int output_rate) : input_(input) {
+  input_.channels = std::max(1, input_.channels);
+  if (input_.sample_rate > 0 && input_.sample_rate != output_rate) {
+    resampler_.reset(new PolyphaseResampler(input_.sample_rate, output_rate));
+  }
+}
+
+const std::vector<float> &PcmConverter::convert(const char *data, size_t bytes,
+                                                SampleFormat format) {
+  const size_t frames = bytes / (sample_format_bytes(format) * input_.channels);
+  mono_.resize(frames);
+  downmix_to_float(data, frames, input_.channels, format, mono_.data());
+  if (!resampler_) {
+    return mono_;
+  }
+  output_.clear();
+  resampler_->process(mono_.data(), frames, output_);
+  return output_;
+}
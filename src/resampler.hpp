@@ -0,0 +1,87 @@
+#ifndef RESAMPLER_HPP
+#define RESAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class SampleFormat {
+  Int16,   // little-endian 16-bit PCM
+  Int24,   // packed little-endian 24-bit PCM, 3 bytes per sample
+  Float32, // little-endian IEEE float in [-1, 1]
+};
+
+// Accepts int16, int24 and float32 (or f32)
+bool parse_sample_format(const std::string &name, SampleFormat &format);
+size_t sample_format_bytes(SampleFormat format);
+
+// What the sender puts on the wire
+struct AudioFormat {
+  int sample_rate = 16000;
+  int channels = 1;
+  SampleFormat format = SampleFormat::Int16;
+
+  size_t frameBytes() const { return channels * sample_format_bytes(format); }
+};
+
+// Decode `frames` interleaved frames and average the channels into mono
+void downmix_to_float(const char *data, size_t frames, int channels,
+                      SampleFormat format, float *out);
+
+// Streaming rational resampler: a Kaiser-windowed sinc low-pass split into
+// `up` phases of `taps` coefficients each, so every output sample costs one
+// `taps`-long dot product (vectorized) whatever the ratio. 48 kHz -> 16 kHz
+// is up 1 / down 3; 44.1 kHz -> 16 kHz is up 160 / down 441.
+class PolyphaseResampler {
+public:
+  // `taps` is per phase when upsampling and scales with the ratio when
+  // decimating (48 kHz -> 16 kHz uses 3 * taps)
+  PolyphaseResampler(int in_rate, int out_rate, int taps = 64);
+
+  // Append the output for `count` more input samples to `out`
+  void process(const float *in, size_t count, std::vector<float> &out);
+  void reset();
+
+  int up() const { return up_; }
+  int down() const { return down_; }
+  int taps() const { return taps_; }
+
+private:
+  int up_;
+  int down_;
+  int taps_;
+  // coefficients_[p * taps_ + j] is tap j of phase p, reversed so each
+  // output is a forward dot product over the input history
+  std::vector<float> coefficients_;
+  // Last taps_ - 1 inputs followed by the new block
+  std::vector<float> history_;
+  size_t next_ = 0; // history_ index of the next output's newest input
+  int phase_ = 0;
+};
+
+// Turns packets of any declared format into mono float at `output_rate`.
+// One instance per stream; not thread-safe.
+class PcmConverter {
+public:
+  PcmConverter(const AudioFormat &input, int output_rate);
+
+  // The input already is mono int16 at the output rate
+  bool passthrough() const {
+    return input_.channels == 1 && input_.format == SampleFormat::Int16 && !resampler_;
+  }
+  const AudioFormat &input() const { return input_; }
+
+  // Convert the whole frames in `bytes`, read as `format` (framed packets
+  // are always int16); the result stays valid until the next call
+  const std::vector<float> &convert(const char *data, size_t bytes, SampleFormat format);
+
+private:
+  AudioFormat input_;
+  std::unique_ptr<PolyphaseResampler> resampler_;
+  std::vector<float> mono_;
+  std::vector<float> output_;
+};
+
+#endif // RESAMPLER_HPP
@@ -0,0 +1,159 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity single-producer/single-consumer ring buffer.
+//
+// The producer only ever stores head_ and the consumer only ever stores
+// tail_, so neither side takes a lock. The indices live on separate cache
+// lines to avoid false sharing between the receive thread and the consumer.
+// Capacity is rounded up to a power of two so wrapping is a mask.
+template <typename T> class SpscRingBuffer {
+public:
+  static constexpr size_t kCacheLine = 64;
+
+  explicit SpscRingBuffer(size_t min_capacity) {
+    size_t capacity = 1;
+    while (capacity < min_capacity) {
+      capacity <<= 1;
+    }
+    buffer_.resize(capacity);
+    mask_ = capacity - 1;
+  }
+
+  SpscRingBuffer(const SpscRingBuffer &) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+  size_t capacity() const { return buffer_.size(); }
+
+  // Number of readable elements. A lower bound on the consumer thread,
+  // where more may arrive, and an upper bound on the producer thread, where
+  // more may be taken. Any other thread, such as a metrics reporter, gets a
+  // snapshot no larger than capacity(); tail_ is loaded first because it
+  // never passes head_.
+  size_t size() const {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t head = head_.load(std::memory_order_acquire);
+    return std::min(head - tail, capacity());
+  }
+
+  // Producer: reserve up to n slots and let fill(dst, src_offset, count)
+  // write them in at most two contiguous chunks. Returns the number of
+  // elements committed, which is less than n when the buffer is full.
+  template <typename Fill> size_t produce(size_t n, Fill fill) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    size_t free_slots = capacity() - (head - cached_tail_);
+    if (free_slots < n) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      free_slots = capacity() - (head - cached_tail_);
+    }
+    n = std::min(n, free_slots);
+    if (n == 0) {
+      return 0;
+    }
+
+    const size_t start = head & mask_;
+    const size_t first = std::min(n, capacity() - start);
+    fill(buffer_.data() + start, size_t{0}, first);
+    if (first < n) {
+      fill(buffer_.data(), first, n - first);
+    }
+
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  size_t write(const T *data, size_t n) {
+    return produce(n, [data](T *dst, size_t offset, size_t count) {
+      std::copy(data + offset, data + offset + count, dst);
+    });
+  }
+
+  // Consumer view of the oldest readable elements, split where the ring
+  // wraps. The slots stay owned by the consumer until release().
+  struct ReadView {
+    const T *first = nullptr;
+    size_t first_size = 0;
+    const T *second = nullptr;
+    size_t second_size = 0;
+
+    size_t size() const { return first_size + second_size; }
+  };
+
+  ReadView peek(size_t n) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t available = cached_head_ - tail;
+    if (available < n) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      available = cached_head_ - tail;
+    }
+    n = std::min(n, available);
+
+    ReadView view;
+    const size_t start = tail & mask_;
+    view.first = buffer_.data() + start;
+    view.first_size = std::min(n, capacity() - start);
+    if (view.first_size < n) {
+      view.second = buffer_.data();
+      view.second_size = n - view.first_size;
+    }
+    return view;
+  }
+
+  // Consumer: hand n previously peeked elements back to the producer.
+  void release(size_t n) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + n,
+                std::memory_order_release);
+  }
+
+  // Consumer: replace n previously peeked elements with the `count`
+  // elements at `data` (count <= n), keeping their place in front of
+  // everything newer. The slots are consumer-owned, so the producer never
+  // sees the rewrite.
+  void replaceOldest(size_t n, const T *data, size_t count) {
+    const size_t start = tail_.load(std::memory_order_relaxed) + (n - count);
+    const size_t offset = start & mask_;
+    const size_t first = std::min(count, capacity() - offset);
+    std::copy(data, data + first, buffer_.data() + offset);
+    std::copy(data + first, data + count, buffer_.data());
+    release(n - count);
+  }
+
+  // Consumer: hand up to n readable elements to drain(src, dst_offset, count)
+  // in at most two contiguous chunks, then release them.
+  template <typename Drain> size_t consume(size_t n, Drain drain) {
+    ReadView view = peek(n);
+    if (view.first_size > 0) {
+      drain(view.first, size_t{0}, view.first_size);
+    }
+    if (view.second_size > 0) {
+      drain(view.second, view.first_size, view.second_size);
+    }
+    release(view.size());
+    return view.size();
+  }
+
+  size_t read(T *out, size_t n) {
+    return consume(n, [out](const T *src, size_t offset, size_t count) {
+      std::copy(src, src + count, out + offset);
+    });
+  }
+
+private:
+  // Producer-owned line: write index plus its cached view of the reader.
+  alignas(kCacheLine) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;
+
+  // Consumer-owned line: read index plus its cached view of the writer.
+  alignas(kCacheLine) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;
+
+  alignas(kCacheLine) std::vector<T> buffer_;
+  size_t mask_ = 0;
+};
+
+#endif // RING_BUFFER_HPP
@@ -0,0 +1,96 @@
+#include "sample_convert.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define SAMPLE_CONVERT_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define SAMPLE_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// 1/32768 is a power of two, so multiplying is exact and matches division.
+static constexpr float kInt16Scale = 1.0f / 32768.0f;
+
+void convert_int16_to_float_scalar(const int16_t *in, float *out,
+                                   size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = in[i] * kInt16Scale;
+  }
+}
+
+#if defined(SAMPLE_CONVERT_X86)
+
+static void convert_sse2(const int16_t *in, float *out, size_t count) {
+  const __m128 scale = _mm_set1_ps(kInt16Scale);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    // Sign-extend by interleaving into the high half and shifting back.
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  convert_int16_to_float_scalar(in + i, out + i, count - i);
+}
+
+#if defined(__GNUC__) || defined(__AVX2__)
+#if defined(__GNUC__)
+#define SAMPLE_CONVERT_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define SAMPLE_CONVERT_AVX2_TARGET
+#endif
+
+SAMPLE_CONVERT_AVX2_TARGET static void
+convert_avx2(const int16_t *in, float *out, size_t count) {
+  const __m256 scale = _mm256_set1_ps(kInt16Scale);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+    __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+    __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(fa, scale));
+    _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(fb, scale));
+  }
+  convert_sse2(in + i, out + i, count - i);
+}
+#endif
+
+void convert_int16_to_float(const int16_t *in, float *out, size_t count) {
+#if defined(__AVX2__)
+  convert_avx2(in, out, count);
+#elif defined(__GNUC__)
+  // Built without -mavx2: pick the kernel once at runtime.
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    convert_avx2(in, out, count);
+  } else {
+    convert_sse2(in, out, count);
+  }
+#else
+  convert_sse2(in, out, count);
+#endif
+}
+
+#elif defined(SAMPLE_CONVERT_NEON)
+
+void convert_int16_to_float(const int16_t *in, float *out, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t v = vld1q_s16(in + i);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    vst1q_f32(out + i, vmulq_n_f32(lo, kInt16Scale));
+    vst1q_f32(out + i + 4, vmulq_n_f32(hi, kInt16Scale));
+  }
+  convert_int16_to_float_scalar(in + i, out + i, count - i);
+}
+
+#else
+
+void convert_int16_to_float(const int16_t *in, float *out, size_t count) {
+  convert_int16_to_float_scalar(in, out, count);
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SAMPLE_CONVERT_HPP
+#define SAMPLE_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Convert int16 PCM to float in [-1, 1). Uses AVX2, SSE2 or NEON when
+// available; the result is bit-identical to the scalar `x / 32768.0f`.
+void convert_int16_to_float(const int16_t *in, float *out, size_t count);
+
+// Portable reference implementation, exposed for benchmarks.
+void convert_int16_to_float_scalar(const int16_t *in, float *out,
+                                   size_t count);
+
+#endif // SAMPLE_CONVERT_HPP
@@ -0,0 +1,362 @@
+#include "session_archive.hpp"
+#include "sample_convert.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char kFileMagic[4] = {'W', 'S', 'A', 'R'};
+static const char kRecordMagic[4] = {'W', 'R', 'E', 'C'};
+static constexpr uint16_t kArchiveVersion = 1;
+static constexpr size_t kFileHeaderSize = 32;
+static constexpr size_t kRecordHeaderSize = 32;
+static constexpr size_t kIndexEntrySize = 24;
+
+template <typename T> static T load_le(const char *p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+template <typename T> static void store_le(char *p, T value) {
+  std::memcpy(p, &value, sizeof(T));
+}
+
+uint32_t archive_crc32(const uint8_t *data, size_t size) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+// Speech changes slowly between samples, so deltas are mostly small and
+// take one or two bytes instead of two
+static void encode_delta(const int16_t *samples, size_t count,
+                         std::vector<uint8_t> &out) {
+  out.clear();
+  out.reserve(count * 2);
+  int32_t prev = 0;
+  for (size_t i = 0; i < count; i++) {
+    int32_t delta = samples[i] - prev;
+    prev = samples[i];
+    uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+    while (zigzag >= 0x80) {
+      out.push_back(static_cast<uint8_t>(zigzag | 0x80));
+      zigzag >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(zigzag));
+  }
+}
+
+static bool decode_delta(const uint8_t *data, size_t size, size_t count,
+                         std::vector<int16_t> &out) {
+  out.resize(count);
+  size_t pos = 0;
+  int32_t prev = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t zigzag = 0;
+    for (int shift = 0;; shift += 7) {
+      if (pos >= size || shift > 28) {
+        return false;
+      }
+      uint8_t byte = data[pos++];
+      zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+    prev += delta;
+    out[i] = static_cast<int16_t>(prev);
+  }
+  return pos == size;
+}
+
+bool parse_archive_codec(const std::string &name, ArchiveCodec &codec) {
+  if (name == "int16") {
+    codec = ArchiveCodec::Int16;
+  } else if (name == "delta") {
+    codec = ArchiveCodec::Delta;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+SessionArchive::SessionArchive(const ArchiveOptions &options)
+    : options_(options) {}
+
+SessionArchive::~SessionArchive() { close(); }
+
+void SessionArchive::close() {
+  if (file_.is_open()) {
+    file_.close();
+    index_.close();
+  }
+}
+
+bool SessionArchive::ensureOpen(ArchiveRecordType type, int64_t start_sample) {
+  const int64_t rotate_samples =
+      static_cast<int64_t>(options_.rotate_seconds * options_.sample_rate);
+  // With audio archived, only audio rotates, so a transcript lands in the
+  // same file as the audio it was recognized from
+  const bool may_rotate = type == ArchiveRecordType::Audio || stats_.audio_records == 0;
+  if (file_.is_open() &&
+      (!may_rotate ||
+       (file_bytes_ < options_.rotate_bytes &&
+        (rotate_samples <= 0 || file_end_sample_ - file_first_sample_ < rotate_samples)))) {
+    return true;
+  }
+  close();
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "_%03u", stats_.files);
+  const std::string base = options_.directory + "/" + options_.prefix + name;
+  path_ = base + ".wsa";
+
+  file_.open(path_, std::ios::binary | std::ios::trunc);
+  index_.open(base + ".idx", std::ios::binary | std::ios::trunc);
+  if (!file_.is_open() || !index_.is_open()) {
+    std::cerr << "Failed to open archive file: " << path_ << std::endl;
+    close();
+    return false;
+  }
+
+  char header[kFileHeaderSize] = {0};
+  std::memcpy(header, kFileMagic, sizeof(kFileMagic));
+  store_le<uint16_t>(header + 4, kArchiveVersion);
+  store_le<uint16_t>(header + 6, kFileHeaderSize);
+  store_le<uint32_t>(header + 8, static_cast<uint32_t>(options_.sample_rate));
+  header[12] = static_cast<char>(options_.codec);
+  store_le<uint64_t>(header + 16, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::system_clock::now().time_since_epoch())
+                                      .count());
+  store_le<int64_t>(header + 24, start_sample);
+  file_.write(header, sizeof(header));
+
+  file_bytes_ = kFileHeaderSize;
+  file_first_sample_ = start_sample;
+  file_end_sample_ = start_sample;
+  stats_.files++;
+  stats_.bytes_written += kFileHeaderSize;
+  std::cout << "Archiving to " << path_ << std::endl;
+  return true;
+}
+
+bool SessionArchive::writeRecord(ArchiveRecordType type, ArchiveCodec codec,
+                                 int index, int64_t start_sample,
+                                 uint32_t sample_count, const uint8_t *payload,
+                                 size_t size) {
+  if (!ensureOpen(type, start_sample)) {
+    return false;
+  }
+
+  char header[kRecordHeaderSize] = {0};
+  std::memcpy(header, kRecordMagic, sizeof(kRecordMagic));
+  header[4] = static_cast<char>(type);
+  header[5] = static_cast<char>(codec);
+  store_le<int32_t>(header + 8, index);
+  store_le<uint32_t>(header + 12, sample_count);
+  store_le<int64_t>(header + 16, start_sample);
+  store_le<uint32_t>(header + 24, static_cast<uint32_t>(size));
+  store_le<uint32_t>(header + 28, archive_crc32(payload, size));
+
+  char entry[kIndexEntrySize] = {0};
+  store_le<uint64_t>(entry, file_bytes_);
+  store_le<int64_t>(entry + 8, start_sample);
+  store_le<int32_t>(entry + 16, index);
+  entry[20] = static_cast<char>(type);
+
+  file_.write(header, sizeof(header));
+  file_.write(reinterpret_cast<const char *>(payload), size);
+  // The record goes out before its index entry, so the index never points
+  // past the data
+  file_.flush();
+  index_.write(entry, sizeof(entry));
+  index_.flush();
+  if (!file_.good() || !index_.good()) {
+    std::cerr << "Failed to write archive record to " << path_ << std::endl;
+    return false;
+  }
+
+  file_bytes_ += kRecordHeaderSize + size;
+  file_end_sample_ = std::max(file_end_sample_, start_sample + static_cast<int64_t>(sample_count));
+  stats_.bytes_written += kRecordHeaderSize + size + kIndexEntrySize;
+  return true;
+}
+
+bool SessionArchive::appendAudio(int index, int64_t start_sample,
+                                 const float *samples, size_t count) {
+  pcm_.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    float scaled = std::nearbyint(samples[i] * 32768.0f);
+    pcm_[i] = static_cast<int16_t>(std::clamp(scaled, -32768.0f, 32767.0f));
+  }
+
+  ArchiveCodec codec = ArchiveCodec::Int16;
+  const uint8_t *payload = reinterpret_cast<const uint8_t *>(pcm_.data());
+  size_t size = count * sizeof(int16_t);
+  if (options_.codec == ArchiveCodec::Delta) {
+    encode_delta(pcm_.data(), count, encoded_);
+    // Noise-like audio does not compress; keep whichever is smaller
+    if (encoded_.size() < size) {
+      codec = ArchiveCodec::Delta;
+      payload = encoded_.data();
+      size = encoded_.size();
+    }
+  }
+
+  if (!writeRecord(ArchiveRecordType::Audio, codec, index, start_sample,
+                   static_cast<uint32_t>(count), payload, size)) {
+    return false;
+  }
+  stats_.audio_records++;
+  stats_.samples += count;
+  stats_.audio_bytes += size;
+  return true;
+}
+
+bool SessionArchive::appendText(int index, int64_t start_sample,
+                                int64_t end_sample, const std::string &text) {
+  uint32_t sample_count = static_cast<uint32_t>(std::max<int64_t>(end_sample - start_sample, 0));
+  if (!writeRecord(ArchiveRecordType::Text, ArchiveCodec::Int16, index,
+                   start_sample, sample_count,
+                   reinterpret_cast<const uint8_t *>(text.data()), text.size())) {
+    return false;
+  }
+  stats_.text_records++;
+  return true;
+}
+
+bool ArchiveReader::open(const std::string &path) {
+  file_.open(path, std::ios::binary);
+  char header[kFileHeaderSize];
+  if (!file_.read(header, sizeof(header)) ||
+      std::memcmp(header, kFileMagic, sizeof(kFileMagic)) != 0) {
+    std::cerr << "Not an audio archive: " << path << std::endl;
+    return false;
+  }
+  sample_rate_ = static_cast<int>(load_le<uint32_t>(header + 8));
+
+  entries_.clear();
+  std::string index_path = path;
+  if (index_path.size() > 4 && index_path.compare(index_path.size() - 4, 4, ".wsa") == 0) {
+    index_path.replace(index_path.size() - 4, 4, ".idx");
+    std::ifstream index(index_path, std::ios::binary);
+    char entry[kIndexEntrySize];
+    while (index.read(entry, sizeof(entry))) {
+      ArchiveIndexEntry e;
+      e.offset = load_le<uint64_t>(entry);
+      e.start_sample = load_le<int64_t>(entry + 8);
+      e.index = load_le<int32_t>(entry + 16);
+      e.type = static_cast<ArchiveRecordType>(entry[20]);
+      entries_.push_back(e);
+    }
+  }
+  // Without an index, rebuild it from the record headers
+  return !entries_.empty() || scanRecords();
+}
+
+bool ArchiveReader::scanRecords() {
+  file_.clear();
+  uint64_t offset = kFileHeaderSize;
+  char header[kRecordHeaderSize];
+  while (file_.seekg(offset) && file_.read(header, sizeof(header)) &&
+         std::memcmp(header, kRecordMagic, sizeof(kRecordMagic)) == 0) {
+    ArchiveIndexEntry e;
+    e.offset = offset;
+    e.type = static_cast<ArchiveRecordType>(header[4]);
+    e.index = load_le<int32_t>(header + 8);
+    e.start_sample = load_le<int64_t>(header + 16);
+    entries_.push_back(e);
+    offset += kRecordHeaderSize + load_le<uint32_t>(header + 24);
+  }
+  file_.clear();
+  return true;
+}
+
+const ArchiveIndexEntry *ArchiveReader::seek(int64_t sample,
+                                             ArchiveRecordType type) const {
+  // Transcripts may be written after later audio, so entries are only
+  // ordered per type; an hour is a few thousand entries at most
+  const ArchiveIndexEntry *best = nullptr;
+  for (const auto &entry : entries_) {
+    if (entry.type == type && entry.start_sample >= sample &&
+        (best == nullptr || entry.start_sample < best->start_sample)) {
+      best = &entry;
+    }
+  }
+  return best;
+}
+
+bool ArchiveReader::readPayload(const ArchiveIndexEntry &entry,
+                                ArchiveRecordType type, uint8_t &codec,
+                                uint32_t &sample_count) {
+  char header[kRecordHeaderSize];
+  file_.clear();
+  if (!file_.seekg(entry.offset) || !file_.read(header, sizeof(header)) ||
+      std::memcmp(header, kRecordMagic, sizeof(kRecordMagic)) != 0 ||
+      static_cast<ArchiveRecordType>(header[4]) != type) {
+    return false;
+  }
+  codec = static_cast<uint8_t>(header[5]);
+  sample_count = load_le<uint32_t>(header + 12);
+
+  payload_.resize(load_le<uint32_t>(header + 24));
+  if (!file_.read(reinterpret_cast<char *>(payload_.data()), payload_.size())) {
+    return false; // torn tail
+  }
+  return archive_crc32(payload_.data(), payload_.size()) == load_le<uint32_t>(header + 28);
+}
+
+bool ArchiveReader::readAudio(const ArchiveIndexEntry &entry,
+                              std::vector<float> &samples) {
+  uint8_t codec = 0;
+  uint32_t count = 0;
+  if (!readPayload(entry, ArchiveRecordType::Audio, codec, count)) {
+    return false;
+  }
+
+  std::vector<int16_t> pcm;
+  if (codec == static_cast<uint8_t>(ArchiveCodec::Delta)) {
+    if (!decode_delta(payload_.data(), payload_.size(), count, pcm)) {
+      return false;
+    }
+  } else {
+    if (payload_.size() != count * sizeof(int16_t)) {
+      return false;
+    }
+    pcm.resize(count);
+    std::memcpy(pcm.data(), payload_.data(), payload_.size());
+  }
+
+  samples.resize(count);
+  convert_int16_to_float(pcm.data(), samples.data(), count);
+  return true;
+}
+
+bool ArchiveReader::readText(const ArchiveIndexEntry &entry, std::string &text) {
+  uint8_t codec = 0;
+  uint32_t count = 0;
+  if (!readPayload(entry, ArchiveRecordType::Text, codec, count)) {
+    return false;
+  }
+  text.assign(payload_.begin(), payload_.end());
+  return true;
+}
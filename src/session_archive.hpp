@@ -0,0 +1,130 @@
+#ifndef SESSION_ARCHIVE_HPP
+#define SESSION_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// On-disk layout (little-endian), one container per rotation:
+//
+//   <prefix>_NNN.wsa   32-byte file header, then records back to back; each
+//                      record is a 32-byte header plus its payload
+//   <prefix>_NNN.idx   one 24-byte entry per record: file offset, start
+//                      sample, segment index and type, in write order
+//
+// Both files are append-only, so a crash loses at most the record being
+// written; a torn tail fails its CRC and is ignored by the reader.
+
+enum class ArchiveCodec : uint8_t {
+  Int16 = 0, // raw 16-bit PCM, the wire format
+  Delta = 1, // lossless: int16 deltas, zigzag + varint
+};
+
+bool parse_archive_codec(const std::string &name, ArchiveCodec &codec);
+
+// CRC-32 (IEEE) of record payloads; also used by the packet capture
+uint32_t archive_crc32(const uint8_t *data, size_t size);
+
+enum class ArchiveRecordType : uint8_t {
+  Audio = 1,
+  Text = 2,
+};
+
+struct ArchiveIndexEntry {
+  uint64_t offset = 0;
+  int64_t start_sample = 0;
+  int32_t index = 0;
+  ArchiveRecordType type = ArchiveRecordType::Audio;
+};
+
+struct ArchiveOptions {
+  std::string directory = ".";
+  std::string prefix = "session";
+  int sample_rate = 16000;
+  ArchiveCodec codec = ArchiveCodec::Delta;
+  // Rotate once a file covers this much audio or grows this large
+  double rotate_seconds = 3600.0;
+  size_t rotate_bytes = 256u << 20;
+};
+
+struct ArchiveStats {
+  uint64_t audio_records = 0;
+  uint64_t text_records = 0;
+  uint64_t samples = 0;
+  uint64_t audio_bytes = 0; // encoded audio payload
+  uint64_t bytes_written = 0;
+  uint32_t files = 0;
+
+  // Against the 32-bit float WAV files this replaces
+  double compressionRatio() const {
+    return audio_bytes > 0 ? samples * 4.0 / audio_bytes : 0.0;
+  }
+};
+
+// Append-only writer for one session. Not thread-safe; it is meant to be
+// driven by the archive pipeline stage, off the recognition thread.
+class SessionArchive {
+public:
+  explicit SessionArchive(const ArchiveOptions &options);
+  ~SessionArchive();
+
+  SessionArchive(const SessionArchive &) = delete;
+  SessionArchive &operator=(const SessionArchive &) = delete;
+
+  // start_sample is the position of the first sample in the session
+  bool appendAudio(int index, int64_t start_sample, const float *samples,
+                   size_t count);
+  // The text covers [start_sample, end_sample) of the session's audio
+  bool appendText(int index, int64_t start_sample, int64_t end_sample,
+                  const std::string &text);
+  void close();
+
+  const std::string &currentPath() const { return path_; }
+  const ArchiveStats &stats() const { return stats_; }
+
+private:
+  bool ensureOpen(ArchiveRecordType type, int64_t start_sample);
+  bool writeRecord(ArchiveRecordType type, ArchiveCodec codec, int index,
+                   int64_t start_sample, uint32_t sample_count,
+                   const uint8_t *payload, size_t size);
+
+  ArchiveOptions options_;
+  std::ofstream file_;
+  std::ofstream index_;
+  std::string path_;
+  uint64_t file_bytes_ = 0;
+  int64_t file_first_sample_ = 0;
+  int64_t file_end_sample_ = 0;
+
+  std::vector<int16_t> pcm_;
+  std::vector<uint8_t> encoded_;
+  ArchiveStats stats_;
+};
+
+// Random access to a finished (or still growing) container
+class ArchiveReader {
+public:
+  bool open(const std::string &path);
+
+  int sampleRate() const { return sample_rate_; }
+  const std::vector<ArchiveIndexEntry> &entries() const { return entries_; }
+
+  // First record of `type` whose audio starts at or after `sample`
+  const ArchiveIndexEntry *seek(int64_t sample, ArchiveRecordType type) const;
+  bool readAudio(const ArchiveIndexEntry &entry, std::vector<float> &samples);
+  bool readText(const ArchiveIndexEntry &entry, std::string &text);
+
+private:
+  bool readPayload(const ArchiveIndexEntry &entry, ArchiveRecordType type,
+                   uint8_t &codec, uint32_t &sample_count);
+  bool scanRecords();
+
+  std::ifstream file_;
+  int sample_rate_ = 0;
+  std::vector<ArchiveIndexEntry> entries_;
+  std::vector<uint8_t> payload_;
+};
+
+#endif // SESSION_ARCHIVE_HPP
@@ -1,66 +1,168 @@
 // Real-time speech recognition using ESP32 WiFi Microphone
+#include "adaptive_decoder.hpp"
 #include "audio_manager.hpp"
+#include "compute_governor.hpp"
+#include "inference_scheduler.hpp"
+#include "metrics.hpp"
+#include "model_loader.hpp"
+#include "overload_guard.hpp"
+#include "packet_capture.hpp"
 #include "params.cpp"
+#include "partial_results.hpp"
+#include "prompt_ring.hpp"
+#include "pipeline.hpp"
+#include "session_archive.hpp"
+#include "stream_server.hpp"
+#include "streaming_decoder.hpp"
+#include "subtitle_publisher.hpp"
+#include "text_filter.hpp"
 #include "translator.hpp"
+#include "vad.hpp"
 #include "whisper.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <csignal>
 #include <cstdio>
 #include <ctime>
+#include <cstdlib>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <pthread.h>
 #include <regex>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
-static std::string removeParens(const std::string &input) {
-  std::string result;
-  std::string current_token;
-  bool discardRound = false;
-  bool discardSquare = false;
-
-  for (char ch : input) {
-    if (ch == '(') {
-      discardRound = true;
-    } else if (ch == ')') {
-      discardRound = false;
-    } else if (ch == '[') {
-      discardSquare = true;
-    } else if (ch == ']') {
-      discardSquare = false;
-    } else if (!discardRound && !discardSquare) {
-      if (ch == ' ') {
-        if (!current_token.empty()) {
-          result += current_token + " ";
-          current_token.clear();
-        }
-      } else {
-        current_token += ch;
-      }
-    }
-  }
+// Recognized text on its way from inference to post-processing
+struct TextEvent {
+  int index;
+  std::string text;
+  bool final; // false for tentative streaming output
+  // Session audio the text was recognized from, in samples
+  int64_t start_sample = 0;
+  int64_t end_sample = 0;
+  // When recognition produced it; a coalesced event keeps the oldest
+  LatencyHistogram::Clock::time_point created = LatencyHistogram::Clock::now();
+};
+
+// Work for the disk sink: a transcript, an audio segment, or both
+struct ArchiveItem {
+  int index;
+  std::string text;
+  std::vector<float> audio;
+  int64_t start_sample = 0;
+  int64_t end_sample = 0;
+};
 
-  if (!current_token.empty()) {
-    result += current_token;
+std::atomic<AudioManager *> g_audioManager{nullptr};
+std::atomic<StreamServer *> g_streamServer{nullptr};
+std::atomic<ModelSwapper *> g_modelSwapper{nullptr};
+
+// Ctrl-Z and Ctrl-C are blocked in every thread and taken here instead, so
+// shutdown runs outside signal context: stopping the audio source lets the
+// main loop finish, drain the pipeline and print its statistics. A second
+// signal exits immediately.
+static void watch_stop_signals(sigset_t signals) {
+  int sig = 0;
+  sigwait(&signals, &sig);
+  if (StreamServer *server = g_streamServer.load()) {
+    server->stop();
+  }
+  if (AudioManager *audio = g_audioManager.load()) {
+    audio->stop();
   }
+  sigwait(&signals, &sig);
+  std::_Exit(1);
+}
 
-  return result;
+// Runtime commands, one per line on stdin:
+//   model PATH   load PATH in the background and swap it in
+static void watch_commands() {
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream command(line);
+    std::string verb, path;
+    command >> verb >> path;
+    ModelSwapper *swapper = g_modelSwapper.load();
+    if (verb == "model" && !path.empty() && swapper != nullptr) {
+      std::cout << "Loading model " << path << " alongside " << swapper->path()
+                << std::endl;
+      swapper->load(path);
+    } else if (!verb.empty()) {
+      std::cerr << "Unknown command: " << line << " (try: model PATH)" << std::endl;
+    }
+  }
 }
 
-AudioManager *g_audioManager = nullptr;
+// Serve many ESP32 streams from one shared model until interrupted
+static int run_server(const Params &params, InferenceScheduler &scheduler,
+                      const whisper_full_params &wparams,
+                      const IngestOptions &ingest, MetricsExporter &metrics) {
+  StreamServerOptions options;
+  options.port = params.listen_port;
+  options.segment_duration_s = params.segment_duration_s;
+  options.buffer_duration_s = params.stream_buffer_s;
+  options.latency_ms = params.latency_ms;
+  options.prompt_tokens = params.prompt_tokens;
+  options.ingest = ingest;
 
-[[noreturn]] static void handle_sigstp([[maybe_unused]] int signal) {
-  if (g_audioManager != nullptr) {
-    g_audioManager->cleanup();
+  StreamServer server(scheduler, wparams, options);
+  server.setTextCallback([](const StreamReport &stream, int segment,
+                            const std::string &text) {
+    std::ostringstream line;
+    line << "\n=== Stream " << stream.id << " (" << stream.peer
+         << ") segment " << segment << " ===\n"
+         << removeParens(text) << "\n";
+    std::cout << line.str() << std::flush;
+  });
+
+  g_streamServer = &server;
+  if (!server.start()) {
+    g_streamServer = nullptr;
+    return 1;
+  }
+  metrics.addGauge("streams", "Active ESP32 streams",
+                   [&server] { return static_cast<double>(server.report().size()); });
+  metrics.start();
+
+  int ticks = 0;
+  while (server.running()) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (++ticks % 30 != 0) {
+      continue;
+    }
+
+    size_t total_bytes = 0;
+    auto reports = server.report();
+    for (const auto &stream : reports) {
+      total_bytes += stream.memory_bytes;
+      std::cout << "Stream " << stream.id << " (" << stream.peer << "): "
+                << stream.packets << " packets, " << stream.segments
+                << " segments, " << stream.buffered_samples / 16000
+                << " s buffered, " << stream.overrun_samples
+                << " overrun samples, " << stream.jitter.lost_packets
+                << " lost, " << stream.memory_bytes / 1024 << " KB"
+                << std::endl;
+    }
+    std::cout << reports.size() << " streams using "
+              << total_bytes / 1024 << " KB of stream buffers" << std::endl;
+    std::cout << scheduler.describe() << std::endl;
   }
-  exit(0);
+
+  // The gauges above sample `server`
+  metrics.stop();
+  g_streamServer = nullptr;
+  return 0;
 }
 
 int main(int argc, char **argv) {
@@ -73,25 +175,28 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  // Add ESP32 IP parameter
-  std::string esp32_ip = "192.168.4.1"; // Default IP
-  for (int i = 1; i < argc - 1; i++) {
-    if (std::string(argv[i]) == "--esp32-ip" && i + 1 < argc) {
-      esp32_ip = argv[i + 1];
-      break;
-    }
-  }
+  // Block the stop signals before any thread starts, so they all inherit
+  // the mask and only the watcher receives them
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGTSTP);
+  sigaddset(&stop_signals, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+  std::thread(watch_stop_signals, stop_signals).detach();
 
   struct whisper_context_params cparams = whisper_context_default_params();
   cparams.use_gpu = params.use_gpu;
   cparams.flash_attn = params.flash_attn;
 
-  struct whisper_context *ctx =
-      whisper_init_from_file_with_params(params.model.c_str(), cparams);
+  // The model loads while capture starts below. The scheduler allocates
+  // one whisper_state per decode worker, so the context's default state
+  // would go unused.
+  std::future<whisper_context *> model_loading = std::async(
+      std::launch::async, [&] { return load_model_mapped(params.model, cparams); });
   whisper_full_params wparams =
       whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
 
-  wparams.n_threads = 3;
+  // n_threads is set per decode by the scheduler
   wparams.audio_ctx = 0;
   wparams.max_tokens = 0;
   wparams.language = "en";
@@ -103,71 +208,792 @@ int main(int argc, char **argv) {
   wparams.tdrz_enable = false;
   wparams.temperature = 0.0f;
 
-  printf("[Connecting to ESP32 microphone at %s]\n", esp32_ip.c_str());
-
   int sample_rate = 16000;
-  AudioManager audio_manager(sample_rate, esp32_ip);
-  g_audioManager = &audio_manager;
-  signal(SIGTSTP, handle_sigstp);
+  IngestOptions ingest;
+  ingest.recv_buffer_bytes = params.recv_buffer_kb * 1024;
+  ingest.recv_batch = params.recv_batch;
+  ingest.jitter_depth_ms = params.jitter_depth_ms;
+  ingest.concealment = params.concealment == "silence"
+                           ? ConcealmentMode::Silence
+                           : ConcealmentMode::Interpolate;
+  ingest.input.sample_rate = params.input_rate;
+  ingest.input.channels = params.input_channels;
+  if (params.input_rate <= 0 || params.input_channels <= 0 ||
+      !parse_sample_format(params.input_format, ingest.input.format)) {
+    std::cerr << "Invalid input format; use a positive --input-rate and "
+                 "--input-channels and int16, int24 or float32"
+              << std::endl;
+    whisper_free(model_loading.get());
+    return 1;
+  }
+
+  ingest.capture_path = params.capture_packets;
+  ingest.replay_path = params.replay;
+  ingest.replay_speed = std::max(0.0f, params.replay_speed);
+  if (params.server && (!params.replay.empty() || !params.capture_packets.empty())) {
+    std::cerr << "--capture-packets and --replay apply to a single microphone, not --server"
+              << std::endl;
+    whisper_free(model_loading.get());
+    return 1;
+  }
+  if (!params.replay.empty()) {
+    // Replay what the sender was declared to send when it was captured
+    PacketCaptureReader capture;
+    if (!capture.open(params.replay)) {
+      whisper_free(model_loading.get());
+      return 1;
+    }
+    ingest.input = capture.input();
+    if (ingest.input.sample_rate <= 0 || ingest.input.channels <= 0) {
+      std::cerr << "Capture " << params.replay << " has no valid input format" << std::endl;
+      whisper_free(model_loading.get());
+      return 1;
+    }
+  }
+
+  // Audio that arrives while the model loads waits in the capture buffer
+  std::optional<AudioManager> audio_manager;
+  if (!params.server) {
+    if (params.replay.empty()) {
+      printf("[Connecting to ESP32 microphone at %s:%d]\n", params.esp32_ip.c_str(),
+             params.esp32_port);
+    }
+    audio_manager.emplace(sample_rate, params.esp32_ip, params.esp32_port,
+                          std::max(1, params.capture_buffer_s), ingest);
+    if (!audio_manager->start()) {
+      std::cerr << "Failed to connect to ESP32. Make sure it's powered on and "
+                   "WiFi is connected."
+                << std::endl;
+      whisper_free(model_loading.get());
+      return 1;
+    }
+  }
+
+  struct whisper_context *ctx = model_loading.get();
+  if (ctx == nullptr) {
+    std::cerr << "Failed to load model " << params.model << std::endl;
+    return 1;
+  }
+
+  SchedulerOptions scheduler_options;
+  scheduler_options.workers =
+      params.decoders > 0 ? params.decoders : (params.server ? 2 : 1);
+  scheduler_options.total_threads = params.threads;
+  InferenceScheduler scheduler(ctx, scheduler_options);
+  if (!scheduler.start()) {
+    whisper_free(ctx);
+    return 1;
+  }
+  // Prime every worker's compute buffers ahead of the first real decode,
+  // which queues behind these instead of paying for it
+  for (int i = 0; i < scheduler.workers(); i++) {
+    scheduler.submit("warm-up", InferenceScheduler::Clock::now(),
+                     [wparams](whisper_context *job_ctx, whisper_state *state, int n_threads) {
+                       warm_up_model(job_ctx, state, wparams, n_threads);
+                     });
+  }
+  ModelSwapper swapper(scheduler, ctx, params.model, cparams, wparams);
+  g_modelSwapper = &swapper;
+  std::thread(watch_commands).detach();
+
+  MetricsOptions metrics_options;
+  metrics_options.http_port = params.metrics_port;
+  metrics_options.interval_s = params.metrics_interval_s;
+  metrics_options.json_path = params.metrics_file;
+
+  if (params.server) {
+    MetricsExporter metrics(global_metrics(), metrics_options);
+    metrics.addGauge("decode_jobs_pending", "Decodes waiting for a worker",
+                     [&scheduler] { return static_cast<double>(scheduler.pending()); });
+    int ret = run_server(params, scheduler, wparams, ingest, metrics);
+    std::cout << scheduler.describe() << std::endl;
+    g_modelSwapper = nullptr;
+    scheduler.stop();
+    whisper_free(swapper.release());
+    return ret;
+  }
+
+  // Beam search only ever runs when the governor has headroom for it
+  if (params.no_governor && params.beam_size > 1) {
+    wparams.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+    wparams.beam_search.beam_size = params.beam_size;
+  }
+
+  // The governor's last resort: a smaller model with its own decode states
+  struct whisper_context *fallback_ctx = nullptr;
+  std::unique_ptr<InferenceScheduler> fallback_scheduler;
+  if (!params.no_governor && !params.fallback_model.empty()) {
+    fallback_ctx = whisper_init_from_file_with_params_no_state(
+        params.fallback_model.c_str(), cparams);
+    if (fallback_ctx == nullptr) {
+      std::cerr << "Failed to load fallback model " << params.fallback_model
+                << std::endl;
+      return 1;
+    }
+    fallback_scheduler = std::make_unique<InferenceScheduler>(fallback_ctx, scheduler_options);
+    if (!fallback_scheduler->start()) {
+      return 1;
+    }
+  }
 
-  std::string translated_text;
+  std::unique_ptr<ComputeGovernor> governor;
+  if (!params.no_governor) {
+    GovernorOptions governor_options;
+    governor_options.sample_rate = sample_rate;
+    governor_options.target_rtf = params.target_rtf;
+    governor_options.headroom_rtf = params.target_rtf / 2;
+    governor_options.max_backlog_s = params.max_backlog_s;
+    governor_options.beam_size = params.beam_size;
+    governor = std::make_unique<ComputeGovernor>(scheduler, fallback_scheduler.get(),
+                                                 governor_options);
+  }
+
+  // Greedy first, re-decoding only what whisper was unsure of. The
+  // streaming decoder already re-decodes every pass until words agree.
+  std::unique_ptr<AdaptiveDecoder> adaptive;
+  if (params.redecode) {
+    if (params.streaming) {
+      std::cerr << "--redecode applies to segment decoding, not --streaming" << std::endl;
+    } else {
+      AdaptiveOptions adaptive_options;
+      adaptive_options.min_confidence = params.redecode_confidence;
+      adaptive_options.beam_size = params.redecode_beam;
+      adaptive = std::make_unique<AdaptiveDecoder>(adaptive_options);
+    }
+  }
 
-  if (!audio_manager.start()) {
-    std::cerr << "Failed to connect to ESP32. Make sure it's powered on and "
-                 "WiFi is connected."
+  // Pipeline: inference (this thread) -> post-processing -> disk and
+  // translation sinks, each on its own thread behind a bounded queue, so a
+  // slow disk or translation backend never delays the next recognition
+  BackpressurePolicy archive_policy = BackpressurePolicy::DropOldest;
+  BackpressurePolicy translate_policy = BackpressurePolicy::Coalesce;
+  if (!parse_backpressure_policy(params.archive_policy, archive_policy) ||
+      !parse_backpressure_policy(params.translate_policy, translate_policy)) {
+    std::cerr << "Unknown queue policy; use block, drop-oldest or coalesce"
               << std::endl;
     return 1;
   }
+  OverloadOptions overload_options;
+  if (!parse_overload_policy(params.overload_policy, overload_options.policy)) {
+    std::cerr << "Unknown overload policy; use skip-to-live, drop-silence, "
+                 "reduce-context, markers or off"
+              << std::endl;
+    return 1;
+  }
+
+  BoundedQueue<TextEvent> text_queue(
+      "text", 64, BackpressurePolicy::Coalesce,
+      [](TextEvent &queued, TextEvent &&incoming) {
+        // Partials are superseded; finals are concatenated
+        if (!queued.final) {
+          queued = std::move(incoming);
+        } else if (incoming.final) {
+          queued.text += " " + incoming.text;
+          queued.end_sample = incoming.end_sample;
+        }
+      });
+  BoundedQueue<ArchiveItem> archive_queue(
+      "archive", 16, archive_policy, [](ArchiveItem &queued, ArchiveItem &&incoming) {
+        queued.text += incoming.text;
+        queued.audio.insert(queued.audio.end(), incoming.audio.begin(),
+                            incoming.audio.end());
+        queued.end_sample = std::max(queued.end_sample, incoming.end_sample);
+      });
+  BoundedQueue<TextEvent> translate_queue(
+      "translate", 4, translate_policy,
+      [](TextEvent &queued, TextEvent &&incoming) {
+        queued.text += " " + incoming.text;
+      });
+
+  // One rolling container per session instead of a file per segment;
+  // audio only reaches this queue with --save-audio
+  ArchiveOptions archive_options;
+  archive_options.directory = audio_manager->log_directory;
+  archive_options.sample_rate = sample_rate;
+  archive_options.rotate_seconds = params.archive_interval_s;
+  archive_options.rotate_bytes = static_cast<size_t>(params.archive_max_mb) << 20;
+  if (!parse_archive_codec(params.archive_codec, archive_options.codec)) {
+    std::cerr << "Unknown archive codec; use int16 or delta" << std::endl;
+    return 1;
+  }
+  SessionArchive archive(archive_options);
+
+  // Started before any stage, so a taken port or path fails cleanly
+  SubtitleOptions subtitle_options;
+  subtitle_options.unix_path = params.subtitle_socket;
+  subtitle_options.tcp_port = params.subtitle_port;
+  subtitle_options.default_rate_hz = params.subtitle_rate_hz;
+  SubtitlePublisher subtitles(subtitle_options);
+  if (!subtitles.start()) {
+    return 1;
+  }
+
+  LatencyHistogram &archive_write =
+      global_metrics().histogram("archive_write", "Archive stage, per item");
+  LatencyHistogram &translation_latency =
+      global_metrics().histogram("translation", "Translation submit to result");
+  LatencyHistogram &post_process =
+      global_metrics().histogram("post_process", "Post-processing stage, per event");
+  LatencyHistogram &text_delivery =
+      global_metrics().histogram("text_delivery", "Recognized to printed text");
+
+  PipelineStage archive_stage("archive", archive_queue, [&](ArchiveItem &item) {
+    const auto started = LatencyHistogram::Clock::now();
+    if (!item.audio.empty()) {
+      archive.appendAudio(item.index, item.start_sample, item.audio.data(),
+                          item.audio.size());
+    }
+    if (!item.text.empty()) {
+      archive.appendText(item.index, item.start_sample, item.end_sample,
+                         item.text);
+    }
+    archive_write.recordSince(started);
+  });
+
+  // Requests are asynchronous, so this stage never waits on the network;
+  // the client rejects requests beyond its pending limit
+  std::unique_ptr<Translator> translator;
+  if (!params.translate.empty()) {
+    TranslatorOptions translator_options;
+    if (!params.translate_endpoint.empty()) {
+      translator_options.endpoint = params.translate_endpoint;
+    }
+    translator_options.default_deadline =
+        std::chrono::milliseconds(params.translate_deadline_ms);
+    translator_options.batch_window =
+        std::chrono::milliseconds(params.translate_batch_ms);
+    translator_options.cache_capacity = params.translate_cache;
+    translator_options.cache_path = params.translate_cache_file;
+    translator = std::make_unique<Translator>(translator_options);
+  }
 
-  printf("[Start speaking - Processing in %d-second segments with no gaps]\n", params.segment_duration_s);
+  PipelineStage translate_stage("translate", translate_queue, [&](TextEvent &event) {
+    const int index = event.index;
+    const auto submitted = LatencyHistogram::Clock::now();
+    translator->translate(params.translate, event.text,
+                          [index, submitted, &translation_latency](
+                              const TranslationResult &result) {
+                            translation_latency.recordSince(submitted);
+                            if (result.ok) {
+                              std::cout << "Translation " << index << ": "
+                                        << result.text << std::endl;
+                            } else {
+                              std::cerr << "Translation " << index
+                                        << " failed: " << result.error
+                                        << std::endl;
+                            }
+                          });
+  });
 
-  int segment_count = 0;
+  PipelineStage post_stage("post", text_queue, [&](TextEvent &event) {
+    const auto started = LatencyHistogram::Clock::now();
+    std::string clean_text = removeParens(event.text);
 
-  while (audio_manager.pollEvents()) {
-    std::vector<float> audio_segment;
+    if (!event.final) {
+      std::cout << "[partial] " << clean_text << std::endl;
+      subtitles.setTentative(clean_text);
+      text_delivery.recordSince(event.created);
+      post_process.recordSince(started);
+      return;
+    }
 
-    // Wait for a few seconds of audio to be collected
-    if (audio_manager.waitForAudioSegment(audio_segment, params.segment_duration_s)) {
-      // Save audio segment to file
-      audio_manager.saveAudioSegment(audio_segment, segment_count);
+    // Display recognized text
+    if (params.streaming) {
+      std::cout << "\n[committed] " << clean_text << std::endl;
+    } else {
+      std::cout << "\n=== Segment " << event.index << " ===\n"
+                << clean_text << std::endl;
+    }
+    subtitles.commit(clean_text);
+    text_delivery.recordSince(event.created);
 
-      // Process audio with Whisper
-      if (whisper_full(ctx, wparams, audio_segment.data(),
-                       audio_segment.size()) != 0) {
-        std::cerr << "Failed to recognize audio segment " << segment_count
-                  << std::endl;
-        segment_count++;
+    archive_queue.push({event.index, clean_text, {}, event.start_sample,
+                        event.end_sample});
+
+    // Optional: translate the text if enabled
+    if (translator && !clean_text.empty()) {
+      translate_queue.push({event.index, clean_text, true});
+    }
+    post_process.recordSince(started);
+  });
+
+  VadOptions vad_options;
+  vad_options.sample_rate = sample_rate;
+  vad_options.threshold_db = params.vad_threshold_db;
+  vad_options.min_silence_ms = params.vad_silence_ms;
+  vad_options.max_segment_s = params.vad_max_segment_s;
+
+  overload_options.sample_rate = sample_rate;
+  overload_options.max_backlog_s = params.overload_backlog_s;
+  overload_options.target_backlog_s = params.overload_target_s;
+  overload_options.vad = vad_options;
+  OverloadGuard overload(overload_options);
+
+  auto last_report = std::chrono::steady_clock::now();
+  auto report_queues = [&](bool force) {
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - last_report < std::chrono::seconds(30)) {
+      return;
+    }
+    last_report = now;
+    std::cout << "Pipeline queues: " << text_queue.describe() << ", "
+              << archive_queue.describe() << ", "
+              << translate_queue.describe() << std::endl;
+    std::cout << scheduler.describe() << std::endl;
+    if (governor) {
+      std::cout << governor->describe() << std::endl;
+    }
+  };
+
+  // Everything the gauges sample outlives the exporter
+  if (metrics_options.json_path.empty()) {
+    metrics_options.json_path = audio_manager->log_directory + "/metrics.jsonl";
+  }
+  MetricsExporter metrics(global_metrics(), metrics_options);
+  metrics.addGauge("buffered_samples", "Captured audio not yet taken for decoding",
+                   [&] { return static_cast<double>(audio_manager->bufferedSamples()); });
+  metrics.addGauge("backlog_seconds", "Captured audio not yet taken for decoding",
+                   [&] { return audio_manager->bufferedSamples() / static_cast<double>(sample_rate); });
+  metrics.addGauge("decode_jobs_pending", "Decodes waiting for a worker",
+                   [&] { return static_cast<double>(scheduler.pending()); });
+  metrics.addGauge("text_queue_depth", "Events waiting for post-processing",
+                   [&] { return static_cast<double>(text_queue.stats().depth); });
+  metrics.addGauge("archive_queue_depth", "Items waiting for the archive",
+                   [&] { return static_cast<double>(archive_queue.stats().depth); });
+  metrics.addGauge("translate_queue_depth", "Texts waiting for translation",
+                   [&] { return static_cast<double>(translate_queue.stats().depth); });
+  metrics.addGauge("kernel_drops", "Datagrams dropped by the kernel",
+                   [&] { return static_cast<double>(audio_manager->getStats().kernel_drops); });
+  metrics.addGauge("overrun_samples", "Samples dropped on a full capture buffer",
+                   [&] { return static_cast<double>(audio_manager->getStats().overrun_samples); });
+  metrics.addGauge("overload_shed_seconds", "Backlog audio dropped to keep up with live audio",
+                   [&] { return overload.getStats().shedSamples() / static_cast<double>(sample_rate); });
+  metrics.addGauge("overload_active", "1 while the backlog is over --overload-backlog",
+                   [&] { return overload.getStats().overloaded ? 1.0 : 0.0; });
+  metrics.addGauge("subtitle_subscribers", "Connected subtitle subscribers",
+                   [&] { return static_cast<double>(subtitles.stats().subscribers); });
+  if (governor) {
+    metrics.addGauge("governor_tier", "Decode settings tier, 0 is the best quality",
+                     [&] { return static_cast<double>(governor->getStats().tier); });
+    metrics.addGauge("governor_rtf", "Smoothed decode time per second of audio",
+                     [&] { return governor->getStats().smoothed_rtf; });
+  }
+  metrics.start();
+
+  // Audio still waiting to be decoded, for the governor
+  auto backlog_s = [&] {
+    return audio_manager->bufferedSamples() / static_cast<double>(sample_rate);
+  };
+
+  g_audioManager = &*audio_manager;
+  if (params.streaming) {
+    StreamingOptions options;
+    options.sample_rate = sample_rate;
+    options.context_duration_s = params.context_duration_s;
+    options.prompt_tokens = params.prompt_tokens;
+    options.deadline_ms = params.latency_ms > 0
+                              ? params.latency_ms
+                              : static_cast<int>(params.recognition_interval_s * 1000);
+    StreamingDecoder decoder(scheduler, wparams, options);
+    decoder.setGovernor(governor.get());
+    decoder.setOverloadGuard(&overload);
+    StreamingDecoder::Update update;
+
+    const size_t interval_samples =
+        static_cast<size_t>(params.recognition_interval_s * sample_rate);
+    const size_t pause_samples =
+        static_cast<size_t>(params.vad_silence_ms) * sample_rate / 1000;
+    int commit_count = 0;
+    // Session position of all audio appended so far, and the end of the
+    // audio covered by committed text
+    int64_t stream_samples = 0;
+    int64_t committed_until = 0;
+
+    // Tentative text while a pass is still decoding. The main thread
+    // waits for the pass, so commit_count is stable meanwhile.
+    if (!params.no_partials) {
+      decoder.setPartialCallback([&](const ResultUpdate &result) {
+        text_queue.push({commit_count, result.text, false,
+                         result.t0_ms * sample_rate / 1000,
+                         result.t1_ms * sample_rate / 1000});
+      });
+    }
+
+    // VAD gating: silence is never appended to an idle window, and a pause
+    // after speech commits the tentative tail right away
+    EnergyVad vad(vad_options);
+    size_t silence_run = 0;
+    uint64_t skipped_samples = 0;
+    // New audio each interval, before it joins the decoder's window
+    std::vector<float> chunk;
+
+    printf("[Start speaking - Streaming every %.2f s, context up to %.0f s]\n",
+           params.recognition_interval_s, params.context_duration_s);
+
+    while (audio_manager->pollEvents()) {
+      OverloadEvent overload_event;
+      if (overload.check(*audio_manager, overload_event)) {
+        const int64_t gap_start = stream_samples;
+        stream_samples += static_cast<int64_t>(overload_event.shed_samples);
+        if (overload_event.policy != OverloadPolicy::DropSilence) {
+          // Words must not run across the skipped audio
+          std::string tail = decoder.flush();
+          if (!tail.empty()) {
+            text_queue.push({commit_count++, tail, true, committed_until, gap_start});
+          }
+          decoder.clearPrompt();
+          decoder.discard(overload_event.shed_samples);
+          committed_until = stream_samples;
+        } else {
+          // The silence was cut from audio not yet in the window
+          decoder.skipAhead(overload_event.shed_samples);
+        }
+        if (!overload_event.marker.empty()) {
+          text_queue.push({commit_count++, overload_event.marker, true, gap_start,
+                           stream_samples});
+        }
+      }
+
+      // Sleep until at least one interval of new audio has arrived
+      const size_t window_size = decoder.window().size();
+      size_t room = decoder.maxWindowSamples() - std::min(window_size, decoder.maxWindowSamples());
+      chunk.clear();
+      if (!audio_manager->appendNewAudio(chunk, interval_samples, std::max<size_t>(room, 1))) {
         continue;
       }
+      const size_t added = chunk.size();
+      if (params.save_audio) {
+        archive_queue.push({commit_count, "", chunk, stream_samples,
+                            stream_samples + static_cast<int64_t>(added)});
+      }
+      stream_samples += added;
 
-      // Extract recognized text
-      std::string audio_text = "";
-      const int n_segments = whisper_full_n_segments(ctx);
-      for (int i = 0; i < n_segments; ++i) {
-        audio_text += whisper_full_get_segment_text(ctx, i);
+      if (params.vad) {
+        bool speech = vad.processChunk(chunk.data(), added);
+        silence_run = speech ? 0 : silence_run + added;
+
+        if (!speech && silence_run >= pause_samples) {
+          std::string tail = decoder.flush();
+          if (!tail.empty()) {
+            text_queue.push({commit_count++, tail, true, committed_until, stream_samples});
+          }
+          committed_until = stream_samples;
+        }
+        if (!speech && decoder.window().empty()) {
+          // Nothing pending but silence: drop it without decoding
+          skipped_samples += added;
+          decoder.discard(added);
+          continue;
+        }
       }
+      decoder.append(chunk.data(), added);
 
-      std::string clean_text = removeParens(audio_text);
+      if (!decoder.process(update)) {
+        std::cerr << "Failed to recognize streaming window" << std::endl;
+        continue;
+      }
+      if (governor) {
+        // Each pass has to keep up with the audio added since the last one
+        const JobTiming &timing = decoder.lastTiming();
+        governor->record(static_cast<double>(added) / sample_rate,
+                         timing.service_us / 1e6, backlog_s(), timing.threads);
+      }
 
-      // Display recognized text
-      std::cout << "\n=== Segment " << segment_count << " ===\n"
-                << clean_text << std::endl;
+      // Committed words end where the trimmed window now starts
+      const int64_t window_start = decoder.windowStart();
+      if (!update.committed.empty()) {
+        text_queue.push({commit_count++, update.committed, true,
+                         committed_until, window_start});
+        committed_until = window_start;
+      }
+      if (!update.tentative.empty()) {
+        text_queue.push({commit_count, update.tentative, false,
+                         committed_until, stream_samples});
+      }
+      report_queues(false);
+    }
 
-      // Save text to file
-      audio_manager.saveTextOutput(clean_text, segment_count);
+    std::string rest = decoder.flush();
+    if (!rest.empty()) {
+      text_queue.push({commit_count++, rest, true, committed_until, stream_samples});
+    }
+    if (params.vad) {
+      std::cout << "VAD skipped " << skipped_samples / sample_rate
+                << " s of silence" << std::endl;
+    }
+    if (params.prompt_tokens > 0) {
+      std::cout << decoder.prompt().describe() << std::endl;
+    }
+    const MelFrontendStats &mel = decoder.melStats();
+    if (mel.calls > 0) {
+      std::cout << "Mel frontend: " << mel.frames_reused << " frames reused, "
+                << mel.frames_computed << " computed, "
+                << mel.compute_us / 1000.0 / mel.calls << " ms per pass"
+                << std::endl;
+    }
+  } else {
+    int segment_count = 0;
+    // Text of the segments before, so words cut at a boundary keep context
+    PromptRing prompt(params.prompt_tokens);
 
-      // Optional: translate the text if enabled
-      if (!params.translate.empty()) {
-        translate_text(params.translate, clean_text, translated_text);
-        std::cout << "Translation: " << translated_text << std::endl;
+    // Recognize one segment starting at `start_sample` of the session and
+    // hand its text to the pipeline; returns the decode time
+    auto process_segment = [&](const float *samples, size_t sample_count,
+                               int64_t start_sample,
+                               AudioSegmentLease *lease) -> double {
+      const int64_t end_sample = start_sample + static_cast<int64_t>(sample_count);
+      if (params.save_audio) {
+        // Queue a copy for the archive stage before the lease is returned
+        archive_queue.push({segment_count, "",
+                            std::vector<float>(samples, samples + sample_count),
+                            start_sample, end_sample});
       }
 
+      // Process audio with Whisper; the next segment is due one segment
+      // duration from now
+      const int latency_ms = params.latency_ms > 0
+                                 ? params.latency_ms
+                                 : params.segment_duration_s * 1000;
+      DecodeSettings settings;
+      settings.scheduler = &scheduler;
+      if (governor) {
+        settings = governor->current();
+      }
+      const bool apply_settings = overload.adjust(settings) || governor;
+      int ret = -1;
+      std::string audio_text = "";
+      const InferenceScheduler::Clock::time_point deadline =
+          InferenceScheduler::Clock::now() + std::chrono::milliseconds(latency_ms);
+      JobTiming timing = settings.scheduler->run(
+          "segment " + std::to_string(segment_count), deadline,
+          [&](whisper_context *job_ctx, whisper_state *state, int n_threads) {
+            whisper_full_params job_params = wparams;
+            job_params.n_threads = n_threads;
+            std::vector<whisper_token> prompt_tokens;
+            prompt.apply(job_ctx, job_params, prompt_tokens);
+            if (apply_settings) {
+              settings.apply(job_params, sample_count, n_threads, sample_rate);
+            }
+            // Show the segment's text token by token while it decodes;
+            // the final text is pushed below once the decode returns
+            std::unique_ptr<DecodeResultStream> results;
+            if (!params.no_partials) {
+              results.reset(new DecodeResultStream(
+                  [&](const ResultUpdate &result) {
+                    if (!result.final) {
+                      text_queue.push({segment_count, result.text, false,
+                                       start_sample, end_sample});
+                    }
+                  },
+                  start_sample * 1000 / sample_rate,
+                  static_cast<int64_t>(sample_count) * 1000 / sample_rate));
+              results->attach(job_params);
+            }
+            if (adaptive) {
+              ret = adaptive->decode(job_ctx, state, job_params, samples,
+                                     static_cast<int>(sample_count), deadline, audio_text);
+              return;
+            }
+            ret = whisper_full_timed(job_ctx, state, job_params, samples,
+                                     static_cast<int>(sample_count));
+
+            // Extract recognized text
+            const int n_segments = whisper_full_n_segments_from_state(state);
+            for (int i = 0; ret == 0 && i < n_segments; ++i) {
+              audio_text += whisper_full_get_segment_text_from_state(state, i);
+            }
+          });
+      const double decode_ms = timing.service_us / 1000.0;
+      if (governor) {
+        governor->record(static_cast<double>(sample_count) / sample_rate,
+                         decode_ms / 1000.0, backlog_s(), timing.threads);
+      }
+      if (lease != nullptr) {
+        lease->release();
+      }
+      if (ret != 0) {
+        std::cerr << "Failed to recognize audio segment " << segment_count
+                  << std::endl;
+        segment_count++;
+        return decode_ms;
+      }
+
+      text_queue.push({segment_count, audio_text, true, start_sample, end_sample});
+      prompt.append(audio_text);
+      report_queues(false);
+
       segment_count++;
+      return decode_ms;
+    };
+
+    if (params.vad) {
+      printf("[Start speaking - Segmenting at pauses, at most %.0f s per segment]\n",
+             params.vad_max_segment_s);
+
+      VadSegmenter segmenter(vad_options);
+      std::vector<float> chunk;
+      std::vector<float> speech_segment;
+      int64_t speech_start = 0;
+      // Backlog shed so far; the segmenter only counts audio pushed to it.
+      // Each shed lands where the segmenter stood, so a segment already
+      // open during a drop-silence cut keeps its start.
+      int64_t shed_samples = 0;
+      std::vector<std::pair<int64_t, int64_t>> shed_marks; // pushed position, shed from there on
+      auto shed_before = [&](int64_t pushed) {
+        for (auto it = shed_marks.rbegin(); it != shed_marks.rend(); ++it) {
+          if (it->first <= pushed) {
+            return it->second;
+          }
+        }
+        return int64_t{0};
+      };
+      const size_t chunk_samples = sample_rate / 10;
+
+      auto decode_segments = [&] {
+        while (segmenter.popSegment(speech_segment, &speech_start)) {
+          double decode_ms = process_segment(speech_segment.data(),
+                                             speech_segment.size(),
+                                             speech_start + shed_before(speech_start), nullptr);
+          segmenter.recordDecode(speech_segment.size(), decode_ms);
+
+          const VadStats &stats = segmenter.stats();
+          std::cout << "VAD: " << stats.segments << " segments ("
+                    << stats.forced_cuts << " forced), skipped "
+                    << stats.skipped_samples / sample_rate << " of "
+                    << stats.total_samples / sample_rate
+                    << " s, ~" << stats.inference_ms_saved / 1000.0
+                    << " s of inference avoided" << std::endl;
+        }
+      };
+
+      while (audio_manager->pollEvents()) {
+        OverloadEvent overload_event;
+        if (overload.check(*audio_manager, overload_event)) {
+          if (overload_event.policy != OverloadPolicy::DropSilence) {
+            // End the open segment where the skipped audio starts
+            segmenter.flush();
+            decode_segments();
+            prompt.clear();
+          }
+          if (!overload_event.marker.empty()) {
+            const int64_t gap_start = static_cast<int64_t>(segmenter.stats().total_samples) + shed_samples;
+            text_queue.push({segment_count, overload_event.marker, true, gap_start,
+                             gap_start + static_cast<int64_t>(overload_event.shed_samples)});
+          }
+          shed_samples += static_cast<int64_t>(overload_event.shed_samples);
+          shed_marks.push_back({static_cast<int64_t>(segmenter.stats().total_samples), shed_samples});
+        }
+
+        chunk.clear();
+        if (!audio_manager->appendNewAudio(chunk, chunk_samples)) {
+          continue;
+        }
+
+        segmenter.push(chunk.data(), chunk.size());
+        decode_segments();
+      }
+      // The last utterance is still open once the input stops
+      segmenter.flush();
+      decode_segments();
+    } else {
+      printf("[Start speaking - Processing in %d-second segments with no gaps]\n", params.segment_duration_s);
+
+      AudioSegmentLease audio_segment;
+      int64_t segment_start = 0;
+
+      while (audio_manager->pollEvents()) {
+        OverloadEvent overload_event;
+        if (overload.check(*audio_manager, overload_event)) {
+          if (!overload_event.marker.empty()) {
+            text_queue.push({segment_count, overload_event.marker, true, segment_start,
+                             segment_start + static_cast<int64_t>(overload_event.shed_samples)});
+          }
+          segment_start += static_cast<int64_t>(overload_event.shed_samples);
+          if (overload_event.policy != OverloadPolicy::DropSilence) {
+            prompt.clear();
+          }
+        }
+
+        // Wait for a few seconds of audio to be collected; the segment is
+        // borrowed from the capture buffer and handed back once decoded
+        if (audio_manager->acquireAudioSegment(audio_segment, params.segment_duration_s)) {
+          const size_t segment_samples = audio_segment.size();
+          process_segment(audio_segment.data(), segment_samples, segment_start,
+                          &audio_segment);
+          segment_start += static_cast<int64_t>(segment_samples);
+        }
+      }
+    }
+    if (params.prompt_tokens > 0) {
+      std::cout << prompt.describe() << std::endl;
     }
   }
 
-  audio_manager.stop();
-  whisper_free(ctx);
+  // Drain the pipeline front to back
+  text_queue.close();
+  post_stage.join();
+  subtitles.stop();
+  archive_queue.close();
+  translate_queue.close();
+  archive_stage.join();
+  translate_stage.join();
+  if (translator) {
+    // Nothing submits any more; give the last texts until their deadline
+    const size_t dropped = translator->drain(
+        std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(params.translate_deadline_ms + 500));
+    if (dropped > 0) {
+      std::cerr << "Translation: " << dropped << " texts still in flight at exit were dropped"
+                << std::endl;
+    }
+  }
+  archive.close();
+  {
+    const ArchiveStats &stats = archive.stats();
+    std::cout << "Archive: " << stats.text_records << " transcripts, "
+              << stats.samples / sample_rate << " s of audio in "
+              << stats.bytes_written / 1024 << " KB over " << stats.files
+              << " files";
+    if (stats.audio_bytes > 0) {
+      std::cout << " (" << stats.compressionRatio() << "x smaller than float WAV)";
+    }
+    std::cout << std::endl;
+  }
+  if (translator) {
+    TranslatorStats stats = translator->getStats();
+    std::cout << "Translation: " << stats.submitted << " texts, "
+              << stats.hitRate() * 100.0 << "% cache hits, "
+              << stats.http_requests << " requests, mean batch "
+              << stats.meanBatchSize() << ", max batch "
+              << stats.max_batch_size << std::endl;
+  }
+  {
+    const SubtitleStats stats = subtitles.stats();
+    if (stats.subscribers_total > 0) {
+      std::cout << "Subtitles: " << stats.updates << " updates, " << stats.messages
+                << " messages (" << stats.bytes_sent / 1024 << " KB) to "
+                << stats.subscribers_total << " subscribers" << std::endl;
+    }
+  }
+  if (overload_options.policy != OverloadPolicy::Off) {
+    std::cout << overload.describe() << std::endl;
+  }
+  if (adaptive) {
+    std::cout << adaptive->describe() << std::endl;
+  }
+  translator.reset(); // fails anything drain() gave up on
+  report_queues(true);
+  metrics.stop();
+
+  g_audioManager = nullptr;
+  g_modelSwapper = nullptr;
+  audio_manager->stop();
+  scheduler.stop();
+  if (fallback_scheduler) {
+    fallback_scheduler->stop();
+    whisper_free(fallback_ctx);
+  }
+  whisper_free(swapper.release());
 
   return 0;
 }
@@ -0,0 +1,415 @@
+#include "stream_server.hpp"
+#include "packet_protocol.hpp"
+#include "prompt_ring.hpp"
+#include "sample_convert.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+static constexpr size_t kMaxDatagramBytes = 2048;
+// Upper bound of what a jitter buffer holds: its slots times a full packet
+static constexpr size_t kJitterSlots = 64;
+
+static int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct StreamServer::ClientStream {
+  ClientStream(int id, std::string peer, size_t ring_samples,
+               const StreamServerOptions &options)
+      : id(id), peer(std::move(peer)), ring(ring_samples),
+        converter(options.ingest.input, options.sample_rate),
+        jitter(static_cast<size_t>(options.ingest.input.sample_rate) *
+                   converter.input().channels * options.ingest.jitter_depth_ms / 1000,
+               static_cast<size_t>(options.ingest.input.sample_rate) *
+                   converter.input().channels * kJitterResyncSeconds,
+               options.ingest.concealment,
+               [this](const int16_t *samples, size_t count) {
+                 if (converter.passthrough()) {
+                   push(samples, count);
+                 } else {
+                   pushPcm(reinterpret_cast<const char *>(samples),
+                           count * sizeof(int16_t), SampleFormat::Int16);
+                 }
+               },
+               kJitterSlots),
+        prompt(options.prompt_tokens) {}
+
+  // Ingest thread only
+  void push(const int16_t *samples, size_t count) {
+    size_t written = ring.produce(count, [samples](float *dst, size_t offset, size_t n) {
+      convert_int16_to_float(samples + offset, dst, n);
+    });
+    if (written < count) {
+      overrun_samples.fetch_add(count - written, std::memory_order_relaxed);
+    }
+  }
+
+  // Ingest thread only: declared-format PCM, downmixed and resampled
+  void pushPcm(const char *data, size_t bytes, SampleFormat format) {
+    const std::vector<float> &samples = converter.convert(data, bytes, format);
+    size_t written = ring.produce(samples.size(), [&samples](float *dst, size_t offset, size_t n) {
+      std::copy(samples.begin() + offset, samples.begin() + offset + n, dst);
+    });
+    if (written < samples.size()) {
+      overrun_samples.fetch_add(samples.size() - written, std::memory_order_relaxed);
+    }
+  }
+
+  const int id;
+  const std::string peer;
+
+  // Producer: ingest thread. Consumer: whichever worker holds `scheduled`
+  SpscRingBuffer<float> ring;
+  PcmConverter converter;
+  JitterBuffer jitter;
+  std::vector<float> scratch;
+  // The stream's last segments, as context for its next decode
+  PromptRing prompt;
+
+  std::atomic<bool> scheduled{false};
+  std::atomic<uint64_t> packets{0};
+  std::atomic<uint64_t> overrun_samples{0};
+  std::atomic<uint64_t> segments{0};
+  std::atomic<int64_t> last_seen_ms{0};
+
+  // Snapshot published by the ingest thread with try_lock
+  std::mutex jitter_stats_mutex;
+  JitterStats jitter_stats;
+};
+
+StreamServer::StreamServer(InferenceScheduler &scheduler,
+                           const whisper_full_params &params,
+                           const StreamServerOptions &options)
+    : scheduler_(scheduler), params_(params), options_(options),
+      segment_samples_(static_cast<size_t>(options.sample_rate) *
+                       options.segment_duration_s) {}
+
+StreamServer::~StreamServer() {
+  stop();
+  if (sock_ >= 0)
+    ::close(sock_);
+  if (epoll_fd_ >= 0)
+    ::close(epoll_fd_);
+  if (wake_fd_ >= 0)
+    ::close(wake_fd_);
+}
+
+size_t StreamServer::perStreamBytes() const {
+  size_t ring_samples = 1;
+  while (ring_samples < static_cast<size_t>(options_.sample_rate) * options_.buffer_duration_s) {
+    ring_samples <<= 1;
+  }
+  return sizeof(ClientStream) + ring_samples * sizeof(float) +
+         kJitterSlots * kMaxDatagramBytes + segment_samples_ * sizeof(float);
+}
+
+bool StreamServer::start() {
+#ifndef __linux__
+  std::cerr << "Server mode needs epoll and is only available on Linux"
+            << std::endl;
+  return false;
+#else
+  sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock_ < 0) {
+    std::cerr << "Failed to create socket" << std::endl;
+    return false;
+  }
+
+  int rcvbuf = options_.ingest.recv_buffer_bytes;
+  setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(options_.port);
+  if (bind(sock_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    std::cerr << "Failed to bind UDP port " << options_.port << ": "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+
+  epoll_fd_ = epoll_create1(0);
+  wake_fd_ = eventfd(0, EFD_NONBLOCK);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    std::cerr << "Failed to create epoll instance" << std::endl;
+    return false;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = sock_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock_, &ev);
+  ev.data.fd = wake_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+  running_ = true;
+  ingest_thread_ = std::thread(&StreamServer::ingestLoop, this);
+
+  std::cout << "Server listening on UDP port " << options_.port << " with "
+            << scheduler_.workers() << " decode workers, ~"
+            << perStreamBytes() / 1024 << " KB per stream" << std::endl;
+  return true;
+#endif
+}
+
+void StreamServer::stop() {
+  // Concurrent callers wait for the first one to finish
+  std::lock_guard<std::mutex> stop_lock(stop_mutex_);
+  if (!running_.exchange(false)) {
+    return;
+  }
+
+#ifdef __linux__
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0) {
+    std::cerr << "Failed to wake ingest thread: " << strerror(errno)
+              << std::endl;
+  }
+#endif
+  if (ingest_thread_.joinable()) {
+    ingest_thread_.join();
+  }
+
+  // Queued jobs see running_ cleared and return without decoding
+  std::unique_lock<std::mutex> lock(jobs_mutex_);
+  jobs_cv_.wait(lock, [this] { return jobs_in_flight_ == 0; });
+}
+
+void StreamServer::ingestLoop() {
+#ifdef __linux__
+  const size_t batch = static_cast<size_t>(std::max(1, options_.ingest.recv_batch));
+  std::vector<char> buffers(batch * kMaxDatagramBytes);
+  std::vector<struct mmsghdr> msgs(batch);
+  std::vector<struct iovec> iovs(batch);
+  std::vector<struct sockaddr_in> peers(batch);
+  char peer_name[INET_ADDRSTRLEN + 8];
+
+  int64_t last_reap_ms = steady_ms();
+  struct epoll_event events[4];
+
+  while (running_) {
+    int n = epoll_wait(epoll_fd_, events, 4, 1000);
+    if (n < 0 && errno != EINTR) {
+      std::cerr << "Error in epoll_wait: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    for (int e = 0; e < n; e++) {
+      if (events[e].data.fd == wake_fd_) {
+        return;
+      }
+
+      // Drain the socket completely, a batch per syscall
+      while (true) {
+        for (size_t i = 0; i < batch; i++) {
+          iovs[i].iov_base = &buffers[i * kMaxDatagramBytes];
+          iovs[i].iov_len = kMaxDatagramBytes;
+          std::memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+          msgs[i].msg_hdr.msg_iov = &iovs[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+          msgs[i].msg_hdr.msg_name = &peers[i];
+          msgs[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+        }
+
+        int received = recvmmsg(sock_, msgs.data(), batch, MSG_DONTWAIT, nullptr);
+        if (received <= 0) {
+          break;
+        }
+        for (int i = 0; i < received; i++) {
+          inet_ntop(AF_INET, &peers[i].sin_addr, peer_name, INET_ADDRSTRLEN);
+          std::string peer = std::string(peer_name) + ":" +
+                             std::to_string(ntohs(peers[i].sin_port));
+          handleDatagram(&buffers[i * kMaxDatagramBytes], msgs[i].msg_len, peer);
+        }
+        if (static_cast<size_t>(received) < batch) {
+          break;
+        }
+      }
+    }
+
+    if (steady_ms() - last_reap_ms > 5000) {
+      reapIdleStreams();
+      last_reap_ms = steady_ms();
+    }
+  }
+#endif
+}
+
+std::shared_ptr<StreamServer::ClientStream>
+StreamServer::findStream(const std::string &key, const std::string &peer) {
+  std::lock_guard<std::mutex> lock(streams_mutex_);
+  auto it = streams_.find(key);
+  if (it != streams_.end()) {
+    return it->second;
+  }
+
+  auto stream = std::make_shared<ClientStream>(
+      next_stream_id_++, peer,
+      static_cast<size_t>(options_.sample_rate) * options_.buffer_duration_s,
+      options_);
+  streams_[key] = stream;
+  std::cout << "New stream " << stream->id << " from " << peer << " (" << key
+            << "), " << streams_.size() << " active, ~"
+            << perStreamBytes() / 1024 << " KB" << std::endl;
+  return stream;
+}
+
+void StreamServer::handleDatagram(const char *data, size_t size,
+                                  const std::string &peer) {
+  if (size < 2) {
+    return;
+  }
+
+  AudioPacket packet;
+  const bool framed = parse_audio_packet(data, size, packet);
+  // Framed packets name their stream; legacy ones are keyed by sender
+  auto stream = findStream(framed ? "id:" + std::to_string(packet.stream_id) : peer, peer);
+
+  stream->packets.fetch_add(1, std::memory_order_relaxed);
+  stream->last_seen_ms.store(steady_ms(), std::memory_order_relaxed);
+
+  if (framed) {
+    stream->jitter.push(packet);
+    if (stream->jitter_stats_mutex.try_lock()) {
+      stream->jitter_stats = stream->jitter.stats();
+      stream->jitter_stats_mutex.unlock();
+    }
+  } else if (!stream->converter.passthrough()) {
+    stream->pushPcm(data, size, options_.ingest.input.format);
+  } else {
+    const int16_t *samples = reinterpret_cast<const int16_t *>(data);
+    size_t count = size / 2;
+    // Same leading-zero heuristic as the single-stream path
+    size_t start = (count >= 2 && samples[0] == 0 && samples[1] == 0) ? 2 : 0;
+    stream->push(samples + start, count - start);
+  }
+
+  scheduleIfReady(stream);
+}
+
+void StreamServer::scheduleIfReady(const std::shared_ptr<ClientStream> &stream) {
+  if (!running_ || stream->ring.size() < segment_samples_ ||
+      stream->scheduled.exchange(true)) {
+    return;
+  }
+
+  const int latency_ms = options_.latency_ms > 0
+                             ? options_.latency_ms
+                             : options_.segment_duration_s * 1000;
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    jobs_in_flight_++;
+  }
+  // The job holds a reference, so a stream reaped meanwhile stays valid
+  scheduler_.submit("stream " + std::to_string(stream->id),
+                    InferenceScheduler::Clock::now() + std::chrono::milliseconds(latency_ms),
+                    [this, stream](whisper_context *ctx, whisper_state *state, int n_threads) {
+                      if (running_) {
+                        decodeSegment(*stream, ctx, state, n_threads);
+                      }
+                      stream->scheduled.store(false);
+                      scheduleIfReady(stream);
+
+                      std::lock_guard<std::mutex> lock(jobs_mutex_);
+                      if (--jobs_in_flight_ == 0) {
+                        jobs_cv_.notify_all();
+                      }
+                    });
+}
+
+void StreamServer::decodeSegment(ClientStream &stream, whisper_context *ctx,
+                                 whisper_state *state, int n_threads) {
+  // This job is the ring's only consumer until `scheduled` is cleared
+  auto view = stream.ring.peek(segment_samples_);
+  const float *samples = view.first;
+  if (view.second_size > 0) {
+    stream.scratch.resize(view.size());
+    std::copy(view.first, view.first + view.first_size, stream.scratch.begin());
+    std::copy(view.second, view.second + view.second_size,
+              stream.scratch.begin() + view.first_size);
+    samples = stream.scratch.data();
+  }
+
+  whisper_full_params wparams = params_;
+  wparams.n_threads = n_threads;
+  std::vector<whisper_token> prompt_tokens;
+  stream.prompt.apply(ctx, wparams, prompt_tokens);
+  int ret = whisper_full_timed(ctx, state, wparams, samples,
+                               static_cast<int>(view.size()));
+  stream.ring.release(view.size());
+  int segment = static_cast<int>(stream.segments.fetch_add(1));
+
+  if (ret != 0) {
+    std::cerr << "Stream " << stream.id << ": failed to recognize segment "
+              << segment << std::endl;
+  } else {
+    std::string text;
+    const int n_segments = whisper_full_n_segments_from_state(state);
+    for (int i = 0; i < n_segments; ++i) {
+      text += whisper_full_get_segment_text_from_state(state, i);
+    }
+    stream.prompt.append(text);
+    if (on_text_) {
+      on_text_(describe(stream), segment, text);
+    }
+  }
+}
+
+void StreamServer::reapIdleStreams() {
+  const int64_t cutoff = steady_ms() - options_.idle_timeout_s * 1000LL;
+  std::lock_guard<std::mutex> lock(streams_mutex_);
+  for (auto it = streams_.begin(); it != streams_.end();) {
+    const auto &stream = it->second;
+    if (stream->last_seen_ms.load() < cutoff && !stream->scheduled.load()) {
+      std::cout << "Stream " << stream->id << " from " << stream->peer
+                << " idle, released" << std::endl;
+      it = streams_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+StreamReport StreamServer::describe(const ClientStream &stream) const {
+  StreamReport report;
+  report.id = stream.id;
+  report.peer = stream.peer;
+  report.packets = stream.packets.load(std::memory_order_relaxed);
+  report.overrun_samples = stream.overrun_samples.load(std::memory_order_relaxed);
+  report.segments = stream.segments.load(std::memory_order_relaxed);
+  report.buffered_samples = stream.ring.size();
+  // Upper bound: the wrap scratch buffer is only allocated on demand
+  report.memory_bytes = sizeof(ClientStream) +
+                        stream.ring.capacity() * sizeof(float) +
+                        kJitterSlots * kMaxDatagramBytes +
+                        segment_samples_ * sizeof(float);
+  return report;
+}
+
+std::vector<StreamReport> StreamServer::report() {
+  std::vector<StreamReport> reports;
+  std::lock_guard<std::mutex> lock(streams_mutex_);
+  for (const auto &entry : streams_) {
+    StreamReport report = describe(*entry.second);
+    {
+      std::lock_guard<std::mutex> stats_lock(entry.second->jitter_stats_mutex);
+      report.jitter = entry.second->jitter_stats;
+    }
+    reports.push_back(report);
+  }
+  std::sort(reports.begin(), reports.end(),
+            [](const StreamReport &a, const StreamReport &b) { return a.id < b.id; });
+  return reports;
+}
@@ -0,0 +1,117 @@
+#ifndef STREAM_SERVER_HPP
+#define STREAM_SERVER_HPP
+
+#include "audio_manager.hpp"
+#include "inference_scheduler.hpp"
+#include "jitter_buffer.hpp"
+#include "ring_buffer.hpp"
+#include "whisper.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct StreamServerOptions {
+  int port = 5001;
+  int sample_rate = 16000;
+  int segment_duration_s = 7;
+  // Per-stream backlog; this dominates the memory cost of a stream
+  int buffer_duration_s = 30;
+  // Streams silent this long are forgotten
+  int idle_timeout_s = 60;
+  // Deadline for decoding a full segment; 0 uses the segment duration,
+  // i.e. finish before the next segment of that stream is ready
+  int latency_ms = 0;
+  // Recent text of a stream passed to its next decode, 0 for none
+  int prompt_tokens = 64;
+  IngestOptions ingest;
+};
+
+struct StreamReport {
+  int id = 0;
+  std::string peer;
+  uint64_t packets = 0;
+  uint64_t overrun_samples = 0;
+  uint64_t segments = 0;
+  size_t buffered_samples = 0;
+  size_t memory_bytes = 0;
+  JitterStats jitter;
+};
+
+// Server mode: one UDP port, many ESP32 streams, one model.
+//
+// An epoll loop receives datagrams from every sender and demultiplexes them
+// by the header's stream id (framed packets) or by sender address (legacy
+// raw PCM). Each stream has its own ring buffer, jitter buffer and
+// transcript counter. Full segments are decoded on a shared
+// InferenceScheduler, whose workers each own a whisper_state on one
+// context, so an extra stream costs its buffers rather than a copy of the
+// model.
+class StreamServer {
+public:
+  using TextCallback =
+      std::function<void(const StreamReport &stream, int segment, const std::string &text)>;
+
+  StreamServer(InferenceScheduler &scheduler, const whisper_full_params &params,
+               const StreamServerOptions &options);
+  ~StreamServer();
+
+  StreamServer(const StreamServer &) = delete;
+  StreamServer &operator=(const StreamServer &) = delete;
+
+  bool start();
+  void stop();
+  bool running() const { return running_; }
+
+  // Called on a scheduler worker thread for every recognized segment
+  void setTextCallback(TextCallback callback) { on_text_ = std::move(callback); }
+
+  std::vector<StreamReport> report();
+  // Memory held by one stream's buffers, independent of the model
+  size_t perStreamBytes() const;
+
+private:
+  struct ClientStream;
+
+  void ingestLoop();
+  void decodeSegment(ClientStream &stream, whisper_context *ctx,
+                     whisper_state *state, int n_threads);
+  std::shared_ptr<ClientStream> findStream(const std::string &key,
+                                           const std::string &peer);
+  void handleDatagram(const char *data, size_t size, const std::string &peer);
+  void scheduleIfReady(const std::shared_ptr<ClientStream> &stream);
+  void reapIdleStreams();
+  StreamReport describe(const ClientStream &stream) const;
+
+  InferenceScheduler &scheduler_;
+  whisper_full_params params_;
+  StreamServerOptions options_;
+  size_t segment_samples_;
+
+  int sock_ = -1;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  std::atomic<bool> running_{false};
+  std::mutex stop_mutex_;
+  std::thread ingest_thread_;
+
+  // Ingest inserts, the reaper erases, reporters read
+  std::mutex streams_mutex_;
+  std::unordered_map<std::string, std::shared_ptr<ClientStream>> streams_;
+  int next_stream_id_ = 1;
+
+  // Decode jobs submitted and not yet finished; stop() waits for them
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_cv_;
+  int jobs_in_flight_ = 0;
+
+  TextCallback on_text_;
+};
+
+#endif // STREAM_SERVER_HPP
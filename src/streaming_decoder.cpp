@@ -0,0 +1,315 @@
+#include "streaming_decoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <memory>
+
+// Words may start up to this long before the committed end and still be
+// new text (token timestamps are only ~10-20 ms accurate)
+static constexpr float kOverlapToleranceS = 0.1f;
+// Longest n-gram checked when stripping re-decoded committed words
+static constexpr size_t kMaxOverlapWords = 5;
+
+static std::string normalize_word(const std::string &word) {
+  std::string key;
+  for (unsigned char ch : word) {
+    if (std::isalnum(ch) || ch == '\'') {
+      key += static_cast<char>(std::tolower(ch));
+    }
+  }
+  return key;
+}
+
+StreamingDecoder::StreamingDecoder(InferenceScheduler &scheduler,
+                                   const whisper_full_params &params,
+                                   const StreamingOptions &options)
+    : scheduler_(scheduler), params_(params), options_(options),
+      prompt_(options.prompt_tokens) {
+  float context_s = std::min(options_.context_duration_s, 30.0f);
+  max_window_samples_ = static_cast<size_t>(context_s * options_.sample_rate);
+  // Reserve the cap up front so appending audio never reallocates
+  window_.reserve(max_window_samples_ + options_.sample_rate);
+
+  // Word timings drive both agreement and trimming
+  params_.token_timestamps = true;
+}
+
+void StreamingDecoder::append(const float *samples, size_t count) {
+  window_.insert(window_.end(), samples, samples + count);
+}
+
+void StreamingDecoder::discard(size_t samples) {
+  if (samples < window_.size()) {
+    trimWindow(samples);
+    return;
+  }
+  const size_t beyond = samples - window_.size();
+  trimWindow(window_.size());
+  window_start_ += static_cast<int64_t>(beyond);
+}
+
+void StreamingDecoder::skipAhead(size_t samples) {
+  if (samples == 0) {
+    return;
+  }
+  if (window_.empty()) {
+    window_start_ += static_cast<int64_t>(samples);
+    skipped_ += static_cast<int64_t>(samples);
+  } else {
+    skips_.push_back({window_.size(), static_cast<int64_t>(samples)});
+  }
+}
+
+int64_t StreamingDecoder::sessionMs(int64_t window_ms, bool end) const {
+  const int64_t offset = std::max<int64_t>(0, window_ms) * options_.sample_rate / 1000;
+  const int64_t position = end ? endPositionOf(static_cast<size_t>(offset))
+                               : positionOf(static_cast<size_t>(offset));
+  return position * 1000 / options_.sample_rate;
+}
+
+int64_t StreamingDecoder::endPositionOf(size_t offset) const {
+  return offset == 0 ? positionOf(0) : positionOf(offset - 1) + 1;
+}
+
+int64_t StreamingDecoder::positionOf(size_t offset) const {
+  int64_t position = window_start_ + static_cast<int64_t>(offset);
+  for (const Skip &skip : skips_) {
+    if (skip.at > offset) {
+      break;
+    }
+    position += skip.samples;
+  }
+  return position;
+}
+
+size_t StreamingDecoder::offsetOf(int64_t position) const {
+  int64_t offset = position - window_start_;
+  for (const Skip &skip : skips_) {
+    const int64_t at = static_cast<int64_t>(skip.at);
+    if (offset < at) {
+      break;
+    }
+    if (offset < at + skip.samples) {
+      offset = at;
+      break;
+    }
+    offset -= skip.samples;
+  }
+  return static_cast<size_t>(
+      std::clamp<int64_t>(offset, 0, static_cast<int64_t>(window_.size())));
+}
+
+bool StreamingDecoder::process(Update &update) {
+  update.committed.clear();
+  update.tentative.clear();
+  if (window_.empty()) {
+    return true;
+  }
+
+  // Never decode more than the context cap
+  if (window_.size() > max_window_samples_) {
+    trimWindow(window_.size() - max_window_samples_);
+  }
+
+  whisper_full_params wparams = params_;
+  std::vector<whisper_token> prompt_tokens;
+
+  DecodeSettings settings;
+  settings.scheduler = &scheduler_;
+  if (governor_ != nullptr) {
+    settings = governor_->current();
+  }
+  const bool apply_settings =
+      (overload_ != nullptr && overload_->adjust(settings)) || governor_ != nullptr;
+
+  // whisper skips windows under a second as too short; those still take
+  // the plain path so it can
+  const bool use_mel = options_.incremental_mel &&
+                       options_.sample_rate == IncrementalMel::kSampleRate &&
+                       window_.size() >= static_cast<size_t>(options_.sample_rate);
+
+  bool ok = false;
+  std::vector<Word> words;
+  auto deadline = InferenceScheduler::Clock::now() +
+                  std::chrono::milliseconds(options_.deadline_ms);
+  last_timing_ = settings.scheduler->run(
+      "streaming", deadline,
+      [&](whisper_context *ctx, whisper_state *state, int n_threads) {
+        wparams.n_threads = n_threads;
+        prompt_.apply(ctx, wparams, prompt_tokens);
+        if (apply_settings) {
+          settings.apply(wparams, window_.size(), n_threads, options_.sample_rate);
+        }
+        // A whole whisper segment is still only a hypothesis here
+        std::unique_ptr<DecodeResultStream> results;
+        if (partial_callback_) {
+          // Times come relative to the window and are mapped past any skips
+          results.reset(new DecodeResultStream(
+              [this](const ResultUpdate &result) {
+                if (result.final) {
+                  return;
+                }
+                ResultUpdate update = result;
+                update.t0_ms = sessionMs(update.t0_ms, false);
+                update.t1_ms = sessionMs(update.t1_ms, true);
+                for (ResultToken &token : update.tokens) {
+                  if (token.t0_ms >= 0) {
+                    token.t0_ms = sessionMs(token.t0_ms, false);
+                    token.t1_ms = sessionMs(token.t1_ms, true);
+                  }
+                }
+                partial_callback_(update);
+              },
+              0, static_cast<int64_t>(window_.size()) * 1000 / options_.sample_rate));
+          results->attach(wparams);
+        }
+        if (use_mel) {
+          // whisper decodes up to duration_ms; the frames past it are the
+          // silence padding whisper_pcm_to_mel would have added
+          const int n_mel = whisper_model_n_mels(ctx);
+          if (mel_.nMel() != n_mel) {
+            mel_.reset(n_mel);
+          }
+          int n_len = 0;
+          const int frames = mel_.compute(window_.data(), window_.size(),
+                                          window_start_ - skipped_, mel_buffer_, n_len);
+          wparams.offset_ms = 0;
+          wparams.duration_ms = frames * 10;
+          ok = whisper_set_mel_with_state(ctx, state, mel_buffer_.data(), n_len, n_mel) == 0 &&
+               whisper_full_timed(ctx, state, wparams, nullptr, 0) == 0;
+        } else {
+          ok = whisper_full_timed(ctx, state, wparams, window_.data(),
+                                  static_cast<int>(window_.size())) == 0;
+        }
+        if (ok) {
+          collectWords(ctx, state, words);
+        }
+      });
+  if (!ok) {
+    return false;
+  }
+
+  // Drop words that belong to audio already committed
+  const int64_t tolerance = static_cast<int64_t>(kOverlapToleranceS * options_.sample_rate);
+  words.erase(std::remove_if(words.begin(), words.end(),
+                             [&](const Word &w) {
+                               return w.t0 < committed_end_ - tolerance ||
+                                      w.key.empty();
+                             }),
+              words.end());
+
+  // ...and any committed words that were re-decoded at the window start
+  for (size_t n = std::min({kMaxOverlapWords, words.size(), committed_tail_.size()});
+       n > 0; n--) {
+    bool match = true;
+    for (size_t i = 0; i < n && match; i++) {
+      match = committed_tail_[committed_tail_.size() - n + i].key == words[i].key;
+    }
+    if (match) {
+      words.erase(words.begin(), words.begin() + n);
+      break;
+    }
+  }
+
+  // Local agreement: commit the prefix on which the last two passes agree
+  size_t agreed = 0;
+  while (agreed < words.size() && agreed < hypothesis_.size() &&
+         words[agreed].key == hypothesis_[agreed].key) {
+    agreed++;
+  }
+  update.committed = commit(words, agreed);
+  hypothesis_.assign(words.begin() + agreed, words.end());
+
+  if (window_.size() >= max_window_samples_) {
+    // Out of context: accept the rest rather than let latency grow
+    update.committed += commit(hypothesis_, hypothesis_.size());
+    hypothesis_.clear();
+    trimWindow(window_.size());
+  } else if (agreed > 0) {
+    trimWindow(offsetOf(committed_end_));
+  }
+
+  for (const auto &word : hypothesis_) {
+    update.tentative += word.text;
+  }
+  return true;
+}
+
+std::string StreamingDecoder::flush() {
+  std::string text = commit(hypothesis_, hypothesis_.size());
+  hypothesis_.clear();
+  trimWindow(window_.size());
+  return text;
+}
+
+void StreamingDecoder::collectWords(whisper_context *ctx, whisper_state *state,
+                                    std::vector<Word> &words) const {
+  const whisper_token eot = whisper_token_eot(ctx);
+  const int n_segments = whisper_full_n_segments_from_state(state);
+
+  for (int i = 0; i < n_segments; ++i) {
+    const int n_tokens = whisper_full_n_tokens_from_state(state, i);
+    for (int j = 0; j < n_tokens; ++j) {
+      whisper_token_data data = whisper_full_get_token_data_from_state(state, i, j);
+      if (data.id >= eot) {
+        continue; // special and timestamp tokens
+      }
+
+      std::string text = whisper_full_get_token_text_from_state(ctx, state, i, j);
+      // Timestamps are in 10 ms units relative to the window start
+      int64_t t0 = positionOf(std::max<int64_t>(0, data.t0) * options_.sample_rate / 100);
+      int64_t t1 = endPositionOf(std::max<int64_t>(0, data.t1) * options_.sample_rate / 100);
+
+      if (words.empty() || (!text.empty() && text[0] == ' ')) {
+        words.push_back({text, "", t0, t1});
+      } else {
+        words.back().text += text;
+        words.back().t1 = t1;
+      }
+    }
+  }
+
+  for (auto &word : words) {
+    word.key = normalize_word(word.text);
+  }
+}
+
+std::string StreamingDecoder::commit(const std::vector<Word> &words,
+                                     size_t count) {
+  std::string text;
+  for (size_t i = 0; i < count; i++) {
+    text += words[i].text;
+    committed_end_ = std::max(committed_end_, words[i].t1);
+    committed_tail_.push_back(words[i]);
+  }
+  if (committed_tail_.size() > kMaxOverlapWords) {
+    committed_tail_.erase(committed_tail_.begin(),
+                          committed_tail_.end() - kMaxOverlapWords);
+  }
+
+  // Keep the newest committed text as decoding context
+  prompt_.append(text);
+  return text;
+}
+
+void StreamingDecoder::trimWindow(size_t count) {
+  count = std::min(count, window_.size());
+  // Keep the window a whole number of mel hops from the last one so the
+  // next pass can reuse its spectrogram frames
+  if (count < window_.size()) {
+    count -= count % IncrementalMel::kHop;
+  }
+  const int64_t start = positionOf(count);
+  // Skips at or before the new first sample are now behind the window
+  size_t passed = 0;
+  for (; passed < skips_.size() && skips_[passed].at <= count; passed++) {
+    skipped_ += skips_[passed].samples;
+  }
+  skips_.erase(skips_.begin(), skips_.begin() + passed);
+  for (Skip &skip : skips_) {
+    skip.at -= count;
+  }
+  window_.erase(window_.begin(), window_.begin() + count);
+  window_start_ = start;
+}
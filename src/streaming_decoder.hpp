@@ -0,0 +1,136 @@
+#ifndef STREAMING_DECODER_HPP
+#define STREAMING_DECODER_HPP
+
+#include "compute_governor.hpp"
+#include "inference_scheduler.hpp"
+#include "mel_frontend.hpp"
+#include "overload_guard.hpp"
+#include "partial_results.hpp"
+#include "prompt_ring.hpp"
+#include "whisper.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StreamingOptions {
+  int sample_rate = 16000;
+  // Audio context cap; whisper cannot see more than 30 s anyway
+  float context_duration_s = 30.0f;
+  // Committed text fed back as prompt tokens, 0 for none
+  int prompt_tokens = 64;
+  // Deadline for each pass, normally the recognition interval
+  int deadline_ms = 1000;
+  // Reuse the spectrogram frames of audio decoded on earlier passes
+  bool incremental_mel = true;
+};
+
+// Rolling-window decoder with local agreement.
+//
+// Every tick re-decodes the uncommitted audio window. A word is committed
+// once two consecutive passes agree on it; the window is then trimmed to
+// the end of the last committed word so each pass only covers audio whose
+// text is still in flux. When the window hits the context cap, the current
+// hypothesis is committed as-is.
+class StreamingDecoder {
+public:
+  struct Update {
+    std::string committed; // newly committed text, may be empty
+    std::string tentative; // current uncommitted tail
+  };
+
+  StreamingDecoder(InferenceScheduler &scheduler,
+                   const whisper_full_params &params,
+                   const StreamingOptions &options);
+
+  // Take model, sampling and thread settings from `governor` on every
+  // pass; the caller reports each pass back to it
+  void setGovernor(ComputeGovernor *governor) { governor_ = governor; }
+  // Let `overload` cheapen passes while the capture backlog is too long
+  void setOverloadGuard(OverloadGuard *overload) { overload_ = overload; }
+  // Text of each pass as it is decoded, before agreement runs; only
+  // tentative updates are passed on, commits still come from process()
+  void setPartialCallback(ResultCallback callback) { partial_callback_ = std::move(callback); }
+  // Timing of the last pass
+  const JobTiming &lastTiming() const { return last_timing_; }
+  const MelFrontendStats &melStats() const { return mel_.stats(); }
+
+  // New audio, contiguous with everything appended or discarded before
+  void append(const float *samples, size_t count);
+  // Skip the next `samples` of the stream without decoding them: the oldest
+  // audio in the window first, then audio the caller never appended, such
+  // as silence or an overload gap. Later audio keeps its stream position;
+  // within the window, up to a mel hop is kept as trimming does.
+  void discard(size_t samples);
+  // Advance the stream clock by `samples` the caller cut out of audio it
+  // has not appended yet, such as compacted silence. The window keeps its
+  // audio; later audio and its word timings move past the cut.
+  void skipAhead(size_t samples);
+  // Audio not yet committed, and the stream position of its first sample
+  const std::vector<float> &window() const { return window_; }
+  int64_t windowStart() const { return window_start_; }
+  size_t maxWindowSamples() const { return max_window_samples_; }
+
+  // Decode the current window; false if whisper_full failed
+  bool process(Update &update);
+  // Commit whatever is still tentative, e.g. at shutdown
+  std::string flush();
+  // Forget the committed text, e.g. once audio has been skipped
+  void clearPrompt() { prompt_.clear(); }
+  const PromptRing &prompt() const { return prompt_; }
+
+private:
+  struct Word {
+    std::string text;
+    std::string key; // lowercase, punctuation stripped
+    int64_t t0 = 0;  // absolute sample positions
+    int64_t t1 = 0;
+  };
+
+  void collectWords(whisper_context *ctx, whisper_state *state,
+                    std::vector<Word> &words) const;
+  std::string commit(const std::vector<Word> &words, size_t count);
+  // Drop the first `count` samples of the window
+  void trimWindow(size_t count);
+  // Stream position of window_[offset], and the window offset of a stream
+  // position; a position inside a skip maps to where the audio resumes
+  int64_t positionOf(size_t offset) const;
+  size_t offsetOf(int64_t position) const;
+  // One past the stream position of window_[offset - 1], for span ends,
+  // which must not reach past a skip that follows them
+  int64_t endPositionOf(size_t offset) const;
+  // A time in ms from the window start as session ms
+  int64_t sessionMs(int64_t window_ms, bool end) const;
+
+  InferenceScheduler &scheduler_;
+  ComputeGovernor *governor_ = nullptr;
+  OverloadGuard *overload_ = nullptr;
+  ResultCallback partial_callback_;
+  JobTiming last_timing_;
+  whisper_full_params params_;
+  StreamingOptions options_;
+  size_t max_window_samples_;
+
+  // Stream clock skipped at window offset `at`, before that sample
+  struct Skip {
+    size_t at;
+    int64_t samples;
+  };
+
+  std::vector<float> window_;
+  int64_t window_start_ = 0; // absolute sample index of window_[0]
+  std::vector<Skip> skips_;  // inside the window, in order
+  // Skipped samples already behind the window; window_start_ minus this
+  // counts only audio, which is what the mel cache is keyed on
+  int64_t skipped_ = 0;
+
+  IncrementalMel mel_;
+  std::vector<float> mel_buffer_;
+
+  std::vector<Word> hypothesis_; // previous pass, uncommitted part
+  std::vector<Word> committed_tail_;
+  int64_t committed_end_ = 0;
+  PromptRing prompt_;
+};
+
+#endif // STREAMING_DECODER_HPP
@@ -0,0 +1,672 @@
+#include "subtitle_publisher.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+// Input a subscriber may leave unparsed before it is dropped
+static constexpr size_t kMaxInputBytes = 64 * 1024;
+// TCP clients that say nothing this long are raw line subscribers
+static constexpr auto kProtocolSniff = std::chrono::milliseconds(200);
+static const char *kWebSocketGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+enum class SubscriberKind {
+  Pending,   // TCP, not yet known to be raw or WebSocket
+  Handshake, // WebSocket upgrade request still arriving
+  Raw,       // JSON lines
+  WebSocket, // one text frame per message
+};
+
+struct SubtitlePublisher::Subscriber {
+  int fd = -1;
+  SubscriberKind kind = SubscriberKind::Raw;
+  Clock::time_point connected;
+  std::string in;
+  std::string out;
+  size_t out_sent = 0;
+
+  double rate_hz = 0.0;
+  Clock::time_point last_sent;
+  uint64_t seq = 0;
+  bool snapshot_sent = false;
+  // What this subscriber has been told so far
+  uint64_t version = 0;
+  uint64_t committed_sent = 0; // absolute byte offset into the transcript
+  std::string tail_sent;
+};
+
+static uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+// Only used for the WebSocket accept key
+static std::string sha1(const std::string &data) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  std::string msg = data;
+  const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+  msg += static_cast<char>(0x80);
+  while (msg.size() % 64 != 56) {
+    msg += '\0';
+  }
+  for (int i = 7; i >= 0; i--) {
+    msg += static_cast<char>((bits >> (i * 8)) & 0xff);
+  }
+
+  for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const unsigned char *p = reinterpret_cast<const unsigned char *>(&msg[chunk + 4 * i]);
+      w[i] = static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+             static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+    }
+    for (int i = 16; i < 80; i++) {
+      w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      const uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::string digest(20, '\0');
+  for (int i = 0; i < 20; i++) {
+    digest[i] = static_cast<char>((h[i / 4] >> (24 - 8 * (i % 4))) & 0xff);
+  }
+  return digest;
+}
+
+static std::string base64(const std::string &data) {
+  static const char *table =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t v = static_cast<uint8_t>(data[i]) << 16;
+    if (i + 1 < data.size()) {
+      v |= static_cast<uint8_t>(data[i + 1]) << 8;
+    }
+    if (i + 2 < data.size()) {
+      v |= static_cast<uint8_t>(data[i + 2]);
+    }
+    out += table[(v >> 18) & 63];
+    out += table[(v >> 12) & 63];
+    out += i + 1 < data.size() ? table[(v >> 6) & 63] : '=';
+    out += i + 2 < data.size() ? table[v & 63] : '=';
+  }
+  return out;
+}
+
+// Largest n <= pos that does not split a UTF-8 sequence in `s`
+static size_t utf8_boundary(const std::string &s, size_t pos) {
+  while (pos > 0 && pos < s.size() && (static_cast<unsigned char>(s[pos]) & 0xC0) == 0x80) {
+    pos--;
+  }
+  return pos;
+}
+
+static void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+SubtitlePublisher::SubtitlePublisher(const SubtitleOptions &options) : options_(options) {}
+
+SubtitlePublisher::~SubtitlePublisher() { stop(); }
+
+bool SubtitlePublisher::start() {
+  if (!options_.unix_path.empty()) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (options_.unix_path.size() >= sizeof(addr.sun_path)) {
+      std::cerr << "Subtitle socket path too long: " << options_.unix_path << std::endl;
+      return false;
+    }
+    std::strcpy(addr.sun_path, options_.unix_path.c_str());
+    // A stale socket from an earlier run would make bind() fail
+    unlink(options_.unix_path.c_str());
+    unix_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (unix_fd_ < 0 ||
+        bind(unix_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(unix_fd_, 8) < 0) {
+      std::cerr << "Failed to serve subtitles on " << options_.unix_path << ": "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+    set_nonblocking(unix_fd_);
+    std::cout << "Subtitles on unix:" << options_.unix_path << std::endl;
+  }
+
+  if (options_.tcp_port > 0) {
+    tcp_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(options_.tcp_port));
+    if (tcp_fd_ < 0 ||
+        bind(tcp_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(tcp_fd_, 8) < 0) {
+      std::cerr << "Failed to serve subtitles on port " << options_.tcp_port << ": "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+    set_nonblocking(tcp_fd_);
+    std::cout << "Subtitles on tcp://127.0.0.1:" << options_.tcp_port
+              << " and ws://127.0.0.1:" << options_.tcp_port << "/" << std::endl;
+  }
+
+  if (unix_fd_ < 0 && tcp_fd_ < 0) {
+    return true; // nothing to serve
+  }
+  if (pipe(wake_pipe_) != 0) {
+    std::cerr << "Failed to create subtitle wake pipe" << std::endl;
+    return false;
+  }
+  set_nonblocking(wake_pipe_[0]);
+  running_ = true;
+  thread_ = std::thread(&SubtitlePublisher::loop, this);
+  return true;
+}
+
+void SubtitlePublisher::stop() {
+  if (running_.exchange(false)) {
+    const char wake = 1;
+    if (write(wake_pipe_[1], &wake, 1) < 0) {
+      std::cerr << "Failed to wake subtitle thread" << std::endl;
+    }
+  }
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  for (auto &sub : subscribers_) {
+    ::close(sub->fd);
+  }
+  subscribers_.clear();
+  for (int *fd : {&unix_fd_, &tcp_fd_, &wake_pipe_[0], &wake_pipe_[1]}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+  if (!options_.unix_path.empty()) {
+    unlink(options_.unix_path.c_str());
+  }
+}
+
+void SubtitlePublisher::commit(const std::string &text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (text.empty() && tail_.empty()) {
+      return;
+    }
+    // Segments usually start with a space; keep words apart if not
+    if (!text.empty() && !committed_.empty() &&
+        !std::isspace(static_cast<unsigned char>(committed_.back())) &&
+        !std::isspace(static_cast<unsigned char>(text.front()))) {
+      committed_ += ' ';
+    }
+    committed_ += text;
+    tail_.clear();
+    version_++;
+    stats_.updates++;
+  }
+  wake();
+}
+
+void SubtitlePublisher::setTentative(const std::string &text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (text == tail_) {
+      return;
+    }
+    tail_ = text;
+    version_++;
+    stats_.updates++;
+  }
+  wake();
+}
+
+SubtitleStats SubtitlePublisher::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void SubtitlePublisher::wake() {
+  // One byte in the pipe is enough however many updates arrive
+  if (running_ && !wake_pending_.exchange(true)) {
+    const char wake = 1;
+    if (write(wake_pipe_[1], &wake, 1) < 0) {
+      wake_pending_ = false;
+    }
+  }
+}
+
+void SubtitlePublisher::loop() {
+  std::vector<struct pollfd> fds;
+  while (running_) {
+    const auto now = Clock::now();
+
+    // Build diffs for every subscriber that is due and has drained its
+    // last message, and work out when the next one falls due
+    uint64_t version;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      version = version_;
+    }
+    Clock::time_point next = Clock::time_point::max();
+    for (auto &sub : subscribers_) {
+      if (sub->kind == SubscriberKind::Pending) {
+        next = std::min(next, sub->connected + kProtocolSniff);
+        continue;
+      }
+      if (sub->kind == SubscriberKind::Handshake || !sub->out.empty() ||
+          (sub->snapshot_sent && sub->version == version)) {
+        continue;
+      }
+      const auto due = sub->snapshot_sent && sub->rate_hz > 0.0
+                           ? sub->last_sent + std::chrono::duration_cast<Clock::duration>(
+                                                  std::chrono::duration<double>(1.0 / sub->rate_hz))
+                           : now;
+      if (due <= now) {
+        buildUpdate(*sub);
+        sub->last_sent = now;
+      } else {
+        next = std::min(next, due);
+      }
+    }
+    trimCommitted();
+
+    fds.clear();
+    fds.push_back({wake_pipe_[0], POLLIN, 0});
+    fds.push_back({unix_fd_, POLLIN, 0});
+    fds.push_back({tcp_fd_, POLLIN, 0});
+    for (auto &sub : subscribers_) {
+      fds.push_back({sub->fd, static_cast<short>(POLLIN | (sub->out.empty() ? 0 : POLLOUT)), 0});
+    }
+
+    int timeout = -1;
+    if (next != Clock::time_point::max()) {
+      timeout = static_cast<int>(std::max<int64_t>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1, 0));
+    }
+    if (poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Subtitle poll failed: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char drain[64];
+      while (read(wake_pipe_[0], drain, sizeof(drain)) > 0) {
+      }
+      wake_pending_ = false;
+    }
+    const auto polled = Clock::now();
+    // Subscribers accepted below were not part of this poll
+    const size_t polled_subscribers = subscribers_.size();
+    for (size_t i = 0; i < polled_subscribers; i++) {
+      Subscriber &sub = *subscribers_[i];
+      const short revents = fds[3 + i].revents;
+      bool alive = !(revents & (POLLERR | POLLNVAL));
+      if (alive && (revents & (POLLIN | POLLHUP))) {
+        alive = readFrom(sub, polled);
+      }
+      if (alive && sub.kind == SubscriberKind::Pending &&
+          polled - sub.connected >= kProtocolSniff) {
+        sub.kind = SubscriberKind::Raw;
+      }
+      if (alive && !sub.out.empty()) {
+        alive = writeTo(sub);
+      }
+      if (!alive) {
+        ::close(sub.fd);
+        sub.fd = -1;
+      }
+    }
+    subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(),
+                                      [](const std::unique_ptr<Subscriber> &sub) {
+                                        return sub->fd < 0;
+                                      }),
+                       subscribers_.end());
+    if (fds[1].revents & POLLIN) {
+      acceptFrom(unix_fd_, false);
+    }
+    if (fds[2].revents & POLLIN) {
+      acceptFrom(tcp_fd_, true);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.subscribers = subscribers_.size();
+    }
+  }
+}
+
+void SubtitlePublisher::acceptFrom(int listen_fd, bool tcp) {
+  for (;;) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+    if (subscribers_.size() >= static_cast<size_t>(std::max(1, options_.max_subscribers))) {
+      ::close(fd);
+      continue;
+    }
+    set_nonblocking(fd);
+    auto sub = std::make_unique<Subscriber>();
+    sub->fd = fd;
+    // TCP serves raw lines and WebSocket on one port, so wait briefly to
+    // see whether the client opens with an upgrade request
+    sub->kind = tcp ? SubscriberKind::Pending : SubscriberKind::Raw;
+    sub->connected = Clock::now();
+    sub->rate_hz = options_.default_rate_hz;
+    subscribers_.push_back(std::move(sub));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.subscribers_total++;
+  }
+}
+
+bool SubtitlePublisher::readFrom(Subscriber &sub, Clock::time_point now) {
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = recv(sub.fd, buffer, sizeof(buffer), 0);
+    if (n == 0) {
+      return false;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      return errno == EINTR;
+    }
+    sub.in.append(buffer, static_cast<size_t>(n));
+    if (sub.in.size() > kMaxInputBytes) {
+      return false;
+    }
+  }
+
+  if (sub.kind == SubscriberKind::Pending) {
+    if (sub.in.size() < 4 && now - sub.connected < kProtocolSniff) {
+      return true;
+    }
+    sub.kind = sub.in.compare(0, 4, "GET ") == 0 ? SubscriberKind::Handshake
+                                                  : SubscriberKind::Raw;
+  }
+  switch (sub.kind) {
+  case SubscriberKind::Handshake:
+    return parseHandshake(sub);
+  case SubscriberKind::WebSocket:
+    return parseFrames(sub);
+  case SubscriberKind::Raw: {
+    size_t end;
+    while ((end = sub.in.find('\n')) != std::string::npos) {
+      std::string line = sub.in.substr(0, end);
+      sub.in.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      command(sub, line);
+    }
+    return true;
+  }
+  case SubscriberKind::Pending:
+    break;
+  }
+  return true;
+}
+
+bool SubtitlePublisher::parseHandshake(Subscriber &sub) {
+  const size_t end = sub.in.find("\r\n\r\n");
+  if (end == std::string::npos) {
+    return true;
+  }
+  std::string request = sub.in.substr(0, end);
+  sub.in.erase(0, end + 4);
+
+  std::string key;
+  size_t line_start = request.find("\r\n");
+  const std::string request_line = request.substr(0, line_start);
+  while (line_start != std::string::npos) {
+    line_start += 2;
+    size_t line_end = request.find("\r\n", line_start);
+    std::string line = request.substr(line_start, line_end - line_start);
+    line_start = line_end;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name == "sec-websocket-key") {
+      key = line.substr(colon + 1);
+      key.erase(0, key.find_first_not_of(" \t"));
+      key.erase(key.find_last_not_of(" \t") + 1);
+    }
+  }
+
+  if (key.empty()) {
+    const char *reply = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send(sub.fd, reply, std::strlen(reply), MSG_NOSIGNAL);
+    return false;
+  }
+
+  // GET /?rate=5 HTTP/1.1
+  const size_t rate = request_line.find("rate=");
+  if (rate != std::string::npos) {
+    command(sub, "rate " + request_line.substr(rate + 5, request_line.find_first_of(" &", rate) - rate - 5));
+  }
+
+  sub.out += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+             "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+             base64(sha1(key + kWebSocketGuid)) + "\r\n\r\n";
+  sub.kind = SubscriberKind::WebSocket;
+  return parseFrames(sub);
+}
+
+bool SubtitlePublisher::parseFrames(Subscriber &sub) {
+  while (sub.in.size() >= 2) {
+    const uint8_t b0 = static_cast<uint8_t>(sub.in[0]);
+    const uint8_t b1 = static_cast<uint8_t>(sub.in[1]);
+    const int opcode = b0 & 0x0f;
+    const bool masked = (b1 & 0x80) != 0;
+    uint64_t length = b1 & 0x7f;
+    size_t pos = 2;
+    if (length == 126 || length == 127) {
+      const size_t bytes = length == 126 ? 2 : 8;
+      if (sub.in.size() < pos + bytes) {
+        return true;
+      }
+      length = 0;
+      for (size_t i = 0; i < bytes; i++) {
+        length = length << 8 | static_cast<uint8_t>(sub.in[pos + i]);
+      }
+      pos += bytes;
+    }
+    if (length > kMaxInputBytes) {
+      return false;
+    }
+    const size_t mask_pos = pos;
+    if (masked) {
+      pos += 4;
+    }
+    if (sub.in.size() < pos + length) {
+      return true;
+    }
+
+    std::string payload = sub.in.substr(pos, length);
+    if (masked) {
+      for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = static_cast<char>(payload[i] ^ sub.in[mask_pos + i % 4]);
+      }
+    }
+    sub.in.erase(0, pos + length);
+
+    if (opcode == 0x1) {
+      command(sub, payload);
+    } else if (opcode == 0x8) {
+      return false;
+    } else if (opcode == 0x9) {
+      // Pong with the ping's payload (pings are at most 125 bytes)
+      sub.out += static_cast<char>(0x8A);
+      sub.out += static_cast<char>(std::min<size_t>(payload.size(), 125));
+      sub.out += payload.substr(0, 125);
+    }
+  }
+  return true;
+}
+
+void SubtitlePublisher::command(Subscriber &sub, const std::string &line) {
+  if (line.compare(0, 5, "rate ") == 0) {
+    try {
+      sub.rate_hz = std::max(0.0, std::stod(line.substr(5)));
+    } catch (const std::exception &) {
+      // Ignore a malformed rate and keep the current one
+    }
+  }
+}
+
+bool SubtitlePublisher::writeTo(Subscriber &sub) {
+  while (sub.out_sent < sub.out.size()) {
+    ssize_t n = send(sub.fd, sub.out.data() + sub.out_sent, sub.out.size() - sub.out_sent,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    sub.out_sent += static_cast<size_t>(n);
+  }
+  sub.out.clear();
+  sub.out_sent = 0;
+  return true;
+}
+
+void SubtitlePublisher::queueMessage(Subscriber &sub, const std::string &payload) {
+  if (sub.kind == SubscriberKind::WebSocket) {
+    // Unmasked text frame, as servers send them
+    sub.out += static_cast<char>(0x81);
+    if (payload.size() < 126) {
+      sub.out += static_cast<char>(payload.size());
+    } else if (payload.size() <= 0xffff) {
+      sub.out += static_cast<char>(126);
+      sub.out += static_cast<char>((payload.size() >> 8) & 0xff);
+      sub.out += static_cast<char>(payload.size() & 0xff);
+    } else {
+      sub.out += static_cast<char>(127);
+      for (int i = 7; i >= 0; i--) {
+        sub.out += static_cast<char>((static_cast<uint64_t>(payload.size()) >> (8 * i)) & 0xff);
+      }
+    }
+    sub.out += payload;
+  } else {
+    sub.out += payload;
+    sub.out += '\n';
+  }
+  stats_.messages++;
+  stats_.bytes_sent += payload.size();
+}
+
+void SubtitlePublisher::buildUpdate(Subscriber &sub) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  nlohmann::ordered_json message;
+  message["s"] = sub.seq;
+
+  const uint64_t committed_end = committed_base_ + committed_.size();
+  if (!sub.snapshot_sent) {
+    size_t start = committed_.size() - std::min(committed_.size(), options_.snapshot_bytes);
+    while (start < committed_.size() &&
+           (static_cast<unsigned char>(committed_[start]) & 0xC0) == 0x80) {
+      start++;
+    }
+    message["r"] = 1;
+    message["a"] = committed_.substr(start);
+    message["t"] = tail_;
+    sub.snapshot_sent = true;
+  } else {
+    // Trimming never drops text a subscriber has not been sent
+    const std::string appended = committed_.substr(sub.committed_sent - committed_base_);
+    const bool tail_changed = sub.tail_sent != tail_;
+    if (appended.empty() && !tail_changed) {
+      sub.version = version_;
+      return;
+    }
+    if (!appended.empty()) {
+      message["a"] = appended;
+    }
+    if (tail_changed) {
+      size_t keep = 0;
+      while (keep < sub.tail_sent.size() && keep < tail_.size() &&
+             sub.tail_sent[keep] == tail_[keep]) {
+        keep++;
+      }
+      keep = utf8_boundary(tail_, keep);
+      message["k"] = keep;
+      message["t"] = tail_.substr(keep);
+    }
+  }
+
+  sub.committed_sent = committed_end;
+  sub.tail_sent = tail_;
+  sub.version = version_;
+  sub.seq++;
+  // Whisper can emit a partial UTF-8 sequence; never let that throw
+  queueMessage(sub, message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+}
+
+void SubtitlePublisher::trimCommitted() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint64_t committed_end = committed_base_ + committed_.size();
+  uint64_t keep_from = committed_end - std::min<uint64_t>(committed_end, options_.snapshot_bytes);
+  for (const auto &sub : subscribers_) {
+    if (sub->snapshot_sent) {
+      keep_from = std::min(keep_from, sub->committed_sent);
+    }
+  }
+  if (keep_from > committed_base_) {
+    committed_.erase(0, keep_from - committed_base_);
+    committed_base_ = keep_from;
+  }
+}
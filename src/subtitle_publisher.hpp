@@ -0,0 +1,109 @@
+#ifndef SUBTITLE_PUBLISHER_HPP
+#define SUBTITLE_PUBLISHER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SubtitleOptions {
+  // Unix stream socket for local bridges; empty = off
+  std::string unix_path;
+  // TCP port on 127.0.0.1 for raw JSON lines or WebSocket; 0 = off
+  int tcp_port = 0;
+  // Updates per second a subscriber gets unless it asks for another rate;
+  // everything in between is coalesced. 0 sends every change.
+  double default_rate_hz = 10.0;
+  // Committed text a new subscriber starts with, in bytes
+  size_t snapshot_bytes = 240;
+  int max_subscribers = 16;
+};
+
+struct SubtitleStats {
+  uint64_t updates = 0;  // commit() and setTentative() calls
+  uint64_t messages = 0; // diffs and snapshots sent, over all subscribers
+  uint64_t bytes_sent = 0;
+  uint64_t subscribers_total = 0;
+  size_t subscribers = 0;
+};
+
+// Live subtitles for any number of local subscribers.
+//
+// The transcript is committed text, which only grows, plus a tentative
+// tail that may be revised. Each subscriber gets a snapshot on connect and
+// then one JSON object per message (a line, or a WebSocket text frame)
+// describing what changed since the last one it received:
+//
+//   {"s":0,"r":1,"a":"...recent text","t":" tail"}   snapshot (r = reset)
+//   {"s":1,"a":" appended words","k":3,"t":"vised tail"}
+//
+// `s` counts messages per subscriber, `a` is appended to the committed
+// text, and `k` bytes of the previous tail are kept before the new tail `t`
+// (absent when the tail is unchanged). Changes are coalesced so a
+// subscriber never gets more than its rate, and never more than its socket
+// takes: a new diff is only built once the previous one is written.
+//
+// Subscribers set their rate by sending "rate <hz>" (a line, or a text
+// frame; WebSocket clients may also connect to /?rate=<hz>).
+class SubtitlePublisher {
+public:
+  explicit SubtitlePublisher(const SubtitleOptions &options);
+  ~SubtitlePublisher();
+
+  SubtitlePublisher(const SubtitlePublisher &) = delete;
+  SubtitlePublisher &operator=(const SubtitlePublisher &) = delete;
+
+  bool start();
+  void stop();
+
+  // Append final text; the tentative tail is cleared
+  void commit(const std::string &text);
+  // Replace the tentative tail
+  void setTentative(const std::string &text);
+
+  SubtitleStats stats() const;
+
+private:
+  struct Subscriber;
+  using Clock = std::chrono::steady_clock;
+
+  void wake();
+  void loop();
+  void acceptFrom(int listen_fd, bool tcp);
+  bool readFrom(Subscriber &sub, Clock::time_point now);
+  bool parseHandshake(Subscriber &sub);
+  bool parseFrames(Subscriber &sub);
+  void command(Subscriber &sub, const std::string &line);
+  bool writeTo(Subscriber &sub);
+  void queueMessage(Subscriber &sub, const std::string &payload);
+  void buildUpdate(Subscriber &sub);
+  void trimCommitted();
+
+  SubtitleOptions options_;
+
+  // Transcript, written by the pipeline and read by the publisher thread.
+  // committed_ holds the bytes from committed_base_ on; older text has
+  // been sent to every subscriber and dropped.
+  mutable std::mutex mutex_;
+  std::string committed_;
+  uint64_t committed_base_ = 0;
+  std::string tail_;
+  uint64_t version_ = 0;
+  SubtitleStats stats_;
+
+  // Publisher thread only
+  std::vector<std::unique_ptr<Subscriber>> subscribers_;
+
+  int unix_fd_ = -1;
+  int tcp_fd_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+  std::atomic<bool> wake_pending_{false};
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+#endif // SUBTITLE_PUBLISHER_HPP
@@ -0,0 +1,35 @@
+#include "text_filter.hpp"
+
+std::string removeParens(const std::string &input) {
+  std::string result;
+  std::string current_token;
+  bool discardRound = false;
+  bool discardSquare = false;
+
+  for (char ch : input) {
+    if (ch == '(') {
+      discardRound = true;
+    } else if (ch == ')') {
+      discardRound = false;
+    } else if (ch == '[') {
+      discardSquare = true;
+    } else if (ch == ']') {
+      discardSquare = false;
+    } else if (!discardRound && !discardSquare) {
+      if (ch == ' ') {
+        if (!current_token.empty()) {
+          result += current_token + " ";
+          current_token.clear();
+        }
+      } else {
+        current_token += ch;
+      }
+    }
+  }
+
+  if (!current_token.empty()) {
+    result += current_token;
+  }
+
+  return result;
+}
@@ -0,0 +1,10 @@
+#ifndef TEXT_FILTER_HPP
+#define TEXT_FILTER_HPP
+
+#include <string>
+
+// Drops whisper's (sound) and [annotation] spans and collapses the spaces
+// they leave behind
+std::string removeParens(const std::string &input);
+
+#endif // TEXT_FILTER_HPP
@@ -0,0 +1,127 @@
+#include "translation_cache.hpp"
+
+#include <cctype>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+static std::string make_key(const std::string& target, const std::string& normalized) {
+    return target + '\n' + normalized;
+}
+
+TranslationCache::TranslationCache(size_t capacity, const std::string& persist_path)
+    : capacity_(capacity), persist_path_(persist_path) {
+    if (!persist_path_.empty()) {
+        load();
+    }
+}
+
+std::string TranslationCache::normalize(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    bool pending_space = false;
+    for (unsigned char ch : text) {
+        if (std::isspace(ch)) {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out += ' ';
+            pending_space = false;
+        }
+        out += static_cast<char>(ch);
+    }
+    return out;
+}
+
+bool TranslationCache::lookup(const std::string& target, const std::string& text, std::string& out) {
+    const std::string key = make_key(target, normalize(text));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    out = it->second->second;
+    stats_.hits++;
+    return true;
+}
+
+void TranslationCache::insert(const std::string& target, const std::string& text,
+                              const std::string& translation) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    const std::string normalized = normalize(text);
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(make_key(target, normalized), translation);
+
+    if (log_.is_open()) {
+        log_ << json{{"t", target}, {"q", normalized}, {"r", translation}}.dump() << '\n';
+        log_.flush();
+    }
+}
+
+void TranslationCache::insertLocked(const std::string& key, const std::string& translation) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->second = translation;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    lru_.emplace_front(key, translation);
+    index_[key] = lru_.begin();
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+}
+
+TranslationCache::Stats TranslationCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.entries = lru_.size();
+    return stats;
+}
+
+void TranslationCache::load() {
+    std::ifstream in(persist_path_);
+    std::string line;
+    size_t loaded = 0;
+    while (std::getline(in, line)) {
+        try {
+            json entry = json::parse(line);
+            insertLocked(make_key(entry["t"], entry["q"]), entry["r"]);
+            loaded++;
+        } catch (const std::exception&) {
+            // A torn last line from a crash; skip it
+        }
+    }
+    in.close();
+
+    // Rewrite the log with only what survived eviction, oldest first
+    log_.open(persist_path_, std::ios::trunc);
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) {
+        size_t split = it->first.find('\n');
+        log_ << json{{"t", it->first.substr(0, split)},
+                     {"q", it->first.substr(split + 1)},
+                     {"r", it->second}}.dump()
+             << '\n';
+    }
+    log_.flush();
+    stats_.evictions = 0;
+
+    if (!log_.is_open()) {
+        std::cerr << "Failed to open translation cache: " << persist_path_ << std::endl;
+    } else if (loaded > 0) {
+        std::cout << "Loaded " << lru_.size() << " cached translations from "
+                  << persist_path_ << std::endl;
+    }
+}
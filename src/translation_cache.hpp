@@ -0,0 +1,56 @@
+#ifndef TRANSLATION_CACHE_HPP
+#define TRANSLATION_CACHE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// LRU cache of translations keyed by target language and normalized text.
+//
+// With a persist path, every insert is appended to a JSON-lines log that is
+// replayed (and compacted) on the next start, so repeated phrases survive
+// restarts without another API call.
+class TranslationCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+
+        double hitRate() const {
+            return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    explicit TranslationCache(size_t capacity, const std::string& persist_path = "");
+
+    bool lookup(const std::string& target, const std::string& text, std::string& out);
+    void insert(const std::string& target, const std::string& text, const std::string& translation);
+
+    Stats stats() const;
+
+    // Collapse runs of whitespace and trim, so re-decoded text that only
+    // differs in spacing still hits
+    static std::string normalize(const std::string& text);
+
+private:
+    using Entry = std::pair<std::string, std::string>; // key, translation
+
+    void insertLocked(const std::string& key, const std::string& translation);
+    void load();
+
+    size_t capacity_;
+    std::string persist_path_;
+    std::ofstream log_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // most recent first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    Stats stats_;
+};
+
+#endif // TRANSLATION_CACHE_HPP
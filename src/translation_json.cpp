@@ -0,0 +1,45 @@
+#include "translation_json.hpp"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+std::string build_translation_request(const std::string& target,
+                                      const std::vector<std::string>& texts) {
+    json requestBody = {
+        {"target", target},
+        {"format", "text"}
+    };
+    if (texts.size() == 1) {
+        requestBody["q"] = texts.front();
+    } else {
+        requestBody["q"] = texts;
+    }
+    return requestBody.dump();
+}
+
+bool parse_translations(const std::string& response, size_t expected,
+                        std::vector<std::string>& out, std::string& error) {
+    try {
+        json jsonResponse = json::parse(response);
+
+        if (jsonResponse.contains("error")) {
+            error = jsonResponse["error"]["message"].dump();
+            return false;
+        }
+
+        const json& translations = jsonResponse["data"]["translations"];
+        if (translations.size() != expected) {
+            error = "expected " + std::to_string(expected) + " translations, got " +
+                    std::to_string(translations.size());
+            return false;
+        }
+        out.clear();
+        for (const auto& translation : translations) {
+            out.push_back(translation["translatedText"]);
+        }
+    } catch (const std::exception& e) {
+        error = std::string("JSON parsing error: ") + e.what();
+        return false;
+    }
+    return true;
+}
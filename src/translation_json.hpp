@@ -0,0 +1,19 @@
+#ifndef TRANSLATION_JSON_HPP
+#define TRANSLATION_JSON_HPP
+
+#include <string>
+#include <vector>
+
+// Google Translate v2 wire format, kept apart from the HTTP client so it
+// can be exercised without curl.
+
+// Request body: a single text as a string, several as a q array
+std::string build_translation_request(const std::string& target,
+                                      const std::vector<std::string>& texts);
+
+// Translations in request order; false with `error` set on an error
+// response, malformed JSON or the wrong number of translations
+bool parse_translations(const std::string& response, size_t expected,
+                        std::vector<std::string>& out, std::string& error);
+
+#endif // TRANSLATION_JSON_HPP
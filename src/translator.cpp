@@ -1,10 +1,11 @@
 #include "translator.hpp"
+#include "translation_json.hpp"
 #include <iostream>
 #include <curl/curl.h>
-#include <nlohmann/json.hpp>
+#include <algorithm>
 #include <cstdlib>
 
-using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
 
 
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* out) {
@@ -13,69 +14,354 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::stri
     return totalSize;
 }
 
-bool translate_text(const std::string& target, const std::string& english_text, std::string& out) {
-    if (target.empty() || english_text.empty()) {
-        return false;
+struct Translator::Request {
+    std::vector<Item> items;
+    std::string body;
+    std::string response;
+};
+
+Translator::Translator(const TranslatorOptions& options) : options_(options) {
+    if (options_.api_key.empty()) {
+        const char* api_key = std::getenv("GOOGLE_TRANSLATE_API_KEY");
+        if (api_key) {
+            options_.api_key = api_key;
+        }
     }
 
-    const char* api_key = std::getenv("GOOGLE_TRANSLATE_API_KEY");
-    if (!api_key) {
+    if (options_.api_key.empty() && options_.endpoint == TranslatorOptions().endpoint) {
         std::cerr << "Error: GOOGLE_TRANSLATE_API_KEY environment variable not set" << std::endl;
-        return false;
     }
 
-    const std::string apiUrl = "https://translation.googleapis.com/language/translate/v2";
-    const std::string apiKey = api_key;
+    url_ = options_.endpoint;
+    if (!options_.api_key.empty()) {
+        url_ += (url_.find('?') == std::string::npos ? "?key=" : "&key=") + options_.api_key;
+    }
+    options_.max_batch = std::max<size_t>(options_.max_batch, 1);
 
-    json requestBody = {
-        {"q", english_text},
-        {"target", target},
-        {"format", "text"}
-    };
-    std::string jString = requestBody.dump();
+    if (options_.cache_capacity > 0) {
+        cache_ = std::make_unique<TranslationCache>(options_.cache_capacity, options_.cache_path);
+    }
 
-    std::string response;
-    CURL* curl = curl_easy_init();
-    if (!curl) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi_ = curl_multi_init();
+    if (!multi_) {
         std::cerr << "Failed to initialize CURL" << std::endl;
-        return false;
+        return;
     }
+    // Multiplex concurrent requests over one HTTP/2 connection when the
+    // server supports it, and keep at most a few connections around
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(options_.max_in_flight));
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers_ = curl_slist_append(headers_, "Content-Type: application/json");
+    ready_ = true;
+    worker_ = std::thread(&Translator::run, this);
+}
 
-    std::string fullUrl = apiUrl + "?key=" + apiKey;
+Translator::~Translator() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    if (multi_) {
+        curl_multi_wakeup(multi_);
+    }
+    if (worker_.joinable()) {
+        worker_.join();
+    }
 
-    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jString.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, jString.size());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    for (CURL* easy : idle_handles_) {
+        curl_easy_cleanup(easy);
+    }
+    if (multi_) {
+        curl_multi_cleanup(multi_);
+    }
+    curl_slist_free_all(headers_);
+}
 
-    CURLcode res = curl_easy_perform(curl);
+void Translator::translate(const std::string& target, const std::string& text, Callback callback,
+                           std::chrono::milliseconds deadline) {
+    Item item;
+    item.target = target;
+    item.text = text;
+    item.callback = std::move(callback);
+    item.submitted = Clock::now();
+    item.deadline = item.submitted + (deadline.count() > 0 ? deadline : options_.default_deadline);
 
-    if (res != CURLE_OK) {
-        std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-        curl_easy_cleanup(curl);
-        return false;
+    if (!ready_ || target.empty() || text.empty()) {
+        complete(item, false, "", ready_ ? "nothing to translate" : "translator not initialized");
+        return;
     }
 
-    curl_easy_cleanup(curl);
+    std::string cached;
+    if (cache_ && cache_->lookup(target, text, cached)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.submitted++;
+            stats_.cache_hits++;
+        }
+        complete(item, true, cached, "");
+        return;
+    }
 
-    try {
-        json jsonResponse = json::parse(response);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.submitted++;
+        if (pending_.size() < options_.max_pending) {
+            pending_.push_back(std::move(item));
+            outstanding_++;
+            item.callback = nullptr;
+        }
+    }
+    if (item.callback) {
+        complete(item, false, "", "too many pending requests");
+        return;
+    }
+    curl_multi_wakeup(multi_);
+}
+
+std::future<TranslationResult> Translator::translate(const std::string& target, const std::string& text,
+                                                     std::chrono::milliseconds deadline) {
+    auto promise = std::make_shared<std::promise<TranslationResult>>();
+    auto future = promise->get_future();
+    translate(target, text, [promise](const TranslationResult& result) { promise->set_value(result); },
+              deadline);
+    return future;
+}
+
+size_t Translator::drain(Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait_until(lock, deadline, [this] { return outstanding_ == 0; });
+    return outstanding_;
+}
+
+void Translator::settle(size_t items) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_ -= std::min(outstanding_, items);
+    }
+    idle_cv_.notify_all();
+}
+
+TranslatorStats Translator::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
 
-        if (jsonResponse.contains("error")) {
-            std::cerr << "Error: " << jsonResponse["error"]["message"] << std::endl;
-            return false;
+void Translator::complete(Item& item, bool ok, const std::string& text, const std::string& error) {
+    TranslationResult result;
+    result.ok = ok;
+    result.text = text;
+    result.error = error;
+    std::chrono::duration<double, std::milli> latency = Clock::now() - item.submitted;
+    result.latency_ms = latency.count();
+    if (item.callback) {
+        item.callback(result);
+    }
+}
+
+// Called with mutex_ held. Moves ready batches out of pending_ and returns
+// when the worker should look again for a batch still filling up.
+Clock::time_point Translator::takeBatches(std::vector<std::unique_ptr<Request>>& batches) {
+    const auto now = Clock::now();
+    auto next_check = now + std::chrono::seconds(1);
+
+    while (!pending_.empty() &&
+           active_.size() + batches.size() < static_cast<size_t>(options_.max_in_flight)) {
+        const std::string target = pending_.front().target;
+        size_t same_target = 0;
+        for (const auto& item : pending_) {
+            same_target += item.target == target;
+        }
+
+        // Give the batch time to fill unless it is full or would miss a deadline
+        const auto window_end = pending_.front().submitted + options_.batch_window;
+        if (same_target < options_.max_batch && now < window_end &&
+            now + options_.batch_window < pending_.front().deadline) {
+            next_check = std::min(next_check, window_end);
+            break;
         }
 
-        out = jsonResponse["data"]["translations"][0]["translatedText"];
-    } catch (const std::exception& e) {
-        std::cerr << "JSON parsing error: " << e.what() << std::endl;
+        auto request = std::make_unique<Request>();
+        for (auto it = pending_.begin();
+             it != pending_.end() && request->items.size() < options_.max_batch;) {
+            if (it->target == target) {
+                request->items.push_back(std::move(*it));
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        stats_.http_requests++;
+        stats_.batched_texts += request->items.size();
+        stats_.max_batch_size = std::max(stats_.max_batch_size, request->items.size());
+        batches.push_back(std::move(request));
+    }
+    return next_check;
+}
+
+void Translator::startRequest(std::unique_ptr<Request> request) {
+    auto now = Clock::now();
+    auto deadline = request->items.front().deadline;
+    for (const auto& item : request->items) {
+        deadline = std::min(deadline, item.deadline);
+    }
+    if (now >= deadline) {
+        for (auto& item : request->items) {
+            complete(item, false, "", "deadline exceeded before sending");
+        }
+        settle(request->items.size());
+        return;
+    }
+
+    std::vector<std::string> texts;
+    texts.reserve(request->items.size());
+    for (const auto& item : request->items) {
+        texts.push_back(item.text);
+    }
+    request->body = build_translation_request(request->items.front().target, texts);
+
+    CURL* easy;
+    if (!idle_handles_.empty()) {
+        easy = idle_handles_.back();
+        idle_handles_.pop_back();
+        curl_easy_reset(easy);
+    } else {
+        easy = curl_easy_init();
+        if (!easy) {
+            for (auto& item : request->items) {
+                complete(item, false, "", "failed to initialize CURL");
+            }
+            settle(request->items.size());
+            return;
+        }
+    }
+
+    long timeout_ms = static_cast<long>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+
+    curl_easy_setopt(easy, CURLOPT_URL, url_.c_str());
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers_);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request->body.c_str());
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(request->body.size()));
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &request->response);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, std::max(1L, timeout_ms));
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    // Only TLS endpoints can negotiate HTTP/2; waiting to multiplex on a
+    // plain HTTP/1.1 connection would serialize the requests instead
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, url_.rfind("https://", 0) == 0 ? 1L : 0L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, request.get());
+
+    curl_multi_add_handle(multi_, easy);
+    active_.push_back(easy);
+    request.release(); // owned through CURLOPT_PRIVATE until finishRequest
+}
+
+void Translator::finishRequest(CURL* easy, CURLcode code) {
+    Request* raw = nullptr;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, reinterpret_cast<char**>(&raw));
+    std::unique_ptr<Request> request(raw);
+
+    curl_multi_remove_handle(multi_, easy);
+    active_.erase(std::find(active_.begin(), active_.end(), easy));
+    idle_handles_.push_back(easy);
+
+    std::vector<std::string> translations;
+    std::string error;
+    bool ok = false;
+    if (code != CURLE_OK) {
+        error = std::string("CURL error: ") + curl_easy_strerror(code);
+    } else {
+        ok = parse_translations(request->response, request->items.size(), translations, error);
+    }
+
+    for (size_t i = 0; i < request->items.size(); i++) {
+        Item& item = request->items[i];
+        if (ok) {
+            if (cache_) {
+                cache_->insert(item.target, item.text, translations[i]);
+            }
+            complete(item, true, translations[i], "");
+        } else {
+            complete(item, false, "", error);
+        }
+    }
+    settle(request->items.size());
+}
+
+void Translator::run() {
+    while (true) {
+        std::vector<std::unique_ptr<Request>> batches;
+        Clock::time_point next_check;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) {
+                break;
+            }
+            next_check = takeBatches(batches);
+        }
+        for (auto& request : batches) {
+            startRequest(std::move(request));
+        }
+
+        int still_running = 0;
+        curl_multi_perform(multi_, &still_running);
+
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg == CURLMSG_DONE) {
+                finishRequest(msg->easy_handle, msg->data.result);
+            }
+        }
+
+        // Sleeps until socket activity, a batch window closing, or
+        // curl_multi_wakeup()
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_check - Clock::now());
+        curl_multi_poll(multi_, nullptr, 0, static_cast<int>(std::max<int64_t>(wait.count(), 1)), nullptr);
+    }
+
+    // Fail whatever is left so no future is abandoned
+    std::deque<Item> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        abandoned.swap(pending_);
+    }
+    for (auto& item : abandoned) {
+        complete(item, false, "", "translator shut down");
+    }
+    settle(abandoned.size());
+    while (!active_.empty()) {
+        finishRequest(active_.back(), CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+// Process-wide client, created on first use, so connections are reused
+// across calls to the synchronous helper as well
+static Translator& default_translator() {
+    static Translator translator;
+    return translator;
+}
+
+bool translate_text(const std::string& target, const std::string& english_text, std::string& out) {
+    if (target.empty() || english_text.empty()) {
+        return false;
+    }
+
+    Translator& translator = default_translator();
+    if (!translator.ready()) {
+        return false;
+    }
+
+    TranslationResult result = translator.translate(target, english_text).get();
+    if (!result.ok) {
+        std::cerr << "Translation failed: " << result.error << std::endl;
         return false;
     }
 
+    out = result.text;
     return true;
 }
@@ -1,8 +1,137 @@
 #ifndef TRANSLATOR_HPP  
 #define TRANSLATOR_HPP
 
+#include <curl/curl.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "translation_cache.hpp"
 
 bool translate_text(const std::string& target, const std::string& english_text, std::string& out);
 
+struct TranslatorOptions {
+    // Google Translate v2 compatible endpoint; point it at a local mock
+    // server for testing
+    std::string endpoint = "https://translation.googleapis.com/language/translate/v2";
+    // Appended as ?key=; read from GOOGLE_TRANSLATE_API_KEY when empty
+    std::string api_key;
+    // Requests on the wire at once (multiplexed over HTTP/2 when possible)
+    int max_in_flight = 4;
+    // Requests accepted but not yet sent before new ones are rejected
+    size_t max_pending = 32;
+    std::chrono::milliseconds default_deadline{3000};
+    // Texts for the same target collected this long are sent as one
+    // request with a q array; 0 batches only what is already waiting
+    std::chrono::milliseconds batch_window{0};
+    size_t max_batch = 16;
+    // LRU entries kept; 0 disables the cache
+    size_t cache_capacity = 1024;
+    // JSON-lines file to persist the cache in; empty keeps it in memory
+    std::string cache_path;
+};
+
+struct TranslatorStats {
+    uint64_t submitted = 0;
+    uint64_t cache_hits = 0;
+    uint64_t http_requests = 0;
+    uint64_t batched_texts = 0; // texts sent over HTTP
+    size_t max_batch_size = 0;
+
+    double hitRate() const {
+        return submitted == 0 ? 0.0 : static_cast<double>(cache_hits) / submitted;
+    }
+    double meanBatchSize() const {
+        return http_requests == 0 ? 0.0 : static_cast<double>(batched_texts) / http_requests;
+    }
+};
+
+struct TranslationResult {
+    bool ok = false;
+    std::string text;
+    std::string error;
+    double latency_ms = 0.0;
+};
+
+// Asynchronous translation client.
+//
+// One worker thread drives a curl multi handle, so connections (and TLS
+// sessions) are kept alive between requests and several requests can be in
+// flight at once. Texts found in the cache are answered immediately; the
+// rest are grouped per target language into batched requests. Results are
+// delivered through a callback (on the caller's thread for cache hits, on
+// the worker thread otherwise) or through a future.
+class Translator {
+public:
+    using Callback = std::function<void(const TranslationResult&)>;
+
+    explicit Translator(const TranslatorOptions& options = TranslatorOptions());
+    ~Translator();
+
+    Translator(const Translator&) = delete;
+    Translator& operator=(const Translator&) = delete;
+
+    // A zero deadline means options.default_deadline
+    void translate(const std::string& target, const std::string& text, Callback callback,
+                   std::chrono::milliseconds deadline = std::chrono::milliseconds(0));
+    std::future<TranslationResult> translate(const std::string& target, const std::string& text,
+                                             std::chrono::milliseconds deadline = std::chrono::milliseconds(0));
+
+    // Waits until every accepted text has its result or `deadline` passes,
+    // and returns how many are still outstanding. Submit nothing meanwhile.
+    size_t drain(std::chrono::steady_clock::time_point deadline);
+
+    bool ready() const { return ready_; }
+    TranslatorStats getStats();
+
+private:
+    // One text waiting for translation
+    struct Item {
+        std::string target;
+        std::string text;
+        std::chrono::steady_clock::time_point submitted;
+        std::chrono::steady_clock::time_point deadline;
+        Callback callback;
+    };
+    // One HTTP request carrying a batch of items for the same target
+    struct Request;
+
+    void run();
+    std::chrono::steady_clock::time_point takeBatches(std::vector<std::unique_ptr<Request>>& batches);
+    void startRequest(std::unique_ptr<Request> request);
+    void finishRequest(CURL* easy, CURLcode code);
+    void complete(Item& item, bool ok, const std::string& text, const std::string& error);
+    // `items` accepted texts have had their results delivered
+    void settle(size_t items);
+
+    TranslatorOptions options_;
+    std::string url_;
+    bool ready_ = false;
+
+    CURLM* multi_ = nullptr;
+    curl_slist* headers_ = nullptr;
+    // Easy handles are reused; the multi handle keeps their connections
+    std::vector<CURL*> idle_handles_;
+    std::vector<CURL*> active_;
+
+    std::unique_ptr<TranslationCache> cache_;
+
+    std::mutex mutex_;
+    std::deque<Item> pending_;
+    // Texts accepted into pending_ whose results are not delivered yet
+    size_t outstanding_ = 0;
+    std::condition_variable idle_cv_;
+    bool running_ = true;
+    TranslatorStats stats_;
+    std::thread worker_;
+};
+
 #endif // TRANSLATOR_HPP
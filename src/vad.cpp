@@ -0,0 +1,178 @@
+#include "vad.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+EnergyVad::EnergyVad(const VadOptions &options)
+    : options_(options),
+      frame_samples_(options.sample_rate * options.frame_ms / 1000),
+      hangover_frames_(std::max(1, options.hangover_ms / options.frame_ms)) {}
+
+bool EnergyVad::processFrame(const float *frame, size_t count) {
+  if (count == 0) {
+    return inSpeech();
+  }
+
+  double energy = 0.0;
+  size_t crossings = 0;
+  for (size_t i = 0; i < count; i++) {
+    energy += frame[i] * frame[i];
+    if (i > 0 && (frame[i] >= 0.0f) != (frame[i - 1] >= 0.0f)) {
+      crossings++;
+    }
+  }
+  const float level_db = 10.0f * std::log10(static_cast<float>(energy / count) + 1e-10f);
+  const float zcr = static_cast<float>(crossings) / count;
+
+  // Follow the floor down quickly and up slowly (~10 s), so speech
+  // itself barely moves it
+  if (level_db < noise_floor_db_) {
+    noise_floor_db_ = 0.5f * (noise_floor_db_ + level_db);
+  } else {
+    noise_floor_db_ += 0.002f * (level_db - noise_floor_db_);
+  }
+
+  const float above_floor = level_db - noise_floor_db_;
+  bool speech = level_db > options_.min_level_db &&
+                (above_floor > options_.threshold_db ||
+                 (above_floor > 0.5f * options_.threshold_db &&
+                  zcr > options_.zcr_threshold));
+
+  if (speech) {
+    hangover_left_ = hangover_frames_;
+  } else if (hangover_left_ > 0) {
+    hangover_left_--;
+  }
+  return inSpeech();
+}
+
+bool EnergyVad::processChunk(const float *samples, size_t count) {
+  bool any_speech = false;
+  for (size_t i = 0; i < count; i += frame_samples_) {
+    any_speech |= processFrame(samples + i, std::min(frame_samples_, count - i));
+  }
+  return any_speech;
+}
+
+VadSegmenter::VadSegmenter(const VadOptions &options)
+    : options_(options), vad_(options),
+      frame_samples_(options.sample_rate * options.frame_ms / 1000),
+      min_silence_samples_(options.sample_rate * options.min_silence_ms / 1000),
+      pre_roll_samples_(options.sample_rate * options.pre_roll_ms / 1000),
+      max_segment_samples_(static_cast<size_t>(options.max_segment_s * options.sample_rate)) {
+  partial_frame_.reserve(frame_samples_);
+  current_.reserve(max_segment_samples_);
+}
+
+void VadSegmenter::push(const float *samples, size_t count) {
+  stats_.total_samples += count;
+
+  // Complete a frame left over from the previous call
+  if (!partial_frame_.empty()) {
+    size_t take = std::min(count, frame_samples_ - partial_frame_.size());
+    partial_frame_.insert(partial_frame_.end(), samples, samples + take);
+    samples += take;
+    count -= take;
+    if (partial_frame_.size() < frame_samples_) {
+      return;
+    }
+    processFrame(partial_frame_.data(), partial_frame_.size());
+    partial_frame_.clear();
+  }
+
+  while (count >= frame_samples_) {
+    processFrame(samples, frame_samples_);
+    samples += frame_samples_;
+    count -= frame_samples_;
+  }
+  partial_frame_.assign(samples, samples + count);
+}
+
+void VadSegmenter::processFrame(const float *frame, size_t count) {
+  const bool speech = vad_.processFrame(frame, count);
+  const int64_t frame_start = framed_samples_;
+  framed_samples_ += count;
+
+  if (!in_segment_) {
+    if (!speech) {
+      // Silence: remember a little of it as pre-roll, skip the rest
+      pre_roll_.insert(pre_roll_.end(), frame, frame + count);
+      while (pre_roll_.size() > pre_roll_samples_) {
+        pre_roll_.pop_front();
+        stats_.skipped_samples++;
+      }
+      return;
+    }
+
+    in_segment_ = true;
+    silence_run_ = 0;
+    current_start_ = frame_start - static_cast<int64_t>(pre_roll_.size());
+    current_.assign(pre_roll_.begin(), pre_roll_.end());
+    pre_roll_.clear();
+  }
+
+  current_.insert(current_.end(), frame, frame + count);
+  silence_run_ = speech ? 0 : silence_run_ + count;
+
+  if (silence_run_ >= min_silence_samples_) {
+    closeSegment(false);
+  } else if (current_.size() >= max_segment_samples_) {
+    closeSegment(true);
+  }
+}
+
+void VadSegmenter::closeSegment(bool forced) {
+  if (current_.empty()) {
+    in_segment_ = false;
+    return;
+  }
+
+  // The trailing pause is not worth decoding
+  size_t trailing = std::min(silence_run_, current_.size());
+  stats_.skipped_samples += trailing;
+  current_.resize(current_.size() - trailing);
+
+  stats_.speech_samples += current_.size();
+  stats_.segments++;
+  if (forced) {
+    stats_.forced_cuts++;
+  }
+
+  ready_starts_.push_back(current_start_);
+  current_start_ += static_cast<int64_t>(current_.size() + trailing);
+  ready_.push_back(std::move(current_));
+  current_ = std::vector<float>();
+  current_.reserve(max_segment_samples_);
+
+  // A forced cut continues straight into the next segment
+  in_segment_ = forced;
+  silence_run_ = 0;
+}
+
+void VadSegmenter::flush() {
+  if (in_segment_) {
+    closeSegment(false);
+  }
+}
+
+bool VadSegmenter::popSegment(std::vector<float> &segment, int64_t *start_sample) {
+  if (ready_.empty()) {
+    return false;
+  }
+  segment.swap(ready_.front());
+  ready_.pop_front();
+  if (start_sample != nullptr) {
+    *start_sample = ready_starts_.front();
+  }
+  ready_starts_.pop_front();
+  return true;
+}
+
+void VadSegmenter::recordDecode(size_t samples, double decode_ms) {
+  decoded_samples_ += samples;
+  decode_ms_ += decode_ms;
+  if (decoded_samples_ > 0) {
+    stats_.inference_ms_saved =
+        stats_.skipped_samples * (decode_ms_ / decoded_samples_);
+  }
+}
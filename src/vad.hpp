@@ -0,0 +1,105 @@
+#ifndef VAD_HPP
+#define VAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct VadOptions {
+  int sample_rate = 16000;
+  int frame_ms = 20;
+  // Speech is this far above the adaptive noise floor
+  float threshold_db = 9.0f;
+  // Frames quieter than this are never speech
+  float min_level_db = -55.0f;
+  // Zero-crossing rate (per sample) above which a moderately loud frame
+  // counts as unvoiced speech
+  float zcr_threshold = 0.25f;
+  // Keep reporting speech this long after the level drops
+  int hangover_ms = 300;
+  // A pause this long ends a segment
+  int min_silence_ms = 500;
+  // Audio kept in front of a detected onset
+  int pre_roll_ms = 200;
+  // Segments are cut here even without a pause
+  float max_segment_s = 10.0f;
+};
+
+// Frame classifier based on short-term energy and zero-crossing rate
+// against an adaptive noise floor.
+class EnergyVad {
+public:
+  explicit EnergyVad(const VadOptions &options);
+
+  // Classify one frame; includes hangover
+  bool processFrame(const float *frame, size_t count);
+  // Classify a chunk frame by frame; true if any frame was speech
+  bool processChunk(const float *samples, size_t count);
+  bool inSpeech() const { return hangover_left_ > 0; }
+  float noiseFloorDb() const { return noise_floor_db_; }
+
+private:
+  VadOptions options_;
+  size_t frame_samples_;
+  float noise_floor_db_ = -60.0f;
+  int hangover_frames_;
+  int hangover_left_ = 0;
+};
+
+struct VadStats {
+  uint64_t total_samples = 0;
+  uint64_t speech_samples = 0;  // handed to the decoder
+  uint64_t skipped_samples = 0; // never decoded
+  uint64_t segments = 0;
+  uint64_t forced_cuts = 0;     // hit max_segment_s without a pause
+  // Inference time not spent on skipped audio, estimated from the measured
+  // decode cost per second of speech
+  double inference_ms_saved = 0.0;
+};
+
+// Turns a continuous stream into speech segments cut at pauses. Silent
+// audio outside segments is dropped and counted.
+class VadSegmenter {
+public:
+  explicit VadSegmenter(const VadOptions &options);
+
+  void push(const float *samples, size_t count);
+  // Close the open segment, e.g. at shutdown
+  void flush();
+  // Move the oldest finished segment into `segment`; `start_sample` gets
+  // its position in the pushed stream
+  bool popSegment(std::vector<float> &segment, int64_t *start_sample = nullptr);
+
+  // Feed back decode cost so inference_ms_saved can be estimated
+  void recordDecode(size_t samples, double decode_ms);
+  const VadStats &stats() const { return stats_; }
+  bool inSegment() const { return in_segment_; }
+
+private:
+  void processFrame(const float *frame, size_t count);
+  void closeSegment(bool forced);
+
+  VadOptions options_;
+  EnergyVad vad_;
+  size_t frame_samples_;
+  size_t min_silence_samples_;
+  size_t pre_roll_samples_;
+  size_t max_segment_samples_;
+
+  std::vector<float> partial_frame_;
+  std::deque<float> pre_roll_;
+  std::vector<float> current_;
+  int64_t current_start_ = 0;
+  int64_t framed_samples_ = 0; // samples passed to processFrame so far
+  bool in_segment_ = false;
+  size_t silence_run_ = 0;
+  std::deque<std::vector<float>> ready_;
+  std::deque<int64_t> ready_starts_;
+
+  double decoded_samples_ = 0.0;
+  double decode_ms_ = 0.0;
+  VadStats stats_;
+};
+
+#endif // VAD_HPP